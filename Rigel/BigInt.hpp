@@ -20,6 +20,7 @@
 #include <cassert>
 #include <ostream>
 #include <algorithm>
+#include <vector>
 #include <boost/throw_exception.hpp>
 #include <boost/endian/conversion.hpp>
 
@@ -40,8 +41,301 @@ struct bigint_random_error: virtual bigint_error, virtual std::exception {};
 struct bigint_character_error: virtual bigint_error, virtual std::exception {};
 struct bigint_overflow_error: virtual bigint_error, virtual std::exception {};
 struct bigint_barret_error: virtual bigint_error, virtual std::exception {};
+struct bigint_montgomery_error: virtual bigint_error, virtual std::exception {};
+struct bigint_division_error: virtual bigint_error, virtual std::exception {};
 
 template<int K> struct BarretReduction;
+template<int N> struct MontgomeryContext;
+
+/** Number of digits from which squaring is split with Karatsuba.
+ * Below this the Comba square is faster, due to the overhead of the split.
+ */
+constexpr int BIGINT_KARATSUBA_DIGITS = 48;
+
+/** Add two numbers of n digits.
+ * @return carry
+ */
+static inline unsigned char bigIntAddDigits(intel_intrinsic_uint64 *r, const intel_intrinsic_uint64 *a, const intel_intrinsic_uint64 *b, int n)
+{
+    unsigned char carry = 0;
+    for (int i = 0; i < n; i++) {
+        carry = _addcarryx_u64(carry, a[i], b[i], &r[i]);
+    }
+    return carry;
+}
+
+/** Subtract two numbers of n digits.
+ * @return borrow
+ */
+static inline unsigned char bigIntSubtractDigits(intel_intrinsic_uint64 *r, const intel_intrinsic_uint64 *a, const intel_intrinsic_uint64 *b, int n)
+{
+    unsigned char borrow = 0;
+    for (int i = 0; i < n; i++) {
+        borrow = fixed_subborrow_u64(borrow, a[i], b[i], &r[i]);
+    }
+    return borrow;
+}
+
+/** Add a 128 bit product to a 192 bit accumulator.
+ */
+static inline void bigIntAccumulate(intel_intrinsic_uint64 &c0, intel_intrinsic_uint64 &c1, intel_intrinsic_uint64 &c2, intel_intrinsic_uint64 lo, intel_intrinsic_uint64 hi)
+{
+    auto carry = _addcarryx_u64(0, c0, lo, &c0);
+    carry = _addcarryx_u64(carry, c1, hi, &c1);
+    c2 += carry;
+}
+
+/** Divide a 128 bit number by a 64 bit number, with the divq instruction.
+ *
+ * @param hi High digit of the dividend, which must be smaller than d.
+ * @param lo Low digit of the dividend.
+ * @param d Divisor.
+ * @param remainder Returns the remainder.
+ * @return The quotient.
+ */
+static inline uint64_t bigIntDivide128(uint64_t hi, uint64_t lo, uint64_t d, intel_intrinsic_uint64 &remainder)
+{
+    uint64_t quotient;
+    __asm__("divq %4" : "=a"(quotient), "=d"(remainder) : "a"(lo), "d"(hi), "rm"(d));
+    return quotient;
+}
+
+/** Divide a 128 bit number by a normalized 64 bit number, in constant time.
+ * Instead of divq, whose latency depends on its operands, this multiplies
+ * by the reciprocal of the divisor (Möller and Granlund, "Improved division
+ * by invariant integers").
+ *
+ * @param hi High digit of the dividend, which must be smaller than d.
+ * @param lo Low digit of the dividend.
+ * @param d Divisor with its highest bit set.
+ * @param reciprocal `(2**128 - 1) / d - 2**64`
+ * @return The quotient.
+ */
+static inline uint64_t bigIntDivide128ConstantTime(uint64_t hi, uint64_t lo, uint64_t d, uint64_t reciprocal)
+{
+    intel_intrinsic_uint64 q1;
+    intel_intrinsic_uint64 q0 = _mulx_u64(reciprocal, hi, &q1);
+    auto carry = _addcarryx_u64(0, q0, lo, &q0);
+    _addcarryx_u64(carry, q1, hi + 1, &q1);
+
+    uint64_t r = lo - q1 * d;
+
+    // The estimate is at most one too large or one too small.
+    uint64_t mask = -static_cast<uint64_t>(r > q0);
+    q1 += mask;
+    r += d & mask;
+
+    mask = -static_cast<uint64_t>(r >= d);
+    q1 -= mask;
+    return q1;
+}
+
+/** Long division of a number of m digits by a number of n digits.
+ * https://en.wikipedia.org/wiki/Division_algorithm#Long_division
+ *
+ * Knuth's Algorithm D (The Art of Computer Programming, Vol. 2, 4.3.1).
+ * Both numbers are shifted so that the highest bit of the divisor is set.
+ * Each digit of the quotient is then estimated from the top two digits of
+ * the remainder and the top digit of the divisor; this estimate is at most
+ * two too large. The divisor times the estimate is subtracted from the
+ * remainder and added back while the remainder is negative.
+ *
+ * With CONSTANT_TIME the estimate is made without divq and always corrected
+ * twice with masks, so that the time does not depend on the dividend.
+ * The time does depend on the number of digits and the leading zeros of
+ * the divisor, which is public for a modulus.
+ *
+ * @param q Quotient of m - n + 1 digits.
+ * @param r Remainder of n digits.
+ * @param u Dividend of m digits.
+ * @param v Divisor of n digits, with a highest digit that is not zero, m >= n.
+ * @param un Scratch space of m + 1 digits.
+ * @param vn Scratch space of n digits.
+ */
+template<bool CONSTANT_TIME>
+static inline void bigIntDivideDigits(
+    intel_intrinsic_uint64 *q, intel_intrinsic_uint64 *r,
+    const intel_intrinsic_uint64 *u, int m, const intel_intrinsic_uint64 *v, int n,
+    intel_intrinsic_uint64 *un, intel_intrinsic_uint64 *vn)
+{
+    // Normalize, a shift by 64 - s is written as two shifts so that s may be zero.
+    auto s = static_cast<int>(_lzcnt_u64(v[n - 1]));
+    for (int i = n - 1; i > 0; i--) {
+        vn[i] = (v[i] << s) | ((v[i - 1] >> 1) >> (63 - s));
+    }
+    vn[0] = v[0] << s;
+
+    un[m] = (u[m - 1] >> 1) >> (63 - s);
+    for (int i = m - 1; i > 0; i--) {
+        un[i] = (u[i] << s) | ((u[i - 1] >> 1) >> (63 - s));
+    }
+    un[0] = u[0] << s;
+
+    auto d = vn[n - 1];
+    uint64_t reciprocal = 0;
+    if (CONSTANT_TIME) {
+        intel_intrinsic_uint64 dummy;
+        reciprocal = bigIntDivide128(~d, ~0ULL, d, dummy);
+    }
+
+    for (int j = m - n; j >= 0; j--) {
+        uint64_t qhat;
+
+        if (CONSTANT_TIME) {
+            // The top digit of the remainder is never larger than the top digit
+            // of the divisor, when they are equal the estimate is 2**64 - 1.
+            uint64_t equal = -static_cast<uint64_t>(un[j + n] == d);
+            qhat = bigIntDivide128ConstantTime(un[j + n] & ~equal, un[j + n - 1], d, reciprocal) | equal;
+
+        } else {
+            intel_intrinsic_uint64 rhat;
+            bool rhatOverflow = false;
+            if (un[j + n] == d) {
+                qhat = ~0ULL;
+                rhatOverflow = _addcarryx_u64(0, un[j + n - 1], d, &rhat);
+            } else {
+                qhat = bigIntDivide128(un[j + n], un[j + n - 1], d, rhat);
+            }
+
+            // Use the second digit of the divisor to correct the estimate,
+            // after which it is almost always exact.
+            while (n >= 2 && !rhatOverflow) {
+                intel_intrinsic_uint64 hi;
+                intel_intrinsic_uint64 lo = _mulx_u64(qhat, vn[n - 2], &hi);
+                if (hi < rhat || (hi == rhat && lo <= un[j + n - 2])) {
+                    break;
+                }
+                qhat--;
+                rhatOverflow = _addcarryx_u64(0, rhat, d, &rhat);
+            }
+        }
+
+        // Subtract qhat * divisor from the remainder.
+        intel_intrinsic_uint64 carry = 0;
+        unsigned char borrow = 0;
+        for (int i = 0; i < n; i++) {
+            intel_intrinsic_uint64 hi;
+            intel_intrinsic_uint64 lo = _mulx_u64(qhat, vn[i], &hi);
+            hi += _addcarryx_u64(0, lo, carry, &lo);
+            borrow = fixed_subborrow_u64(borrow, un[i + j], lo, &un[i + j]);
+            carry = hi;
+        }
+        borrow = fixed_subborrow_u64(borrow, un[j + n], carry, &un[j + n]);
+
+        // Add the divisor back while the remainder is negative.
+        for (int k = 0; k < (CONSTANT_TIME ? 2 : 1); k++) {
+            if (!CONSTANT_TIME && !borrow) {
+                break;
+            }
+
+            uint64_t mask = -static_cast<uint64_t>(borrow);
+            unsigned char c = 0;
+            for (int i = 0; i < n; i++) {
+                c = _addcarryx_u64(c, un[i + j], vn[i] & mask, &un[i + j]);
+            }
+            c = _addcarryx_u64(c, un[j + n], 0, &un[j + n]);
+            qhat += mask;
+            borrow &= !c;
+        }
+
+        q[j] = qhat;
+    }
+
+    // Unnormalize the remainder.
+    for (int i = 0; i < n; i++) {
+        r[i] = (un[i] >> s) | ((un[i + 1] << 1) << (63 - s));
+    }
+}
+
+/** Square a number of D digits into 2 * D digits, using Comba's method.
+ * The result is calculated one column at a time. The cross products
+ * `a[i] * a[j]` for i < j are calculated once and doubled, so that only
+ * half of the products of a full multiply are needed.
+ */
+template<int D>
+static inline void bigIntSquareComba(intel_intrinsic_uint64 *r, const intel_intrinsic_uint64 *a)
+{
+    intel_intrinsic_uint64 c0 = 0;
+    intel_intrinsic_uint64 c1 = 0;
+    intel_intrinsic_uint64 c2 = 0;
+
+    for (int k = 0; k < 2 * D - 1; k++) {
+        intel_intrinsic_uint64 t0 = 0;
+        intel_intrinsic_uint64 t1 = 0;
+        intel_intrinsic_uint64 t2 = 0;
+        for (int i = std::max(0, k - D + 1); 2 * i < k; i++) {
+            intel_intrinsic_uint64 hi;
+            intel_intrinsic_uint64 lo = _mulx_u64(a[i], a[k - i], &hi);
+            bigIntAccumulate(t0, t1, t2, lo, hi);
+        }
+
+        // Double the cross products.
+        t2 = (t2 << 1) | (t1 >> 63);
+        t1 = (t1 << 1) | (t0 >> 63);
+        t0 = t0 << 1;
+        bigIntAccumulate(c0, c1, c2, t0, t1);
+        c2 += t2;
+
+        if (k % 2 == 0) {
+            intel_intrinsic_uint64 hi;
+            intel_intrinsic_uint64 lo = _mulx_u64(a[k / 2], a[k / 2], &hi);
+            bigIntAccumulate(c0, c1, c2, lo, hi);
+        }
+
+        r[k] = c0;
+        c0 = c1;
+        c1 = c2;
+        c2 = 0;
+    }
+    r[2 * D - 1] = c0;
+}
+
+/** Square a number of D digits into 2 * D digits.
+ *
+ * Large numbers with an even number of digits are split in two halves
+ * with Karatsuba, which needs three half-sized squares instead of four:
+ * ```
+ *     a = a1 * B + a0
+ *     a**2 = a1**2 * B**2 + (a0**2 + a1**2 - (a0 - a1)**2) * B + a0**2
+ * ```
+ * The absolute difference of the halves is selected with a mask, so
+ * that the split runs in constant time.
+ */
+template<int D>
+static inline void bigIntSquare(intel_intrinsic_uint64 *r, const intel_intrinsic_uint64 *a)
+{
+    if constexpr (D < BIGINT_KARATSUBA_DIGITS || D % 2 != 0) {
+        bigIntSquareComba<D>(r, a);
+
+    } else {
+        constexpr int H = D / 2;
+
+        bigIntSquare<H>(r, a);
+        bigIntSquare<H>(r + D, a + H);
+
+        // |a0 - a1|
+        intel_intrinsic_uint64 d[H];
+        intel_intrinsic_uint64 e[H];
+        uint64_t mask = -static_cast<uint64_t>(bigIntSubtractDigits(d, a, a + H, H));
+        bigIntSubtractDigits(e, a + H, a, H);
+        for (int i = 0; i < H; i++) {
+            d[i] = (e[i] & mask) | (d[i] & ~mask);
+        }
+
+        intel_intrinsic_uint64 middle[D];
+        bigIntSquare<H>(middle, d);
+
+        // a0**2 + a1**2 - (a0 - a1)**2, which is never negative.
+        intel_intrinsic_uint64 z1[D + 1];
+        z1[D] = bigIntAddDigits(z1, r, r + D, D);
+        z1[D] -= bigIntSubtractDigits(z1, z1, middle, D);
+
+        auto carry = bigIntAddDigits(r + H, r + H, z1, D + 1);
+        for (int i = H + D + 1; i < 2 * D; i++) {
+            carry = _addcarryx_u64(carry, r[i], 0, &r[i]);
+        }
+    }
+}
 
 /** Unsigned big integer.
  * This class is used for cryptographic calculations, such as Diffie Hellman Key Exchange.
@@ -102,6 +396,20 @@ struct BigInt {
         return static_cast<bool>((d >> (i % 64)) & 1);
     }
 
+    /** Get count bits starting at bit i.
+     * Bits beyond the width of the integer are zero.
+     *
+     * @param i Index of the lowest bit.
+     * @param count The number of bits between 1 and 63.
+     */
+    inline uint64_t getBits(int i, int count) const {
+        assert(count >= 1 && count <= 63);
+
+        uint64_t lo = (i / 64 < NR_DIGITS(N)) ? digits[i / 64] >> (i % 64) : 0;
+        uint64_t hi = (i % 64 != 0 && i / 64 + 1 < NR_DIGITS(N)) ? digits[i / 64 + 1] << (64 - i % 64) : 0;
+        return (lo | hi) & ((1ULL << count) - 1);
+    }
+
     inline void setBit(int i, bool x) {
         uint64_t d = static_cast<uint64_t>(x) << (i % 64);
         digits[i / 64] |= d;
@@ -225,7 +533,7 @@ struct BigInt {
         bool overflow = false;
 
         // Check for overflow.
-        for (int i = NR_DIGITS(N) - 1; i >= NR_DIGITS(N) - count; i++) {
+        for (int i = NR_DIGITS(N) - 1; i >= NR_DIGITS(N) - count; i--) {
             overflow |= digits[i] > 0;
         }
 
@@ -334,6 +642,8 @@ struct BigInt {
     }
 
     /** Initialize by dividing two integers.
+     * The time does not depend on the value of the dividend, the divisor
+     * is treated as public, see bigIntDivideDigits().
      *
      * @param a value
      * @param b value
@@ -341,19 +651,62 @@ struct BigInt {
      */
     template<int A, int B>
     inline BigInt<B> initDivision(const BigInt<A> &a, const BigInt<B> &b) {
+        return initDivisionDigits<true>(a, b);
+    }
+
+    /** Initialize by dividing two integers, of which both are public.
+     * This is faster than initDivision(), as it skips the leading zero
+     * digits of the dividend and uses divq.
+     *
+     * @param a value
+     * @param b value
+     * @return Remainder value.
+     */
+    template<int A, int B>
+    inline BigInt<B> initDivisionVariableTime(const BigInt<A> &a, const BigInt<B> &b) {
+        return initDivisionDigits<false>(a, b);
+    }
+
+    template<bool CONSTANT_TIME, int A, int B>
+    inline BigInt<B> initDivisionDigits(const BigInt<A> &a, const BigInt<B> &b) {
         memset(digits, 0, NR_DIGITS(N) * sizeof (uint64_t));
-        auto remainder = BigInt<B+1>(0);
-        auto zero = BigInt<B>(0);
+        auto remainder = BigInt<B>(0);
 
-        for (int i = A - 1; i >= 0; i--) {
-            remainder.partialShiftLeft(1, a.getBit(i));
+        int n = NR_DIGITS(B);
+        while (n > 0 && b.digits[n - 1] == 0) {
+            n--;
+        }
+        if (n == 0) {
+            BOOST_THROW_EXCEPTION(bigint_division_error());
+        }
 
-            auto remainderLEb = remainder >= b;
-            remainder -= remainderLEb ? b : zero;
-            setBit(i, remainderLEb);
+        int m = NR_DIGITS(A);
+        while (!CONSTANT_TIME && m > 0 && a.digits[m - 1] == 0) {
+            m--;
+        }
+        if (m < n) {
+            memcpy(remainder.digits, a.digits, std::min(m, NR_DIGITS(B)) * sizeof (uint64_t));
+            return remainder;
         }
 
-        return BigInt<B>(remainder);
+        // The digits are copied, because uint64_t and intel_intrinsic_uint64
+        // are distinct types which may not alias.
+        intel_intrinsic_uint64 u[NR_DIGITS(A)];
+        intel_intrinsic_uint64 v[NR_DIGITS(B)];
+        memcpy(u, a.digits, sizeof (u));
+        memcpy(v, b.digits, sizeof (v));
+
+        intel_intrinsic_uint64 q[NR_DIGITS(A)];
+        intel_intrinsic_uint64 r[NR_DIGITS(B)] = {};
+        intel_intrinsic_uint64 un[NR_DIGITS(A) + 1];
+        intel_intrinsic_uint64 vn[NR_DIGITS(B)];
+        bigIntDivideDigits<CONSTANT_TIME>(q, r, u, m, v, n, un, vn);
+
+        for (int i = 0; i <= m - n && i < NR_DIGITS(N); i++) {
+            digits[i] = q[i];
+        }
+        memcpy(remainder.digits, r, sizeof (r));
+        return remainder;
     }
 
     template<int K>
@@ -366,15 +719,60 @@ struct BigInt {
             auto product = result * (exponent.getBit(i) ? base : one);
 
             result = br.modulo(product);
-            base = br.modulo(base * base);
+            base = br.modulo(base.square());
         }
 
         return BigInt<N>(result);
     }
 
+    /** Modular exponentiation in Montgomery form, using a fixed window.
+     *
+     * The exponent is scanned from the top in windows of WINDOW bits. For each
+     * window the result is squared WINDOW times and then multiplied by
+     * `base**window` from a precomputed table. Every window does a multiply,
+     * also when its bits are zero, and the table entry is read with a masked
+     * scan over the whole table, so that neither the time nor the memory
+     * access pattern depends on the exponent.
+     */
+    inline BigInt<N> modularPower(const BigInt<N> &exponent, const MontgomeryContext<N> &mc) const {
+        if (*this == BigInt<N>(2)) {
+            return mc.fromMontgomery(mc.powerOfTwo(exponent));
+        }
+
+        constexpr int WINDOW = MontgomeryContext<N>::WINDOW;
+        constexpr int TABLE_SIZE = 1 << WINDOW;
+        constexpr int NR_WINDOWS = (N + WINDOW - 1) / WINDOW;
+
+        BigInt<N> table[TABLE_SIZE];
+        table[0] = mc.one();
+        table[1] = mc.toMontgomery(*this);
+        for (int i = 2; i < TABLE_SIZE; i++) {
+            table[i] = mc.multiply(table[i - 1], table[1]);
+        }
+
+        auto result = mc.select(table, TABLE_SIZE, exponent.getBits((NR_WINDOWS - 1) * WINDOW, WINDOW));
+        for (int i = NR_WINDOWS - 2; i >= 0; i--) {
+            for (int j = 0; j < WINDOW; j++) {
+                result = mc.square(result);
+            }
+            result = mc.multiply(result, mc.select(table, TABLE_SIZE, exponent.getBits(i * WINDOW, WINDOW)));
+        }
+
+        return mc.fromMontgomery(result);
+    }
+
+    /** Modular exponentiation.
+     * Montgomery multiplication is used for an odd modulus, such as the primes
+     * of Diffie-Hellman, otherwise Barret Reduction is used.
+     */
     inline BigInt<N> modularPower(const BigInt<N> &exponent, const BigInt<N> &modulus) const {
-        auto br = BarretReduction<N+1>(modulus);
-        return modularPower(exponent, br);
+        if (modulus.getBit(0)) {
+            auto mc = MontgomeryContext<N>(modulus);
+            return modularPower(exponent, mc);
+        } else {
+            auto br = BarretReduction<N+1>(modulus);
+            return modularPower(exponent, br);
+        }
     }
 
     inline void initHexString(const std::string &str, size_t offset) {
@@ -530,10 +928,26 @@ struct BigInt {
 
         remainder = dummy.initDivision(r, other);
 
-        memcpy(digits, remainder.digits, N * sizeof (uint64_t));
+        memcpy(digits, remainder.digits, sizeof (digits));
         return *this;
     }
 
+    /** Square, which is faster than multiplying with itself.
+     */
+    inline BigInt<2*N> square(void) const {
+        // The digits are copied, because uint64_t and intel_intrinsic_uint64
+        // are distinct types which may not alias.
+        intel_intrinsic_uint64 a[NR_DIGITS(N)];
+        memcpy(a, digits, sizeof (a));
+
+        intel_intrinsic_uint64 t[2 * NR_DIGITS(N)];
+        bigIntSquare<NR_DIGITS(N)>(t, a);
+
+        BigInt<2*N> r;
+        memcpy(r.digits, t, sizeof (r.digits));
+        return r;
+    }
+
     template<int O>
     inline BigInt<N+O> operator*(const BigInt<O> &other) const {
         auto r = BigInt<N+O>(0);
@@ -615,7 +1029,7 @@ struct BarretReduction {
         modulus(modulus), r()
     {
         auto scaledOne = BigIntHighbit<2*K+1>();
-        r.initDivision(scaledOne, modulus);
+        r.initDivisionVariableTime(scaledOne, modulus);
     }
 
     template<int X>
@@ -651,5 +1065,330 @@ struct BarretReduction {
     }
 };
 
+/** Montgomery multiplication modulo an odd integer.
+ * https://en.wikipedia.org/wiki/Montgomery_modular_multiplication
+ *
+ * Values are kept in Montgomery form `x * R mod m`, where `R = 2**(64 * digits)`.
+ * In this form a modular multiplication is a multiply interleaved with
+ * a reduction, one digit at a time (Coarsely Integrated Operand Scanning):
+ * ```
+ *     t = 0
+ *     for each digit b[i]:
+ *         t += a * b[i]
+ *         q = t[0] * (-1 / m) mod 2**64
+ *         t = (t + q * m) / 2**64
+ *
+ *     if (t >= m) {
+ *         t -= m;
+ *     }
+ * ```
+ *
+ * Each digit-multiply runs two independent carry chains, one through the low
+ * halves and one through the high halves of the products, so that the
+ * compiler can use `mulx` with `adcx` and `adox`. The final subtraction is
+ * always executed, for constant cpu time.
+ *
+ * @param N Width of the modulus in bits.
+ */
+template<int N>
+struct MontgomeryContext {
+    static constexpr int DIGITS = NR_DIGITS(N);
+
+    /** Number of exponent bits handled per table lookup by modularPower().
+     * Larger windows need fewer multiplies, but a table of 2**WINDOW entries.
+     */
+    static constexpr int WINDOW = N <= 256 ? 3 : (N <= 768 ? 4 : 5);
+
+    /** Number of digits from which a separate square and reduction is faster than CIOS.
+     */
+    static constexpr int MONTGOMERY_SQUARE_DIGITS = 6;
+
+    BigInt<N> modulus;
+
+    /** -1 / modulus mod 2**64.
+     */
+    uint64_t modulusInverse;
+
+    /** R mod modulus, which is 1 in Montgomery form.
+     */
+    BigInt<N> r1;
+
+    /** R**2 mod modulus, used to convert to Montgomery form.
+     */
+    BigInt<N> r2;
+
+    template<int M>
+    explicit MontgomeryContext(const BigInt<M> &modulus) :
+        modulus(modulus), modulusInverse(0), r1(0), r2(0)
+    {
+        if (!this->modulus.getBit(0)) {
+            BOOST_THROW_EXCEPTION(bigint_montgomery_error());
+        }
+
+        // Newton iteration, each step doubles the number of correct bits.
+        uint64_t inverse = 1;
+        for (int i = 0; i < 6; i++) {
+            inverse *= 2 - this->modulus.digits[0] * inverse;
+        }
+        modulusInverse = -inverse;
+
+        // Calculate R and R**2 by doubling 1 modulo the modulus.
+        auto x = BigInt<N>(1);
+        for (int i = 0; i < 2 * 64 * DIGITS; i++) {
+            x = modularDouble(x);
+            if (i == 64 * DIGITS - 1) {
+                r1 = x;
+            }
+        }
+        r2 = x;
+    }
+
+    /** 1 in Montgomery form.
+     */
+    inline const BigInt<N> &one(void) const {
+        return r1;
+    }
+
+    /** Convert to Montgomery form.
+     * The value does not need to be smaller than the modulus.
+     */
+    inline BigInt<N> toMontgomery(const BigInt<N> &x) const {
+        return multiply(x, r2);
+    }
+
+    /** Convert from Montgomery form.
+     */
+    inline BigInt<N> fromMontgomery(const BigInt<N> &x) const {
+        return multiply(x, BigInt<N>(1));
+    }
+
+    /** Montgomery multiplication `a * b / R mod modulus`.
+     * The product of a and b must be smaller than `modulus * R`.
+     */
+    inline BigInt<N> multiply(const BigInt<N> &a, const BigInt<N> &b) const {
+        intel_intrinsic_uint64 t[DIGITS + 2];
+        memset(t, 0, sizeof (t));
+
+        for (int i = 0; i < DIGITS; i++) {
+            // t += a * b[i]
+            unsigned char carryLo = 0;
+            unsigned char carryHi = 0;
+            for (int j = 0; j < DIGITS; j++) {
+                intel_intrinsic_uint64 hi;
+                intel_intrinsic_uint64 lo = _mulx_u64(a.digits[j], b.digits[i], &hi);
+                carryLo = _addcarryx_u64(carryLo, t[j], lo, &t[j]);
+                carryHi = _addcarryx_u64(carryHi, t[j + 1], hi, &t[j + 1]);
+            }
+            carryLo = _addcarryx_u64(carryLo, t[DIGITS], 0, &t[DIGITS]);
+            t[DIGITS + 1] += carryLo + carryHi;
+
+            // t = (t + q * modulus) / 2**64, the lowest digit becomes zero and is dropped.
+            uint64_t q = t[0] * modulusInverse;
+            carryLo = 0;
+            carryHi = 0;
+            for (int j = 0; j < DIGITS; j++) {
+                intel_intrinsic_uint64 hi;
+                intel_intrinsic_uint64 lo = _mulx_u64(modulus.digits[j], q, &hi);
+                intel_intrinsic_uint64 sum;
+                carryLo = _addcarryx_u64(carryLo, t[j], lo, &sum);
+                carryHi = _addcarryx_u64(carryHi, t[j + 1], hi, &t[j + 1]);
+                if (j > 0) {
+                    t[j - 1] = sum;
+                }
+            }
+            carryLo = _addcarryx_u64(carryLo, t[DIGITS], 0, &t[DIGITS - 1]);
+            t[DIGITS] = t[DIGITS + 1] + carryLo + carryHi;
+            t[DIGITS + 1] = 0;
+        }
+
+        return reduce(t);
+    }
+
+    /** Montgomery squaring `a * a / R mod modulus`.
+     * For large moduli the square is calculated separately from the reduction,
+     * so that the cross products are only calculated once.
+     */
+    inline BigInt<N> square(const BigInt<N> &a) const {
+        if constexpr (DIGITS < MONTGOMERY_SQUARE_DIGITS) {
+            return multiply(a, a);
+
+        } else {
+            // The digits are copied, because uint64_t and intel_intrinsic_uint64
+            // are distinct types which may not alias.
+            intel_intrinsic_uint64 x[DIGITS];
+            memcpy(x, a.digits, sizeof (x));
+
+            intel_intrinsic_uint64 t[2 * DIGITS + 1];
+            bigIntSquare<DIGITS>(t, x);
+            t[2 * DIGITS] = 0;
+            return reduceWide(t);
+        }
+    }
+
+    /** Read an entry of a table, in constant time.
+     * Every entry is read and masked, so that the index does not leak
+     * through the cache.
+     */
+    inline BigInt<N> select(const BigInt<N> *table, int size, uint64_t index) const {
+        auto r = BigInt<N>(0);
+
+        for (uint64_t i = 0; i < static_cast<uint64_t>(size); i++) {
+            uint64_t mask = -static_cast<uint64_t>(i == index);
+            for (int j = 0; j < DIGITS; j++) {
+                r.digits[j] |= table[i].digits[j] & mask;
+            }
+        }
+        return r;
+    }
+
+    /** 2**exponent in Montgomery form, the fast path for generator 2.
+     * Multiplying by 2 is a shift followed by a conditional subtraction,
+     * so each bit of the exponent costs a squaring and a cheap doubling,
+     * instead of a Montgomery multiply. The doubling is always executed and
+     * selected with a mask, for constant cpu time.
+     */
+    inline BigInt<N> powerOfTwo(const BigInt<N> &exponent) const {
+        auto result = one();
+
+        for (int i = N - 1; i >= 0; i--) {
+            result = square(result);
+            auto doubled = modularDouble(result);
+
+            uint64_t mask = -static_cast<uint64_t>(exponent.getBit(i));
+            for (int j = 0; j < DIGITS; j++) {
+                result.digits[j] = (doubled.digits[j] & mask) | (result.digits[j] & ~mask);
+            }
+        }
+        return result;
+    }
+
+private:
+    /** Montgomery reduction `t / R mod modulus`.
+     *
+     * @param t Value smaller than `modulus * R` of 2 * DIGITS + 1 digits,
+     *          which is overwritten.
+     */
+    inline BigInt<N> reduceWide(intel_intrinsic_uint64 *t) const {
+        unsigned char top = 0;
+        for (int i = 0; i < DIGITS; i++) {
+            // t += q * modulus * 2**(64 * i), which makes digit i zero.
+            uint64_t q = t[i] * modulusInverse;
+            intel_intrinsic_uint64 carry = 0;
+            for (int j = 0; j < DIGITS; j++) {
+                intel_intrinsic_uint64 hi;
+                intel_intrinsic_uint64 lo = _mulx_u64(modulus.digits[j], q, &hi);
+                hi += _addcarryx_u64(0, t[i + j], lo, &t[i + j]);
+                hi += _addcarryx_u64(0, t[i + j], carry, &t[i + j]);
+                carry = hi;
+            }
+            auto c = _addcarryx_u64(0, t[i + DIGITS], carry, &t[i + DIGITS]);
+            c += _addcarryx_u64(0, t[i + DIGITS], top, &t[i + DIGITS]);
+            top = c;
+        }
+        t[2 * DIGITS] += top;
+
+        return reduce(t + DIGITS);
+    }
+
+    /** Subtract the modulus from t when t is larger, in constant time.
+     *
+     * @param t Value smaller than `2 * modulus` of DIGITS + 1 digits.
+     */
+    inline BigInt<N> reduce(const intel_intrinsic_uint64 *t) const {
+        BigInt<N> r;
+        intel_intrinsic_uint64 u[DIGITS];
+
+        char borrow = 0;
+        for (int i = 0; i < DIGITS; i++) {
+            borrow = fixed_subborrow_u64(borrow, t[i], modulus.digits[i], &u[i]);
+        }
+
+        // Use the subtraction when it did not underflow, or t had a carry digit.
+        uint64_t mask = -static_cast<uint64_t>((borrow == 0) | (t[DIGITS] != 0));
+        for (int i = 0; i < DIGITS; i++) {
+            r.digits[i] = (u[i] & mask) | (t[i] & ~mask);
+        }
+        return r;
+    }
+
+    /** 2 * x mod modulus, for x smaller than the modulus.
+     */
+    inline BigInt<N> modularDouble(const BigInt<N> &x) const {
+        intel_intrinsic_uint64 t[DIGITS + 1];
+
+        uint64_t carry = 0;
+        for (int i = 0; i < DIGITS; i++) {
+            t[i] = (x.digits[i] << 1) | carry;
+            carry = x.digits[i] >> 63;
+        }
+        t[DIGITS] = carry;
+
+        return reduce(t);
+    }
+};
+
+/** Modular exponentiation of a fixed base, using a precomputed comb.
+ * https://en.wikipedia.org/wiki/Exponentiation_by_squaring#Fixed-base_exponent
+ *
+ * The exponent is split into TEETH blocks of SPACING bits (Lim-Lee comb).
+ * The table holds for every combination of blocks the product of
+ * `base**(2**(SPACING * k))` of those blocks. The exponentiation then
+ * takes one bit from each block per step, so that it needs only SPACING
+ * squarings and multiplies, instead of N squarings.
+ *
+ * Table entries are read with a masked scan over the whole table.
+ *
+ * @param N Width of the modulus in bits.
+ */
+template<int N>
+struct MontgomeryFixedBase {
+    static constexpr int TEETH = 6;
+    static constexpr int TABLE_SIZE = 1 << TEETH;
+    static constexpr int SPACING = (N + TEETH - 1) / TEETH;
+
+    MontgomeryContext<N> mc;
+    std::vector<BigInt<N>> table;
+
+    MontgomeryFixedBase(const BigInt<N> &base, const MontgomeryContext<N> &mc) :
+        mc(mc), table(TABLE_SIZE)
+    {
+        // base**(2**(SPACING * k)) at the power of two entries.
+        table[0] = mc.one();
+        table[1] = mc.toMontgomery(base);
+        for (int k = 1; k < TEETH; k++) {
+            auto x = table[1 << (k - 1)];
+            for (int i = 0; i < SPACING; i++) {
+                x = mc.square(x);
+            }
+            table[1 << k] = x;
+        }
+
+        // Other entries are the product of a smaller entry and a power of two entry.
+        for (int i = 3; i < TABLE_SIZE; i++) {
+            auto low = i & -i;
+            if (low != i) {
+                table[i] = mc.multiply(table[i - low], table[low]);
+            }
+        }
+    }
+
+    inline BigInt<N> modularPower(const BigInt<N> &exponent) const {
+        auto result = mc.one();
+
+        for (int j = SPACING - 1; j >= 0; j--) {
+            result = mc.square(result);
+
+            uint64_t index = 0;
+            for (int k = 0; k < TEETH; k++) {
+                auto bit = SPACING * k + j;
+                index |= static_cast<uint64_t>(bit < N && exponent.getBit(bit)) << k;
+            }
+            result = mc.multiply(result, mc.select(table.data(), TABLE_SIZE, index));
+        }
+
+        return mc.fromMontgomery(result);
+    }
+};
+
 #undef NR_DIGITS
 };};
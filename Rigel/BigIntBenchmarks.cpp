@@ -0,0 +1,150 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** Benchmarks of the big integer arithmetic of Diffie-Hellman.
+ *
+ * For each RFC group size this reports the time of the Montgomery
+ * operations, the squaring routines and a full key exchange.
+ *
+ * Usage: BigIntBenchmarks [--filter <text>] [--time <seconds>]
+ *  --filter   Only run the benchmarks with the text in their name.
+ *  --time     Minimum duration of each benchmark, default 0.1 seconds.
+ */
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include "BigInt.hpp"
+#include "DiffieHellman.hpp"
+
+using namespace std;
+using namespace Orion::Rigel;
+
+static string filter;
+static double minimumTime = 0.1;
+
+/** Used to keep the compiler from optimizing away the calculations.
+ */
+static volatile uint64_t sink;
+
+/** Run a function repeatedly and report the time per call.
+ *
+ * @param name Name of the benchmark.
+ * @param f The function to benchmark.
+ */
+static void benchmark(const string &name, const function<void(void)> &f)
+{
+    if (name.find(filter) == string::npos) {
+        return;
+    }
+
+    size_t iterations = 1;
+    chrono::duration<double> duration;
+    while (true) {
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            f();
+        }
+        duration = chrono::steady_clock::now() - start;
+
+        if (duration.count() >= minimumTime) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    cout << name << ": " << duration.count() * 1e6 / iterations << " us/operation" << endl;
+}
+
+template<int M>
+static void benchmarkGroup(const string &name, const BigInt<M> &g, const BigInt<M> &m)
+{
+    auto mc = MontgomeryContext<M>(m);
+    auto a = mc.toMontgomery(BigIntRandom<M>());
+    auto b = mc.toMontgomery(BigIntRandom<M>());
+    auto exponent = BigIntRandom<M>();
+
+    benchmark(name + " multiply", [&]() {
+        sink = (a * b).digits[0];
+    });
+    benchmark(name + " square comba", [&]() {
+        intel_intrinsic_uint64 t[2 * sizeof (a.digits) / sizeof (a.digits[0])];
+        bigIntSquareComba<sizeof (a.digits) / sizeof (a.digits[0])>(t, reinterpret_cast<const intel_intrinsic_uint64 *>(a.digits));
+        sink = t[0];
+    });
+    benchmark(name + " square", [&]() {
+        sink = a.square().digits[0];
+    });
+    benchmark(name + " montgomery multiply", [&]() {
+        sink = mc.multiply(a, b).digits[0];
+    });
+    benchmark(name + " montgomery square", [&]() {
+        sink = mc.square(a).digits[0];
+    });
+    auto wide = BigIntRandom<2 * M>();
+    benchmark(name + " division", [&]() {
+        sink = (wide % m).digits[0];
+    });
+    benchmark(name + " division variable time", [&]() {
+        BigInt<2 * M> q;
+        sink = q.initDivisionVariableTime(wide, m).digits[0];
+    });
+    benchmark(name + " barret setup", [&]() {
+        sink = BarretReduction<M + 1>(m).r.digits[0];
+    });
+    benchmark(name + " modular power", [&]() {
+        sink = b.modularPower(exponent, mc).digits[0];
+    });
+
+    auto &table = generatorTable(g, mc);
+    benchmark(name + " generator power", [&]() {
+        sink = table.modularPower(exponent).digits[0];
+    });
+
+    auto A = DiffieHellman<M>(g, m);
+    benchmark(name + " key exchange", [&]() {
+        auto C = DiffieHellman<M>(g, m);
+        sink = C.getKeyingMaterial(A.myPublicKey).digits[0];
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        auto option = string(argv[i]);
+        if (i + 1 == argc) {
+            cerr << "Missing value for " << option << endl;
+            return 1;
+        } else if (option == "--filter") {
+            filter = argv[++i];
+        } else if (option == "--time") {
+            minimumTime = stod(argv[++i]);
+        } else {
+            cerr << "Unknown option " << option << endl;
+            return 1;
+        }
+    }
+
+    benchmarkGroup("group 1", group_1_g, group_1_m);
+    benchmarkGroup("group 2", group_2_g, group_2_m);
+    benchmarkGroup("group 5", group_5_g, group_5_m);
+    benchmarkGroup("group 14", group_14_g, group_14_m);
+    benchmarkGroup("group 15", group_15_g, group_15_m);
+    benchmarkGroup("group 16", group_16_g, group_16_m);
+    benchmarkGroup("group 17", group_17_g, group_17_m);
+    benchmarkGroup("group 18", group_18_g, group_18_m);
+    return 0;
+}
@@ -351,5 +351,193 @@ BOOST_AUTO_TEST_CASE(TestModularPower)
     );
 }
 
+BOOST_AUTO_TEST_CASE(TestMontgomery)
+{
+    auto m = BigInt<1536>("0xffffffffffffffffc90fdaa22168c234c4c6628b80dc1cd129024e088a67cc74020bbea63b139b22514a08798e3404ddef9519b3cd3a431b302b0a6df25f14374fe1356d6d51c245e485b576625e7ec6f44c42e9a637ed6b0bff5cb6f406b7edee386bfb5a899fa5ae9f24117c4b1fe649286651ece45b3dc2007cb8a163bf0598da48361c55d39a69163fa8fd24cf5f83655d23dca3ad961c62f356208552bb9ed529077096966d670c354e4abc9804f1746c08ca237327ffffffffffffffff");
+    auto mc = MontgomeryContext<1536>(m);
+    auto br = BarretReduction<1537>(m);
+
+    BOOST_CHECK_EQUAL(mc.fromMontgomery(mc.one()), BigInt<1536>(1));
+    BOOST_CHECK_EQUAL(mc.r2, br.modulo(mc.r1 * mc.r1));
+
+    for (int i = 0; i < 10; i++) {
+        auto a = BigInt<1536>(br.modulo(BigIntRandom<1536>()));
+        auto b = BigInt<1536>(br.modulo(BigIntRandom<1536>()));
+
+        auto product = mc.multiply(mc.toMontgomery(a), mc.toMontgomery(b));
+        BOOST_CHECK_EQUAL(mc.fromMontgomery(product), br.modulo(a * b));
+        BOOST_CHECK_EQUAL(mc.fromMontgomery(mc.square(mc.toMontgomery(a))), br.modulo(a * a));
+    }
+
+    // Values larger than the modulus are reduced when converted to Montgomery form.
+    auto x = BigInt<1536>("0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    BOOST_CHECK_EQUAL(mc.fromMontgomery(mc.toMontgomery(x)), br.modulo(x));
 
+    // Modulus that is not a multiple of 64 bits.
+    auto small = BigInt<100>("0xfffffffffffffffffffffffe5");
+    auto exponent = BigInt<100>("0x123456789abcdef0123456789");
+    BOOST_CHECK_EQUAL(
+        BigInt<100>(3).modularPower(exponent, MontgomeryContext<100>(small)),
+        BigInt<100>(3).modularPower(exponent, BarretReduction<101>(small))
+    );
+
+    BOOST_CHECK_THROW(MontgomeryContext<64>(BigInt<64>(10)), bigint_montgomery_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestWindowedModularPower)
+{
+    BOOST_CHECK_EQUAL(BigInt<256>("0x123456789abcdef").getBits(4, 8), 0xdeU);
+    BOOST_CHECK_EQUAL(BigInt<256>("0x123456789abcdef0000000000000000").getBits(60, 8), 0xf0U);
+    BOOST_CHECK_EQUAL(BigInt<100>("0xfffffffffffffffffffffffff").getBits(95, 10), 0x1fU);
+
+    // Compare with the square-and-multiply of the Barret Reduction,
+    // for each size of window.
+    auto m1 = BigInt<192>("0xfffffffffffffffffffffffffffffffeffffffffffffffff");
+    auto m2 = BigInt<768>("0xFFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F14374FE1356D6D51C245E485B576625E7EC6F44C42E9A63A3620FFFFFFFFFFFFFFFF");
+    auto m3 = BigInt<1536>("0xffffffffffffffffc90fdaa22168c234c4c6628b80dc1cd129024e088a67cc74020bbea63b139b22514a08798e3404ddef9519b3cd3a431b302b0a6df25f14374fe1356d6d51c245e485b576625e7ec6f44c42e9a637ed6b0bff5cb6f406b7edee386bfb5a899fa5ae9f24117c4b1fe649286651ece45b3dc2007cb8a163bf0598da48361c55d39a69163fa8fd24cf5f83655d23dca3ad961c62f356208552bb9ed529077096966d670c354e4abc9804f1746c08ca237327ffffffffffffffff");
+
+    for (int i = 0; i < 4; i++) {
+        auto e1 = BigIntRandom<192>();
+        auto e2 = BigIntRandom<768>();
+        auto e3 = BigIntRandom<1536>();
+        BOOST_CHECK_EQUAL(BigInt<192>(7).modularPower(e1, m1), BigInt<192>(7).modularPower(e1, BarretReduction<193>(m1)));
+        BOOST_CHECK_EQUAL(BigInt<768>(2).modularPower(e2, m2), BigInt<768>(2).modularPower(e2, BarretReduction<769>(m2)));
+        BOOST_CHECK_EQUAL(BigInt<1536>(2).modularPower(e3, m3), BigInt<1536>(2).modularPower(e3, BarretReduction<1537>(m3)));
+    }
+
+    BOOST_CHECK_EQUAL(BigInt<1536>(5).modularPower(BigInt<1536>(0), m3), BigInt<1536>(1));
+    BOOST_CHECK_EQUAL(BigInt<1536>(5).modularPower(BigInt<1536>(1), m3), BigInt<1536>(5));
+}
+
+BOOST_AUTO_TEST_CASE(TestFixedBase)
+{
+    auto m1 = BigInt<100>("0xfffffffffffffffffffffffe5");
+    auto m2 = BigInt<1536>("0xffffffffffffffffc90fdaa22168c234c4c6628b80dc1cd129024e088a67cc74020bbea63b139b22514a08798e3404ddef9519b3cd3a431b302b0a6df25f14374fe1356d6d51c245e485b576625e7ec6f44c42e9a637ed6b0bff5cb6f406b7edee386bfb5a899fa5ae9f24117c4b1fe649286651ece45b3dc2007cb8a163bf0598da48361c55d39a69163fa8fd24cf5f83655d23dca3ad961c62f356208552bb9ed529077096966d670c354e4abc9804f1746c08ca237327ffffffffffffffff");
+    auto mc1 = MontgomeryContext<100>(m1);
+    auto mc2 = MontgomeryContext<1536>(m2);
+    auto fb1 = MontgomeryFixedBase<100>(BigInt<100>(3), mc1);
+    auto fb2 = MontgomeryFixedBase<1536>(BigInt<1536>(2), mc2);
+    auto fb3 = MontgomeryFixedBase<1536>(BigInt<1536>(12345), mc2);
+
+    for (int i = 0; i < 4; i++) {
+        auto e1 = BigIntRandom<100>();
+        auto e2 = BigIntRandom<1536>();
+        BOOST_CHECK_EQUAL(fb1.modularPower(e1), BigInt<100>(3).modularPower(e1, BarretReduction<101>(m1)));
+        BOOST_CHECK_EQUAL(fb2.modularPower(e2), BigInt<1536>(2).modularPower(e2, BarretReduction<1537>(m2)));
+        BOOST_CHECK_EQUAL(fb3.modularPower(e2), BigInt<1536>(12345).modularPower(e2, BarretReduction<1537>(m2)));
+
+        // The fast path for a generator of 2.
+        BOOST_CHECK_EQUAL(BigInt<1536>(2).modularPower(e2, mc2), fb2.modularPower(e2));
+    }
+
+    BOOST_CHECK_EQUAL(fb2.modularPower(BigInt<1536>(0)), BigInt<1536>(1));
+    BOOST_CHECK_EQUAL(fb2.modularPower(BigInt<1536>(10)), BigInt<1536>(1024));
+}
+
+template<int N>
+static void checkSquare(void)
+{
+    for (int i = 0; i < 4; i++) {
+        auto a = BigIntRandom<N>();
+        BOOST_CHECK_EQUAL(a.square(), a * a);
+    }
 
+    // All digits set, to test the carries.
+    auto ones = BigInt<N>(0);
+    for (int i = 0; i < N; i++) {
+        ones.setBit(i, true);
+    }
+    BOOST_CHECK_EQUAL(ones.square(), ones * ones);
+
+    // Halves that are equal, so that their difference is zero.
+    auto halves = BigInt<N>(0);
+    auto x = BigIntRandom<N / 2>();
+    halves.initAdd(BigInt<N>(x) << (N / 2), x);
+    BOOST_CHECK_EQUAL(halves.square(), halves * halves);
+}
+
+BOOST_AUTO_TEST_CASE(TestSquare)
+{
+    checkSquare<64>();
+    checkSquare<100>();
+    checkSquare<1536>();
+    checkSquare<2048>();
+    checkSquare<3072>();
+    checkSquare<4096>();
+    checkSquare<8192>();
+
+    // Montgomery squaring with a separate reduction.
+    auto m = BigInt<4096>(
+        "0xFFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74020BBEA63B139B22514A08798E3404DD"
+          "EF9519B3CD3A431B302B0A6DF25F14374FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+          "EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF0598DA48361C55D39A69163FA8FD24CF5F"
+          "83655D23DCA3AD961C62F356208552BB9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+          "E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF6955817183995497CEA956AE515D2261898FA0510"
+          "15728E5A8AAAC42DAD33170D04507A33A85521ABDF1CBA64ECFB850458DBEF0A8AEA71575D060C7DB3970F85A6E1E4C7"
+          "ABF5AE8CDB0933D71E8C94E04A25619DCEE3D2261AD2EE6BF12FFA06D98A0864D87602733EC86A64521F2B18177B200C"
+          "BBE117577A615D6C770988C0BAD946E208E24FA074E5AB3143DB5BFCE0FD108E4B82D120A92108011A723C12A787E6D7"
+          "88719A10BDBA5B2699C327186AF4E23C1A946834B6150BDA2583E9CA2AD44CE8DBBBC2DB04DE8EF92E8EFC141FBECAA6"
+          "287C59474E6BC05D99B2964FA090C3A2233BA186515BE7ED1F612970CEE2D7AFB81BDD762170481CD0069127D5B05AA9"
+          "93B4EA988D8FDDC186FFB7DC90A6C08F4DF435C934063199FFFFFFFFFFFFFFFF"
+    );
+    auto mc = MontgomeryContext<4096>(m);
+    for (int i = 0; i < 4; i++) {
+        auto a = mc.toMontgomery(BigIntRandom<4096>());
+        BOOST_CHECK_EQUAL(mc.square(a), mc.multiply(a, a));
+    }
+    auto mMinusOne = m - BigInt<4096>(1);
+    BOOST_CHECK_EQUAL(mc.square(mMinusOne), mc.multiply(mMinusOne, mMinusOne));
+}
+
+template<int A, int B>
+static void checkDivision(const BigInt<A> &a, const BigInt<B> &b)
+{
+    BigInt<A> q1;
+    BigInt<A> q2;
+    auto r1 = q1.initDivision(a, b);
+    auto r2 = q2.initDivisionVariableTime(a, b);
+
+    BOOST_CHECK_EQUAL(q1, q2);
+    BOOST_CHECK_EQUAL(r1, r2);
+    BOOST_CHECK(r1 < b);
+    BOOST_CHECK_EQUAL(BigInt<A>(q1 * b + r1), a);
+}
+
+BOOST_AUTO_TEST_CASE(TestKnuthDivision)
+{
+    for (int i = 0; i < 10; i++) {
+        checkDivision(BigIntRandom<4096>(), BigIntRandom<1536>());
+        checkDivision(BigIntRandom<4096>(), BigIntRandom<64>());
+        checkDivision(BigIntRandom<4096>(), BigIntRandom<4000>());
+        checkDivision(BigIntRandom<192>(), BigIntRandom<130>() >> 60);
+        checkDivision(BigIntRandom<100>(), BigIntRandom<256>());
+    }
+
+    // Remainders whose top digit equals the top digit of the divisor,
+    // and estimates of the quotient that are too large.
+    checkDivision(
+        BigInt<256>("0x7fffffffffffffff800000000000000000000000000000000000000000000000"),
+        BigInt<192>("0x800000000000000000000000000000000000000000000001")
+    );
+    checkDivision(
+        BigInt<256>("0x8000000000000000fffffffffffffffe0000000000000000"),
+        BigInt<128>("0x8000000000000000ffffffffffffffff")
+    );
+    checkDivision(
+        BigInt<256>("0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"),
+        BigInt<128>("0xffffffffffffffffffffffffffffffff")
+    );
+    checkDivision(
+        BigInt<256>("0x7fffffffffffffffffffffffffffffff00000000000000000000000000000000"),
+        BigInt<128>("0x80000000000000000000000000000001")
+    );
+    checkDivision(BigInt<256>(5), BigInt<256>("0x10000000000000000"));
+
+    // The scaled one of a Barret Reduction.
+    auto modulus = BigIntRandom<4096>();
+    modulus.setBit(4095, true);
+    checkDivision(BigIntHighbit<8195>(), modulus);
+
+    auto q = BigInt<256>();
+    BOOST_CHECK_THROW(q.initDivision(BigInt<256>(1), BigInt<256>(0)), bigint_division_error);
+}
@@ -0,0 +1,91 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <type_traits>
+
+#include "Time.hpp"
+
+namespace Orion {
+namespace Rigel {
+
+/** Compressed Binary Object Notation.
+ * A length-prefixed alternative to RSON, every container is counted up front
+ * so that a decoder can pre-size containers.
+ *
+ * Documentation for CBSON binary format can be found here: [CBSON.md](../Alnitak/CBSON.md).
+ */
+const uint8_t CBSON_SMALL_INTEGER_CODE = 0x00;
+const uint8_t CBSON_INTEGER_CODE = 0x10;
+const uint8_t CBSON_INTERNED_REFERENCE_CODE = 0x20;
+const uint8_t CBSON_BYTE_ARRAY_CODE = 0x40;
+const uint8_t CBSON_FALSE_CODE = 0x50;
+const uint8_t CBSON_TRUE_CODE = 0x51;
+const uint8_t CBSON_NONE_CODE = 0x52;
+const uint8_t CBSON_STRING_CODE = 0x53;
+const uint8_t CBSON_INTERNED_STRING_CODE = 0x54;
+const uint8_t CBSON_FLOAT_CODE = 0x55;
+const uint8_t CBSON_DOUBLE_CODE = 0x56;
+const uint8_t CBSON_UUID_CODE = 0x57;
+const uint8_t CBSON_TIMESTAMP_CODE = 0x58;
+const uint8_t CBSON_LIST_CODE = 0x60;
+const uint8_t CBSON_DICTIONARY_CODE = 0x70;
+
+/** The opcode of a counted field, without its length nibble.
+ */
+static inline uint8_t cbsonOpcode(uint8_t c)
+{
+    return (c >= CBSON_FALSE_CODE && c < CBSON_LIST_CODE) ? c : (c & 0xf0);
+}
+
+/** Lengths up to this value are stored in the length nibble of the code.
+ */
+const uint8_t CBSON_MAXIMUM_SHORT_LENGTH = 12;
+
+/** Timestamps are encoded as nanoseconds since 2010, this is 2010 in Time.
+ */
+const int64_t CBSON_TIMESTAMP_EPOCH = 1262304000LL * 1000000000LL;
+
+/** A 128 bit universally unique identifier.
+ */
+struct UUID {
+    std::array<uint8_t, 16> bytes;
+
+    inline bool operator==(const UUID &other) const {
+        return bytes == other.bytes;
+    }
+
+    inline bool operator!=(const UUID &other) const {
+        return bytes != other.bytes;
+    }
+};
+
+/** ZigZag encode a signed integer, so that small negative numbers are small.
+ */
+static inline unsigned __int128 zigZagEncode(__int128 value)
+{
+    return (static_cast<unsigned __int128>(value) << 1) ^ static_cast<unsigned __int128>(value >> 127);
+}
+
+static inline __int128 zigZagDecode(unsigned __int128 value)
+{
+    return static_cast<__int128>(value >> 1) ^ -static_cast<__int128>(value & 1);
+}
+
+};};
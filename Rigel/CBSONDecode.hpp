@@ -0,0 +1,468 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <type_traits>
+#include <boost/any.hpp>
+#include <boost/none.hpp>
+#include <boost/exception/all.hpp>
+
+#include "CBSON.hpp"
+#include "CBSONInternTable.hpp"
+#include "RSONDecode.hpp"
+
+namespace Orion {
+namespace Rigel {
+
+/** Read cursor over a buffer of CBSON encoded data.
+ * When the cursor has an intern table, interned strings are added to and
+ * looked up in the table. The table is shared by all messages received on
+ * a connection, and must have the same budget as the table of the encoder.
+ */
+struct CBSONCursor: RSONCursor {
+    CBSONInternTable *strings;
+
+    inline CBSONCursor(const uint8_t *data, size_t size, CBSONInternTable *strings = nullptr) :
+        RSONCursor(data, size), strings(strings) {}
+
+    explicit inline CBSONCursor(const std::string &str, CBSONInternTable *strings = nullptr) :
+        RSONCursor(str), strings(strings) {}
+};
+
+// Forward for decoding anything in a list and dictionary.
+static inline boost::any decodeCBSON(CBSONCursor &cursor, size_t maximumDepth = RSON_MAXIMUM_DEPTH);
+
+/** Decode the length of a counted code.
+ * A length must be stored in the least amount of bytes, otherwise
+ * decode_value_error is thrown.
+ *
+ * @param cursor Cursor pointing just after the code.
+ * @param c The code.
+ * @return The length stored in the code, or in the bytes following it.
+ */
+static inline uint32_t decodeCBSONLength(CBSONCursor &cursor, uint8_t c)
+{
+    auto nibble = c & 0x0f;
+    if (nibble <= CBSON_MAXIMUM_SHORT_LENGTH) {
+        return nibble;
+    }
+
+    size_t size = nibble == 13 ? 1 : (nibble == 14 ? 2 : 4);
+    cursor.require(size);
+
+    uint32_t length = 0;
+    for (size_t i = 0; i < size; i++) {
+        length |= static_cast<uint32_t>(cursor.ptr[i]) << (i * 8);
+    }
+    cursor.ptr += size;
+
+    uint32_t minimum = size == 1 ? CBSON_MAXIMUM_SHORT_LENGTH + 1 : (size == 2 ? 0x100 : 0x10000);
+    if (length < minimum) {
+        BOOST_THROW_EXCEPTION(decode_value_error());
+    }
+    return length;
+}
+
+/** Check that the bytes of a long integer are the least amount needed.
+ * The last byte must not be zero, and values up to 15 belong in the code.
+ *
+ * @param ptr The little endian bytes of the ZigZag encoded integer.
+ * @param size The number of bytes.
+ */
+static inline void checkCBSONInteger(const uint8_t *ptr, size_t size)
+{
+    if (size == 0 || ptr[size - 1] == 0 || (size == 1 && ptr[0] <= 0xf)) {
+        BOOST_THROW_EXCEPTION(decode_value_error());
+    }
+}
+
+/** Decode the length of a counted field with the given opcode.
+ *
+ * @return The number of bytes or items that follow.
+ */
+static inline uint32_t decodeCBSONCode(CBSONCursor &cursor, uint8_t opcode)
+{
+    auto c = cursor.get();
+    if (cbsonOpcode(c) != opcode) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+    return decodeCBSONLength(cursor, c);
+}
+
+template<typename T, typename std::enable_if<std::is_same<bool, T>::value, int>::type = 0>
+static inline T decodeCBSON(CBSONCursor &cursor)
+{
+    switch (auto c = cursor.get()) {
+    case CBSON_TRUE_CODE: return true;
+    case CBSON_FALSE_CODE: return false;
+    default: BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+}
+
+template<typename T, typename std::enable_if<std::is_same<boost::none_t, T>::value, int>::type = 0>
+static inline T decodeCBSON(CBSONCursor &cursor)
+{
+    auto c = cursor.get();
+    if (c != CBSON_NONE_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+    return boost::none;
+}
+
+template<typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<bool, T>::value, int>::type = 0>
+static inline T decodeCBSON(CBSONCursor &cursor)
+{
+    unsigned __int128 z;
+
+    auto c = cursor.get();
+    switch (cbsonOpcode(c)) {
+    case CBSON_SMALL_INTEGER_CODE:
+        z = c & 0x0f;
+        break;
+
+    case CBSON_INTEGER_CODE:
+        {
+            auto size = decodeCBSONLength(cursor, c);
+            if (size > sizeof (z)) {
+                BOOST_THROW_EXCEPTION(decode_overflow_error());
+            }
+            cursor.require(size);
+            checkCBSONInteger(cursor.ptr, size);
+
+            z = 0;
+            for (size_t i = 0; i < size; i++) {
+                z |= static_cast<unsigned __int128>(cursor.ptr[i]) << (i * 8);
+            }
+            cursor.ptr += size;
+        }
+        break;
+
+    default:
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    auto value = zigZagDecode(z);
+    if (value < static_cast<__int128>(std::numeric_limits<T>::min()) || value > static_cast<__int128>(std::numeric_limits<T>::max())) {
+        BOOST_THROW_EXCEPTION(decode_overflow_error());
+    }
+    return static_cast<T>(value);
+}
+
+/** Decode a floating point number.
+ * Both single and double precision numbers are accepted.
+ */
+template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+static inline T decodeCBSON(CBSONCursor &cursor)
+{
+    switch (auto c = cursor.get()) {
+    case CBSON_FLOAT_CODE:
+        {
+            float value;
+            cursor.require(sizeof (value));
+            memcpy(&value, cursor.ptr, sizeof (value));
+            cursor.ptr += sizeof (value);
+            return static_cast<T>(value);
+        }
+
+    case CBSON_DOUBLE_CODE:
+        {
+            double value;
+            cursor.require(sizeof (value));
+            memcpy(&value, cursor.ptr, sizeof (value));
+            cursor.ptr += sizeof (value);
+            return static_cast<T>(value);
+        }
+
+    default:
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+}
+
+/** Decode a string, which may be interned.
+ *
+ * @param cursor Cursor pointing to the string, on return it points just after the string.
+ * @return The string, which is only valid until the next string is interned.
+ */
+static inline std::string_view decodeCBSONString(CBSONCursor &cursor)
+{
+    auto c = cursor.get();
+    switch (cbsonOpcode(c)) {
+    case CBSON_STRING_CODE:
+    case CBSON_INTERNED_STRING_CODE:
+        {
+            auto start = cursor.ptr;
+            auto mark = skipMark(cursor);
+            auto value = std::string_view(reinterpret_cast<const char *>(start), mark - start);
+
+            if (c == CBSON_INTERNED_STRING_CODE) {
+                if (cursor.strings == nullptr) {
+                    BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+                } else if (!cursor.strings->fits(value)) {
+                    BOOST_THROW_EXCEPTION(decode_value_error());
+                }
+                cursor.strings->insert(value);
+            }
+            return value;
+        }
+
+    case CBSON_INTERNED_REFERENCE_CODE:
+        {
+            if (cursor.strings == nullptr) {
+                BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+            }
+            auto index = decodeCBSONLength(cursor, c);
+            auto value = cursor.strings->get(index);
+            if (value == nullptr) {
+                BOOST_THROW_EXCEPTION(decode_index_error() << index_info(index));
+            }
+            return *value;
+        }
+
+    default:
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+}
+
+template<typename T, typename std::enable_if<std::is_same<std::string, T>::value, int>::type = 0>
+static inline T decodeCBSON(CBSONCursor &cursor)
+{
+    return T(decodeCBSONString(cursor));
+}
+
+template<typename T, typename std::enable_if<std::is_same<std::basic_string<uint8_t>, T>::value, int>::type = 0>
+static inline T decodeCBSON(CBSONCursor &cursor)
+{
+    auto size = decodeCBSONCode(cursor, CBSON_BYTE_ARRAY_CODE);
+    cursor.require(size);
+
+    auto r = T(cursor.ptr, size);
+    cursor.ptr += size;
+    return r;
+}
+
+template<typename T, typename std::enable_if<std::is_same<UUID, T>::value, int>::type = 0>
+static inline T decodeCBSON(CBSONCursor &cursor)
+{
+    auto c = cursor.get();
+    if (c != CBSON_UUID_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    T r;
+    cursor.require(r.bytes.size());
+    memcpy(r.bytes.data(), cursor.ptr, r.bytes.size());
+    cursor.ptr += r.bytes.size();
+    return r;
+}
+
+template<typename T, typename std::enable_if<std::is_same<Time, T>::value, int>::type = 0>
+static inline T decodeCBSON(CBSONCursor &cursor)
+{
+    auto c = cursor.get();
+    if (c != CBSON_TIMESTAMP_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    int64_t nanoseconds;
+    cursor.require(sizeof (nanoseconds));
+    memcpy(&nanoseconds, cursor.ptr, sizeof (nanoseconds));
+    cursor.ptr += sizeof (nanoseconds);
+
+    if (nanoseconds > std::numeric_limits<int64_t>::max() - CBSON_TIMESTAMP_EPOCH) {
+        BOOST_THROW_EXCEPTION(decode_overflow_error());
+    }
+    return Time(nanoseconds + CBSON_TIMESTAMP_EPOCH);
+}
+
+template<typename T> struct is_map: std::false_type {};
+template<typename K, typename V> struct is_map<std::map<K, V>>: std::true_type {};
+
+/** Decode the number of items of a container.
+ * Each item is at least one byte, which bounds the count before the
+ * container is pre-sized.
+ */
+static inline uint32_t decodeCBSONCount(CBSONCursor &cursor, uint8_t opcode, size_t bytesPerItem)
+{
+    auto count = decodeCBSONCode(cursor, opcode);
+    if (cursor.remaining() / bytesPerItem < count) {
+        BOOST_THROW_EXCEPTION(decode_eof_error());
+    }
+    return count;
+}
+
+// Vector-decode requires a prototype of map-decode so it can decode a vector of maps.
+template<typename T, typename std::enable_if<is_map<T>::value, int>::type = 0>
+static inline T decodeCBSON(CBSONCursor &cursor, size_t maximumDepth = RSON_MAXIMUM_DEPTH);
+
+template<typename T, typename std::enable_if<is_vector<T>::value, int>::type = 0>
+static inline T decodeCBSON(CBSONCursor &cursor, size_t maximumDepth = RSON_MAXIMUM_DEPTH)
+{
+    typedef typename T::value_type V;
+
+    enterContainer(maximumDepth);
+    auto count = decodeCBSONCount(cursor, CBSON_LIST_CODE, 1);
+
+    auto r = T();
+    r.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        if constexpr (std::is_same<V, boost::any>::value) {
+            r.push_back(decodeCBSON(cursor, maximumDepth - 1));
+        } else {
+            r.push_back(decodeCBSON<V>(cursor));
+        }
+    }
+    return r;
+}
+
+template<typename T, typename std::enable_if<is_map<T>::value, int>::type>
+static inline T decodeCBSON(CBSONCursor &cursor, size_t maximumDepth)
+{
+    typedef typename T::key_type K;
+    typedef typename T::mapped_type V;
+
+    enterContainer(maximumDepth);
+    auto count = decodeCBSONCount(cursor, CBSON_DICTIONARY_CODE, 2);
+
+    auto r = T();
+    for (uint32_t i = 0; i < count; i++) {
+        auto key = decodeCBSON<K>(cursor);
+        if constexpr (std::is_same<V, boost::any>::value) {
+            r.emplace(std::move(key), decodeCBSON(cursor, maximumDepth - 1));
+        } else {
+            r.emplace(std::move(key), decodeCBSON<V>(cursor));
+        }
+    }
+    return r;
+}
+
+/** Decode any field.
+ * Floats are decoded as double, lists as std::vector<boost::any> and
+ * dictionaries as std::map<std::string, boost::any>. Nesting lists and
+ * dictionaries deeper than maximumDepth throws decode_overflow_error.
+ */
+static inline boost::any decodeCBSON(CBSONCursor &cursor, size_t maximumDepth)
+{
+    auto c = cursor.peek();
+    switch (cbsonOpcode(c)) {
+    case CBSON_SMALL_INTEGER_CODE:
+    case CBSON_INTEGER_CODE: return decodeCBSON<int64_t>(cursor);
+    case CBSON_BYTE_ARRAY_CODE: return decodeCBSON<std::basic_string<uint8_t>>(cursor);
+    case CBSON_FALSE_CODE:
+    case CBSON_TRUE_CODE: return decodeCBSON<bool>(cursor);
+    case CBSON_NONE_CODE: return decodeCBSON<boost::none_t>(cursor);
+    case CBSON_STRING_CODE:
+    case CBSON_INTERNED_STRING_CODE:
+    case CBSON_INTERNED_REFERENCE_CODE: return decodeCBSON<std::string>(cursor);
+    case CBSON_FLOAT_CODE:
+    case CBSON_DOUBLE_CODE: return decodeCBSON<double>(cursor);
+    case CBSON_UUID_CODE: return decodeCBSON<UUID>(cursor);
+    case CBSON_TIMESTAMP_CODE: return decodeCBSON<Time>(cursor);
+    case CBSON_LIST_CODE: return decodeCBSON<std::vector<boost::any>>(cursor, maximumDepth);
+    case CBSON_DICTIONARY_CODE: return decodeCBSON<std::map<std::string, boost::any>>(cursor, maximumDepth);
+    default: BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+}
+
+/** Skip over a single field without decoding it.
+ * Integers, byte arrays, and fixed size fields are skipped in constant
+ * time, containers by skipping over their counted items.
+ *
+ * @param cursor Cursor pointing to the start of the field, on return
+ *               it points just after the field.
+ * @param maximumDepth Maximum nesting of lists and dictionaries.
+ */
+static inline void skipCBSON(CBSONCursor &cursor, size_t maximumDepth = RSON_MAXIMUM_DEPTH)
+{
+    // Interned strings change the intern table, so they can not be skipped.
+    auto opcode = cbsonOpcode(cursor.peek());
+    if (opcode == CBSON_INTERNED_STRING_CODE || opcode == CBSON_INTERNED_REFERENCE_CODE) {
+        decodeCBSONString(cursor);
+        return;
+    }
+
+    auto c = cursor.get();
+    size_t size = 0;
+    size_t count = 0;
+
+    switch (cbsonOpcode(c)) {
+    case CBSON_SMALL_INTEGER_CODE:
+    case CBSON_FALSE_CODE:
+    case CBSON_TRUE_CODE:
+    case CBSON_NONE_CODE:
+        return;
+
+    case CBSON_INTEGER_CODE:
+        size = decodeCBSONLength(cursor, c);
+        cursor.require(size);
+        checkCBSONInteger(cursor.ptr, size);
+        break;
+    case CBSON_BYTE_ARRAY_CODE: size = decodeCBSONLength(cursor, c); break;
+    case CBSON_FLOAT_CODE: size = 4; break;
+    case CBSON_DOUBLE_CODE: size = 8; break;
+    case CBSON_UUID_CODE: size = 16; break;
+    case CBSON_TIMESTAMP_CODE: size = 8; break;
+    case CBSON_LIST_CODE:
+        enterContainer(maximumDepth);
+        count = decodeCBSONLength(cursor, c);
+        break;
+    case CBSON_DICTIONARY_CODE:
+        enterContainer(maximumDepth);
+        count = 2 * static_cast<size_t>(decodeCBSONLength(cursor, c));
+        break;
+
+    case CBSON_STRING_CODE:
+        skipMark(cursor);
+        return;
+
+    default:
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    cursor.require(size);
+    cursor.ptr += size;
+    for (size_t i = 0; i < count; i++) {
+        skipCBSON(cursor, maximumDepth - 1);
+    }
+}
+
+/** Decode a CBSON message from a string.
+ *
+ * @param str String containing the CBSON encoded data.
+ * @return The decoded value.
+ */
+template <typename T>
+static inline T decodeCBSON(const std::string &str)
+{
+    auto cursor = CBSONCursor(str);
+
+    return decodeCBSON<T>(cursor);
+}
+
+static inline boost::any decodeCBSON(const std::string &str)
+{
+    auto cursor = CBSONCursor(str);
+
+    return decodeCBSON(cursor);
+}
+
+};};
@@ -0,0 +1,150 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "CBSONDecode tests"
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/any.hpp>
+#include <boost/none.hpp>
+#include "CBSONEncode.hpp"
+#include "CBSONDecode.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+BOOST_AUTO_TEST_CASE(DecodeInteger)
+{
+    for (int i = 0; i < 64; i++) {
+        for (auto value: {1LL << i, -(1LL << i), (1LL << i) - 1, -(1LL << i) - 1}) {
+            BOOST_CHECK_EQUAL(decodeCBSON<int64_t>(encodeCBSON(static_cast<int64_t>(value))), value);
+        }
+    }
+    BOOST_CHECK_EQUAL(decodeCBSON<uint64_t>(encodeCBSON(numeric_limits<uint64_t>::max())), numeric_limits<uint64_t>::max());
+    BOOST_CHECK_EQUAL(decodeCBSON<int8_t>(string("\x11\xff", 2)), -128);
+
+    BOOST_CHECK_THROW(decodeCBSON<int8_t>(encodeCBSON(128)), decode_overflow_error);
+    BOOST_CHECK_THROW(decodeCBSON<uint32_t>(encodeCBSON(-1)), decode_overflow_error);
+    BOOST_CHECK_THROW(decodeCBSON<int64_t>(string("\x18\xff\xff", 3)), decode_eof_error);
+    BOOST_CHECK_THROW(decodeCBSON<int64_t>(string("\x50", 1)), decode_code_error);
+
+    // Integers must be stored in the least amount of bytes.
+    for (auto invalid: {string("\x12\xff\x00", 3), string("\x11\x0f", 2), string("\x10", 1), string("\x1d\x01\x20", 3)}) {
+        auto cursor = CBSONCursor(invalid);
+        BOOST_CHECK_THROW(decodeCBSON<int64_t>(invalid), decode_value_error);
+        BOOST_CHECK_THROW(skipCBSON(cursor), decode_value_error);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DecodeSimple)
+{
+    BOOST_CHECK(decodeCBSON<bool>(encodeCBSON(true)) == true);
+    BOOST_CHECK(decodeCBSON<bool>(encodeCBSON(false)) == false);
+    BOOST_CHECK(decodeCBSON<string>(encodeCBSON(string("caf\xc3\xa9"))) == "caf\xc3\xa9");
+    BOOST_CHECK(decodeCBSON<double>(encodeCBSON(-2.5)) == -2.5);
+    BOOST_CHECK(decodeCBSON<double>(encodeCBSON(0.1f)) == static_cast<double>(0.1f));
+    BOOST_CHECK(decodeCBSON<float>(encodeCBSON(0.1f)) == 0.1f);
+    BOOST_CHECK(decodeCBSON<Time>(encodeCBSON(Time(1530000000000000000))) == Time(1530000000000000000));
+    BOOST_CHECK_THROW(decodeCBSON<Time>(string("\x58\xff\xff\xff\xff\xff\xff\xff\x7f", 9)), decode_overflow_error);
+
+    auto uuid = UUID{{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16}};
+    BOOST_CHECK(decodeCBSON<UUID>(encodeCBSON(uuid)) == uuid);
+
+    BOOST_CHECK_THROW(decodeCBSON<string>(string("\x53" "foo", 4)), decode_eof_error);
+    BOOST_CHECK_THROW(decodeCBSON<double>(string("\x56\x00\x00", 3)), decode_eof_error);
+}
+
+BOOST_AUTO_TEST_CASE(DecodeCounted)
+{
+    for (size_t size: {0, 12, 13, 255, 256, 65535, 65536}) {
+        auto value = basic_string<uint8_t>(size, 0x55);
+        BOOST_CHECK(decodeCBSON<basic_string<uint8_t>>(encodeCBSON(value)) == value);
+    }
+
+    auto values = vector<int64_t>();
+    for (int64_t i = 0; i < 1000; i++) {
+        values.push_back(i * i * i - 500000);
+    }
+    BOOST_CHECK(decodeCBSON<vector<int64_t>>(encodeCBSON(values)) == values);
+
+    auto nested = vector<map<string, vector<double>>>{{{"a", {1.0, 2.0}}, {"b", {}}}, {}};
+    BOOST_CHECK((decodeCBSON<vector<map<string, vector<double>>>>(encodeCBSON(nested)) == nested));
+
+    // The count is checked against the remaining bytes before pre-sizing.
+    BOOST_CHECK_THROW(decodeCBSON<vector<int>>(string("\x6f\xff\xff\xff\x7f\x00", 6)), decode_eof_error);
+    BOOST_CHECK_THROW(decodeCBSON<vector<int>>(string("\x63\x00\x00", 3)), decode_eof_error);
+
+    // Lengths must be stored in the least amount of bytes.
+    auto shortByteArray = string("\x4d\x0c") + string(12, 'x');
+    auto byteLength = string("\x4e\xff\x00", 3) + string(255, 'x');
+    auto wordLength = string("\x4f\xff\xff\x00\x00", 5) + string(65535, 'x');
+    for (auto &invalid: {shortByteArray, byteLength, wordLength}) {
+        auto cursor = CBSONCursor(invalid);
+        BOOST_CHECK_THROW(decodeCBSON<basic_string<uint8_t>>(invalid), decode_value_error);
+        BOOST_CHECK_THROW(skipCBSON(cursor), decode_value_error);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DecodeAny)
+{
+    auto message = encodeCBSON(map<string, vector<int>>{{"x", {1, 2}}});
+    auto value = any_cast<map<string, any>>(decodeCBSON(message));
+    auto items = any_cast<vector<any>>(value["x"]);
+    BOOST_CHECK(items.size() == 2);
+    BOOST_CHECK(any_cast<int64_t>(items[1]) == 2);
+
+    BOOST_CHECK(any_cast<double>(decodeCBSON(encodeCBSON(1.5f))) == 1.5);
+    BOOST_CHECK(decodeCBSON(encodeCBSON(none)).type() == typeid(none_t));
+
+    // Nesting is limited, so that a message of nested lists can not exhaust the stack.
+    auto deep = string(100000, '\x61') + string("\x00", 1);
+    BOOST_CHECK_THROW(decodeCBSON(deep), decode_overflow_error);
+    BOOST_CHECK_THROW(decodeCBSON<vector<any>>(deep), decode_overflow_error);
+    auto shallow = string(RSON_MAXIMUM_DEPTH, '\x61') + string("\x00", 1);
+    BOOST_CHECK_NO_THROW(decodeCBSON(shallow));
+}
+
+BOOST_AUTO_TEST_CASE(SkipFields)
+{
+    auto message =
+        encodeCBSON(map<string, vector<int>>{{"x", {1, 200000}}}) +
+        encodeCBSON(basic_string<uint8_t>(300, 1)) +
+        encodeCBSON(string("foo")) +
+        encodeCBSON(2.0) +
+        encodeCBSON(UUID()) +
+        encodeCBSON(Time(0)) +
+        encodeCBSON(-100000);
+
+    auto cursor = CBSONCursor(message);
+    for (int i = 0; i < 7; i++) {
+        skipCBSON(cursor);
+    }
+    BOOST_CHECK(cursor.empty());
+
+    // Lists of a single list, nested up to and beyond the maximum depth.
+    auto nested = string(RSON_MAXIMUM_DEPTH - 1, '\x61') + "\x60";
+    auto nestedCursor = CBSONCursor(nested);
+    skipCBSON(nestedCursor);
+    BOOST_CHECK(nestedCursor.empty());
+
+    auto tooDeep = string(RSON_MAXIMUM_DEPTH, '\x61') + "\x60";
+    auto tooDeepCursor = CBSONCursor(tooDeep);
+    BOOST_CHECK_THROW(skipCBSON(tooDeepCursor), decode_overflow_error);
+}
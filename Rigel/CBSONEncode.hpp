@@ -0,0 +1,302 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include <type_traits>
+#include <boost/none.hpp>
+#include <boost/exception/all.hpp>
+
+#include "CBSON.hpp"
+#include "CBSONInternTable.hpp"
+#include "RSONSink.hpp"
+
+namespace Orion {
+namespace Rigel {
+
+/** A sink that interns the keys of dictionaries.
+ * It wraps another sink, and shares the state of the intern table with
+ * the decoder at the other end of a connection.
+ */
+template<typename S>
+struct CBSONInternSink {
+    S &sink;
+    CBSONInternTable &strings;
+
+    inline CBSONInternSink(S &sink, CBSONInternTable &strings) :
+        sink(sink), strings(strings) {}
+
+    inline CBSONInternSink &operator+=(char c) {
+        sink += c;
+        return *this;
+    }
+
+    inline void append(const char *data, size_t size) {
+        sink.append(data, size);
+    }
+};
+
+template<typename S>
+struct is_rson_sink<CBSONInternSink<S>>: std::true_type {};
+
+template<typename S>
+static inline void appendReference(CBSONInternSink<S> &s, const uint8_t *data, size_t size)
+{
+    appendReference(s.sink, data, size);
+}
+
+/** Encode a counted code.
+ * Short lengths are stored in the lower nibble of the code, longer lengths
+ * follow the code as a 1, 2 or 4 byte little endian integer.
+ *
+ * @param s The sink to write to.
+ * @param code The code of the field, with the lower nibble zero.
+ * @param length The number of bytes or items that follow.
+ */
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encodeCBSONCode(S &s, uint8_t code, uint64_t length)
+{
+    uint8_t buffer[5];
+    size_t size;
+
+    if (length <= CBSON_MAXIMUM_SHORT_LENGTH) {
+        buffer[0] = code | static_cast<uint8_t>(length);
+        size = 1;
+    } else if (length <= 0xff) {
+        buffer[0] = code | 13;
+        size = 2;
+    } else if (length <= 0xffff) {
+        buffer[0] = code | 14;
+        size = 3;
+    } else if (length <= 0xffffffff) {
+        buffer[0] = code | 15;
+        size = 5;
+    } else {
+        BOOST_THROW_EXCEPTION(encode_overflow_error());
+    }
+
+    for (size_t i = 1; i < size; i++) {
+        buffer[i] = static_cast<uint8_t>(length >> ((i - 1) * 8));
+    }
+    s.append(reinterpret_cast<const char *>(buffer), size);
+}
+
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encodeCBSON(S &s, bool value)
+{
+    s += static_cast<char>(value ? CBSON_TRUE_CODE : CBSON_FALSE_CODE);
+}
+
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encodeCBSON(S &s, boost::none_t value)
+{
+    s += static_cast<char>(CBSON_NONE_CODE);
+}
+
+/** Encode an integer.
+ * Integers are ZigZag encoded. Values up to 15 are stored in the code,
+ * larger values as the least amount of little endian bytes.
+ */
+template<typename S, typename T, typename std::enable_if<is_rson_sink<S>::value && std::is_integral<T>::value, int>::type = 0>
+static inline void encodeCBSON(S &s, T value)
+{
+    auto z = zigZagEncode(static_cast<__int128>(value));
+
+    if (z <= 0xf) {
+        s += static_cast<char>(CBSON_SMALL_INTEGER_CODE | static_cast<uint8_t>(z));
+        return;
+    }
+
+    uint8_t buffer[17];
+    size_t size = 0;
+    for (; z != 0; z >>= 8) {
+        buffer[++size] = static_cast<uint8_t>(z);
+    }
+    buffer[0] = CBSON_INTEGER_CODE | static_cast<uint8_t>(size);
+    s.append(reinterpret_cast<const char *>(buffer), size + 1);
+}
+
+/** Encode a floating point number.
+ * The number is stored as its IEEE-754 representation in little endian.
+ */
+template<typename S, typename T, typename std::enable_if<is_rson_sink<S>::value && std::is_floating_point<T>::value, int>::type = 0>
+static inline void encodeCBSON(S &s, T value)
+{
+    static_assert(sizeof (T) == 4 || sizeof (T) == 8, "Can only encode single and double precision");
+
+    uint8_t buffer[1 + sizeof (T)];
+    buffer[0] = sizeof (T) == 4 ? CBSON_FLOAT_CODE : CBSON_DOUBLE_CODE;
+    memcpy(&buffer[1], &value, sizeof (T));
+    s.append(reinterpret_cast<const char *>(buffer), sizeof (buffer));
+}
+
+/** Encode a UTF-8 string.
+ * The string is terminated with a nul, so it can not contain a nul.
+ */
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encodeCBSON(S &s, const std::string &value)
+{
+    if (memchr(value.data(), 0, value.size()) != nullptr) {
+        BOOST_THROW_EXCEPTION(encode_value_error());
+    }
+
+    s += static_cast<char>(CBSON_STRING_CODE);
+    s.append(value.data(), value.size());
+    s += static_cast<char>(0);
+}
+
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encodeCBSON(S &s, const std::basic_string<uint8_t> &value)
+{
+    encodeCBSONCode(s, CBSON_BYTE_ARRAY_CODE, value.size());
+    appendReference(s, value.data(), value.size());
+}
+
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encodeCBSON(S &s, const UUID &value)
+{
+    s += static_cast<char>(CBSON_UUID_CODE);
+    s.append(reinterpret_cast<const char *>(value.bytes.data()), value.bytes.size());
+}
+
+/** Encode a time as the number of nanoseconds since 2010.
+ */
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encodeCBSON(S &s, const Time &value)
+{
+    uint8_t buffer[9];
+    auto nanoseconds = value.intrinsic - CBSON_TIMESTAMP_EPOCH;
+
+    buffer[0] = CBSON_TIMESTAMP_CODE;
+    memcpy(&buffer[1], &nanoseconds, sizeof (nanoseconds));
+    s.append(reinterpret_cast<const char *>(buffer), sizeof (buffer));
+}
+
+/** Encode the key of a dictionary.
+ */
+template<typename S, typename K, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encodeCBSONKey(S &s, const K &key)
+{
+    encodeCBSON(s, key);
+}
+
+/** Encode the key of a dictionary as an interned string.
+ * A key that is already in the table is encoded as its index, otherwise
+ * the key is added to the table and encoded inline.
+ */
+template<typename S>
+static inline void encodeCBSONKey(CBSONInternSink<S> &s, const std::string &key)
+{
+    if (!s.strings.internable(key)) {
+        encodeCBSON(s, key);
+        return;
+    }
+
+    auto index = s.strings.find(key);
+    if (index != CBSONInternTable::NOT_FOUND) {
+        encodeCBSONCode(s, CBSON_INTERNED_REFERENCE_CODE, index);
+        return;
+    }
+
+    if (memchr(key.data(), 0, key.size()) != nullptr) {
+        BOOST_THROW_EXCEPTION(encode_value_error());
+    }
+    s.strings.insert(key);
+
+    s += static_cast<char>(CBSON_INTERNED_STRING_CODE);
+    s.append(key.data(), key.size());
+    s += static_cast<char>(0);
+}
+
+// Vector-encode requires a prototype of map-encode so it can encode a vector of maps.
+template<typename S, typename U, typename V, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encodeCBSON(S &s, const std::map<U, V> &container);
+
+template<typename S, typename T, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encodeCBSON(S &s, const std::vector<T> &container)
+{
+    encodeCBSONCode(s, CBSON_LIST_CODE, container.size());
+    for (auto const &item: container) {
+        encodeCBSON(s, item);
+    }
+}
+
+template<typename S, typename U, typename V, typename std::enable_if<is_rson_sink<S>::value, int>::type>
+static inline void encodeCBSON(S &s, const std::map<U, V> &container)
+{
+    encodeCBSONCode(s, CBSON_DICTIONARY_CODE, container.size());
+    for (auto const &item: container) {
+        encodeCBSONKey(s, item.first);
+        encodeCBSON(s, item.second);
+    }
+}
+
+/** Encode a message with interned keys.
+ * When encoding throws, the changes to the intern table are rolled back so
+ * that it keeps matching the table of the decoder; the partially encoded
+ * message must not be sent.
+ *
+ * @param s The sink to write to, with the intern table of the connection.
+ * @param value The value to be encoded to CBSON.
+ */
+template<typename S, typename T>
+static inline void encodeCBSONMessage(CBSONInternSink<S> &s, const T &value)
+{
+    s.strings.begin();
+    try {
+        encodeCBSON(s, value);
+    } catch (...) {
+        s.strings.rollback();
+        throw;
+    }
+    s.strings.commit();
+}
+
+/** Encode a C++ value into CBSON.
+ *
+ * @param value The value to be encoded to CBSON.
+ * @return The CBSON encoded value as a string.
+ */
+template<typename T>
+static inline std::string encodeCBSON(const T &value)
+{
+    std::string s;
+
+    encodeCBSON(s, value);
+
+    return s;
+}
+
+/** Encode a C++ value into CBSON and send it to a stream.
+ * The value is completely encoded before it is written, so nothing is
+ * written to the stream when encoding fails.
+ *
+ * @param stream The stream to write the CBSON encoded value to.
+ * @param value The value to be encoded to CBSON.
+ */
+template<typename T>
+static inline void encodeCBSON(std::ostream &stream, const T &value)
+{
+    auto s = encodeCBSON(value);
+    stream.write(s.data(), s.length());
+}
+
+};};
@@ -0,0 +1,77 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "CBSONEncode tests"
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <boost/none.hpp>
+#include "CBSONEncode.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+BOOST_AUTO_TEST_CASE(EncodeInteger)
+{
+    BOOST_CHECK(encodeCBSON(0) == string("\x00", 1));
+    BOOST_CHECK(encodeCBSON(-1) == string("\x01", 1));
+    BOOST_CHECK(encodeCBSON(1) == string("\x02", 1));
+    BOOST_CHECK(encodeCBSON(7) == string("\x0e", 1));
+    BOOST_CHECK(encodeCBSON(-8) == string("\x0f", 1));
+    BOOST_CHECK(encodeCBSON(8) == string("\x11\x10", 2));
+    BOOST_CHECK(encodeCBSON(-129) == string("\x12\x01\x01", 3));
+    BOOST_CHECK(encodeCBSON(numeric_limits<int64_t>::min()) == string("\x18\xff\xff\xff\xff\xff\xff\xff\xff", 9));
+    BOOST_CHECK(encodeCBSON(numeric_limits<uint64_t>::max()) == string("\x19\xfe\xff\xff\xff\xff\xff\xff\xff\x01", 10));
+}
+
+BOOST_AUTO_TEST_CASE(EncodeSimple)
+{
+    BOOST_CHECK(encodeCBSON(false) == string("\x50", 1));
+    BOOST_CHECK(encodeCBSON(true) == string("\x51", 1));
+    BOOST_CHECK(encodeCBSON(none) == string("\x52", 1));
+    BOOST_CHECK(encodeCBSON(string("foo")) == string("\x53" "foo\x00", 5));
+    BOOST_CHECK(encodeCBSON(1.0f) == string("\x55\x00\x00\x80\x3f", 5));
+    BOOST_CHECK(encodeCBSON(1.0) == string("\x56\x00\x00\x00\x00\x00\x00\xf0\x3f", 9));
+    BOOST_CHECK(encodeCBSON(Time(CBSON_TIMESTAMP_EPOCH + 1)) == string("\x58\x01\x00\x00\x00\x00\x00\x00\x00", 9));
+    BOOST_CHECK(encodeCBSON(UUID{{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16}}) == "\x57" + string("\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10", 16));
+    BOOST_CHECK_THROW(encodeCBSON(string("a\x00b", 3)), encode_value_error);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeCounted)
+{
+    BOOST_CHECK(encodeCBSON(basic_string<uint8_t>()) == string("\x40", 1));
+    BOOST_CHECK(encodeCBSON(basic_string<uint8_t>(12, 0xaa)) == "\x4c" + string(12, '\xaa'));
+    BOOST_CHECK(encodeCBSON(basic_string<uint8_t>(13, 0xaa)) == "\x4d\x0d" + string(13, '\xaa'));
+    BOOST_CHECK(encodeCBSON(basic_string<uint8_t>(256, 0xaa)) == string("\x4e\x00\x01", 3) + string(256, '\xaa'));
+    BOOST_CHECK(encodeCBSON(basic_string<uint8_t>(65536, 0xaa)) == string("\x4f\x00\x00\x01\x00", 5) + string(65536, '\xaa'));
+
+    BOOST_CHECK(encodeCBSON(vector<int>{1, 2, 3}) == string("\x63\x02\x04\x06", 4));
+    BOOST_CHECK(encodeCBSON(vector<int>(20, 0)) == "\x6d\x14" + string(20, '\x00'));
+    BOOST_CHECK(encodeCBSON(map<string, int>{{"a", 1}, {"b", -1}}) == string("\x72\x53" "a\x00\x02\x53" "b\x00\x01", 9));
+    BOOST_CHECK(encodeCBSON(vector<map<string, bool>>{{{"a", true}}, {}}) == string("\x62\x71\x53" "a\x00\x51\x70", 7));
+}
+
+BOOST_AUTO_TEST_CASE(EncodeStream)
+{
+    auto stream = stringstream();
+    encodeCBSON(stream, vector<string>{"foo", "bar"});
+    BOOST_CHECK(stream.str() == encodeCBSON(vector<string>{"foo", "bar"}));
+}
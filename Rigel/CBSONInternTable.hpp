@@ -0,0 +1,338 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <boost/exception/all.hpp>
+
+namespace Orion {
+namespace Rigel {
+
+struct intern_table_budget_error: virtual boost::exception, virtual std::exception {};
+
+/** A per-connection table of interned strings.
+ * The first time a string is sent it is added to the table of both the
+ * encoder and the decoder, after which it is sent as its index in the table.
+ *
+ * The table has a budget of entries and of bytes. When a new string does not
+ * fit, entries are evicted with the CLOCK algorithm: the hand sweeps over the
+ * entries, giving a second chance to entries that were used since it last
+ * passed. The encoder and decoder see the same sequence of definitions and
+ * references, so both tables evict the same entries, as long as both are
+ * created with the same budget.
+ *
+ * The encoder changes its table before a message is completely encoded. The
+ * changes of a message are recorded between begin() and commit(), so that
+ * rollback() can undo them when the message is not sent.
+ */
+class CBSONInternTable {
+public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    /** Constructor.
+     * A budget of zero entries or zero bytes throws intern_table_budget_error.
+     *
+     * @param maximumEntries Maximum number of strings in the table.
+     * @param maximumBytes Maximum total size of the strings in the table.
+     * @param maximumStringSize The encoder only interns strings up to this size.
+     */
+    CBSONInternTable(uint32_t maximumEntries = 1024, size_t maximumBytes = 65536, size_t maximumStringSize = 64) :
+        maximumEntries(maximumEntries), maximumBytes(maximumBytes),
+        maximumStringSize(std::min(maximumStringSize, maximumBytes)),
+        entries(), freeEntries(), slots(), hand(0), bytes(0),
+        journal(), journaling(false), savedHand(0), savedBytes(0)
+    {
+        if (maximumEntries == 0 || maximumBytes == 0) {
+            BOOST_THROW_EXCEPTION(intern_table_budget_error());
+        }
+
+        size_t nrSlots = 16;
+        while (nrSlots < 2 * static_cast<size_t>(maximumEntries)) {
+            nrSlots *= 2;
+        }
+        slots.assign(nrSlots, NOT_FOUND);
+    }
+
+    /** Check if a string should be interned by the encoder.
+     */
+    inline bool internable(std::string_view value) const {
+        return value.size() <= maximumStringSize;
+    }
+
+    /** Check if a string fits in the table at all.
+     * The decoder must check this before inserting a string it received.
+     */
+    inline bool fits(std::string_view value) const {
+        return value.size() <= maximumBytes;
+    }
+
+    /** Find the index of a string, and mark it as used.
+     *
+     * @return The index of the string, or NOT_FOUND.
+     */
+    inline uint32_t find(std::string_view value) {
+        auto mask = slots.size() - 1;
+        for (auto i = hash(value) & mask; slots[i] != NOT_FOUND; i = (i + 1) & mask) {
+            auto &entry = entries[slots[i]];
+            if (entry.value == value) {
+                setReferenced(slots[i], true);
+                return slots[i];
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    /** Get the string at an index, and mark it as used.
+     *
+     * @return The string, or nullptr when the index is not in use.
+     */
+    inline const std::string *get(uint32_t index) {
+        if (index >= entries.size() || !entries[index].used) {
+            return nullptr;
+        }
+        setReferenced(index, true);
+        return &entries[index].value;
+    }
+
+    /** Add a string that is not in the table, evicting entries to make room.
+     *
+     * @param value The string to add, it must fit in the table.
+     * @return The index of the string.
+     */
+    inline uint32_t insert(std::string_view value) {
+        while (bytes + value.size() > maximumBytes || (freeEntries.empty() && entries.size() >= maximumEntries)) {
+            evict();
+        }
+
+        uint32_t index;
+        if (!freeEntries.empty()) {
+            index = freeEntries.back();
+            freeEntries.pop_back();
+            record(Change::Kind::InsertedFree, index);
+        } else {
+            index = static_cast<uint32_t>(entries.size());
+            entries.emplace_back();
+            record(Change::Kind::InsertedNew, index);
+        }
+
+        auto &entry = entries[index];
+        entry.value = std::string(value);
+        entry.used = true;
+        entry.referenced = false;
+        bytes += value.size();
+
+        addSlot(index);
+        return index;
+    }
+
+    /** Start recording the changes of a message.
+     */
+    inline void begin(void) {
+        journal.clear();
+        journaling = true;
+        savedHand = hand;
+        savedBytes = bytes;
+    }
+
+    /** Keep the changes recorded since begin().
+     */
+    inline void commit(void) {
+        journal.clear();
+        journaling = false;
+    }
+
+    /** Undo the changes recorded since begin(), in reverse order.
+     * Only the indices of the strings are restored; the position of a string
+     * in the hash table does not affect the encoded messages.
+     */
+    inline void rollback(void) {
+        for (auto change = journal.rbegin(); change != journal.rend(); change++) {
+            auto &entry = entries[change->index];
+            switch (change->kind) {
+            case Change::Kind::Referenced:
+                entry.referenced = change->referenced;
+                break;
+
+            case Change::Kind::Erased:
+                freeEntries.pop_back();
+                entry.value = std::move(change->value);
+                entry.used = true;
+                entry.referenced = change->referenced;
+                addSlot(change->index);
+                break;
+
+            case Change::Kind::InsertedFree:
+                removeSlot(change->index);
+                entry = Entry();
+                freeEntries.push_back(change->index);
+                break;
+
+            case Change::Kind::InsertedNew:
+                removeSlot(change->index);
+                entries.pop_back();
+                break;
+            }
+        }
+        hand = savedHand;
+        bytes = savedBytes;
+        commit();
+    }
+
+    inline size_t size(void) const {
+        return entries.size() - freeEntries.size();
+    }
+
+    inline size_t sizeInBytes(void) const {
+        return bytes;
+    }
+
+    inline void clear(void) {
+        commit();
+        entries.clear();
+        freeEntries.clear();
+        slots.assign(slots.size(), NOT_FOUND);
+        hand = 0;
+        bytes = 0;
+    }
+
+private:
+    struct Entry {
+        std::string value{};
+        bool used = false;
+        bool referenced = false;
+    };
+
+    uint32_t maximumEntries;
+    size_t maximumBytes;
+    size_t maximumStringSize;
+
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeEntries;
+
+    /** Open addressing hash table with linear probing of indices into entries.
+     */
+    std::vector<uint32_t> slots;
+
+    size_t hand;
+    size_t bytes;
+
+    /** A change to an entry, recorded so that it can be undone.
+     */
+    struct Change {
+        enum class Kind { Referenced, Erased, InsertedFree, InsertedNew };
+
+        Kind kind;
+        uint32_t index;
+        // The previous referenced flag of the entry.
+        bool referenced;
+        // The string of an erased entry.
+        std::string value;
+    };
+
+    std::vector<Change> journal;
+    bool journaling;
+    size_t savedHand;
+    size_t savedBytes;
+
+    static inline size_t hash(std::string_view value) {
+        return std::hash<std::string_view>()(value);
+    }
+
+    /** Evict the next entry the clock hand finds that was not used recently.
+     */
+    inline void evict(void) {
+        while (true) {
+            auto &entry = entries[hand];
+            auto index = static_cast<uint32_t>(hand);
+            hand = (hand + 1) % entries.size();
+
+            if (!entry.used) {
+                continue;
+            } else if (entry.referenced) {
+                setReferenced(index, false);
+                continue;
+            }
+
+            erase(index);
+            return;
+        }
+    }
+
+    inline void record(Change::Kind kind, uint32_t index, std::string value = std::string()) {
+        if (journaling) {
+            journal.push_back({kind, index, entries[index].referenced, std::move(value)});
+        }
+    }
+
+    inline void setReferenced(uint32_t index, bool referenced) {
+        if (entries[index].referenced != referenced) {
+            record(Change::Kind::Referenced, index);
+            entries[index].referenced = referenced;
+        }
+    }
+
+    inline void addSlot(uint32_t index) {
+        auto mask = slots.size() - 1;
+        auto i = hash(entries[index].value) & mask;
+        while (slots[i] != NOT_FOUND) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = index;
+    }
+
+    /** Remove the slot of an entry by shifting back the slots after it.
+     */
+    inline void removeSlot(uint32_t index) {
+        auto mask = slots.size() - 1;
+        auto i = hash(entries[index].value) & mask;
+        while (slots[i] != index) {
+            i = (i + 1) & mask;
+        }
+
+        for (auto j = (i + 1) & mask; slots[j] != NOT_FOUND; j = (j + 1) & mask) {
+            auto home = hash(entries[slots[j]].value) & mask;
+            // Move the slot back when its home is not between the hole and itself.
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i] = NOT_FOUND;
+    }
+
+    /** Remove an entry and its slot.
+     */
+    inline void erase(uint32_t index) {
+        removeSlot(index);
+
+        auto &entry = entries[index];
+        if (journaling) {
+            record(Change::Kind::Erased, index, entry.value);
+        }
+        bytes -= entry.value.size();
+        entry.value.clear();
+        entry.used = false;
+        entry.referenced = false;
+        freeEntries.push_back(index);
+    }
+};
+
+};};
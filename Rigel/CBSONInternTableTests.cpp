@@ -0,0 +1,203 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "CBSONInternTable tests"
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include <map>
+#include "CBSONInternTable.hpp"
+#include "CBSONEncode.hpp"
+#include "CBSONDecode.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+BOOST_AUTO_TEST_CASE(InsertFind)
+{
+    auto table = CBSONInternTable(4, 1000);
+
+    BOOST_CHECK(table.find("foo") == CBSONInternTable::NOT_FOUND);
+    BOOST_CHECK(table.insert("foo") == 0);
+    BOOST_CHECK(table.insert("bar") == 1);
+    BOOST_CHECK(table.find("foo") == 0);
+    BOOST_CHECK(table.find("bar") == 1);
+    BOOST_CHECK(*table.get(1) == "bar");
+    BOOST_CHECK(table.get(2) == nullptr);
+    BOOST_CHECK(table.size() == 2);
+    BOOST_CHECK(table.sizeInBytes() == 6);
+
+    // A table without room for any string is rejected.
+    BOOST_CHECK_THROW(CBSONInternTable(0, 1000), intern_table_budget_error);
+    BOOST_CHECK_THROW(CBSONInternTable(4, 0), intern_table_budget_error);
+}
+
+BOOST_AUTO_TEST_CASE(EvictClock)
+{
+    auto table = CBSONInternTable(3, 1000);
+    table.insert("a");
+    table.insert("b");
+    table.insert("c");
+
+    // "a" was used, so it gets a second chance and "b" is evicted.
+    table.find("a");
+    BOOST_CHECK(table.insert("d") == 1);
+    BOOST_CHECK(table.find("b") == CBSONInternTable::NOT_FOUND);
+    BOOST_CHECK(table.find("a") == 0);
+    BOOST_CHECK(table.find("c") == 2);
+    BOOST_CHECK(table.find("d") == 1);
+    BOOST_CHECK(table.size() == 3);
+}
+
+BOOST_AUTO_TEST_CASE(EvictBytes)
+{
+    auto table = CBSONInternTable(100, 10);
+    table.insert("aaaa");
+    table.insert("bbbb");
+
+    // Both strings must be evicted to make room.
+    table.insert("cccccccc");
+    BOOST_CHECK(table.find("aaaa") == CBSONInternTable::NOT_FOUND);
+    BOOST_CHECK(table.find("bbbb") == CBSONInternTable::NOT_FOUND);
+    BOOST_CHECK(table.find("cccccccc") != CBSONInternTable::NOT_FOUND);
+    BOOST_CHECK(table.sizeInBytes() == 8);
+    BOOST_CHECK(table.size() == 1);
+
+    BOOST_CHECK(!table.fits(string(11, 'x')));
+    BOOST_CHECK(!table.internable(string(11, 'x')));
+}
+
+BOOST_AUTO_TEST_CASE(HashConsistency)
+{
+    // Many evictions, so that slots are shifted back after erasing.
+    auto table = CBSONInternTable(37, 100000);
+    auto present = map<string, uint32_t>();
+    uint32_t state = 12345;
+
+    for (int i = 0; i < 10000; i++) {
+        state = state * 1103515245 + 12345;
+        auto key = "key" + to_string((state >> 8) % 100);
+
+        auto index = table.find(key);
+        if (index == CBSONInternTable::NOT_FOUND) {
+            index = table.insert(key);
+        }
+        BOOST_REQUIRE(*table.get(index) == key);
+        BOOST_REQUIRE(table.size() <= 37);
+    }
+
+    for (uint32_t index = 0; index < 37; index++) {
+        auto value = table.get(index);
+        BOOST_REQUIRE(value != nullptr);
+        BOOST_CHECK(table.find(*value) == index);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(InternedKeys)
+{
+    auto encoderStrings = CBSONInternTable(2, 1000);
+    auto decoderStrings = CBSONInternTable(2, 1000);
+
+    auto message = map<string, int>{{"port", 1}, {"serviceName", 2}};
+    auto other = map<string, int>{{"address", 3}, {"port", 4}};
+
+    auto encodeMessage = [&](const map<string, int> &value) {
+        auto buffer = string();
+        auto s = CBSONInternSink<string>(buffer, encoderStrings);
+        encodeCBSONMessage(s, value);
+        return buffer;
+    };
+    auto decodeMessage = [&](const string &buffer) {
+        auto cursor = CBSONCursor(buffer, &decoderStrings);
+        return decodeCBSON<map<string, int>>(cursor);
+    };
+
+    // First the keys are sent inline, then as indices.
+    auto first = encodeMessage(message);
+    auto second = encodeMessage(message);
+    BOOST_CHECK(first == string("\x72\x54" "port\x00\x02\x54" "serviceName\x00\x04", 22));
+    BOOST_CHECK(second == string("\x72\x20\x02\x21\x04", 5));
+    BOOST_CHECK(decodeMessage(first) == message);
+    BOOST_CHECK(decodeMessage(second) == message);
+
+    // Evicts "serviceName", both tables evict the same key.
+    auto third = encodeMessage(other);
+    auto fourth = encodeMessage(message);
+    BOOST_CHECK(decodeMessage(third) == other);
+    BOOST_CHECK(decodeMessage(fourth) == message);
+
+    for (int i = 0; i < 100; i++) {
+        auto value = map<string, int>{{"k" + to_string(i % 7), i}, {"k" + to_string(i % 5), i}};
+        BOOST_REQUIRE(decodeMessage(encodeMessage(value)) == value);
+    }
+
+    // Interned strings need a table to decode.
+    BOOST_CHECK_THROW((decodeCBSON<map<string, int>>(second)), decode_code_error);
+    BOOST_CHECK_THROW(decodeCBSON<string>(string("\x2c", 1)), decode_code_error);
+
+    auto cursor = CBSONCursor(string("\x2c", 1), &decoderStrings);
+    BOOST_CHECK_THROW(decodeCBSON<string>(cursor), decode_index_error);
+}
+
+BOOST_AUTO_TEST_CASE(InternedRollback)
+{
+    auto encoderStrings = CBSONInternTable(2, 1000);
+    auto decoderStrings = CBSONInternTable(2, 1000);
+
+    auto encodeMessage = [&](const map<string, string> &value) {
+        auto buffer = string();
+        auto s = CBSONInternSink<string>(buffer, encoderStrings);
+        encodeCBSONMessage(s, value);
+        return buffer;
+    };
+    auto decodeMessage = [&](const string &buffer) {
+        auto cursor = CBSONCursor(buffer, &decoderStrings);
+        return decodeCBSON<map<string, string>>(cursor);
+    };
+
+    auto first = map<string, string>{{"a", "1"}, {"b", "2"}};
+    BOOST_CHECK(decodeMessage(encodeMessage(first)) == first);
+
+    // The failed message references "a", evicts "b" and adds "c" and "d", which are all undone.
+    auto failed = map<string, string>{{"a", "1"}, {"c", "3"}, {"d", string("\x00", 1)}};
+    BOOST_CHECK_THROW(encodeMessage(failed), encode_value_error);
+    BOOST_CHECK(encoderStrings.size() == 2);
+    BOOST_CHECK(encoderStrings.sizeInBytes() == 2);
+
+    for (int i = 0; i < 20; i++) {
+        auto value = map<string, string>{{"b", "2"}, {string(1, static_cast<char>('c' + i % 3)), "3"}};
+        BOOST_REQUIRE(decodeMessage(encodeMessage(value)) == value);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SkipInterned)
+{
+    auto encoderStrings = CBSONInternTable();
+    auto decoderStrings = CBSONInternTable();
+
+    auto buffer = string();
+    auto s = CBSONInternSink<string>(buffer, encoderStrings);
+    encodeCBSON(s, map<string, int>{{"a", 1}});
+    encodeCBSON(s, map<string, int>{{"a", 2}});
+
+    // Skipping the first message still defines the key.
+    auto cursor = CBSONCursor(buffer, &decoderStrings);
+    skipCBSON(cursor);
+    BOOST_CHECK((decodeCBSON<map<string, int>>(cursor) == map<string, int>{{"a", 2}}));
+}
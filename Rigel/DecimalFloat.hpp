@@ -0,0 +1,290 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <charconv>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <boost/exception/all.hpp>
+
+namespace Orion {
+namespace Rigel {
+
+struct decimal_float_error: virtual boost::exception {};
+struct decimal_float_conversion_error: virtual decimal_float_error, virtual std::exception {};
+struct decimal_float_overflow_error: virtual decimal_float_error, virtual std::exception {};
+
+/** A decimal floating point number: mantissa * 10^exponent.
+ * The mantissa is normalized to have no trailing zero decimal digits, so
+ * that each value has a single representation, as RSON requires.
+ *
+ * Infinite and NaN are represented with special exponents, in the same way
+ * as splitFloatingPoint() does for binary floats. Normalizing a finite value
+ * into one of those exponents throws decimal_float_overflow_error.
+ */
+struct DecimalFloat {
+    static const int32_t EXPONENT_INF = INT32_MAX;
+    static const int32_t EXPONENT_NAN = INT32_MIN;
+
+    int64_t mantissa;
+    int32_t exponent;
+
+    inline DecimalFloat(void) : mantissa(0), exponent(0) {}
+
+    inline DecimalFloat(int64_t mantissa, int32_t exponent) :
+        mantissa(mantissa), exponent(exponent)
+    {
+        if (mantissa == 0) {
+            this->exponent = 0;
+        } else if (exponent != EXPONENT_INF && exponent != EXPONENT_NAN) {
+            while (this->mantissa % 10 == 0) {
+                if (this->exponent >= EXPONENT_INF - 1) {
+                    BOOST_THROW_EXCEPTION(decimal_float_overflow_error());
+                }
+                this->mantissa /= 10;
+                this->exponent++;
+            }
+        }
+    }
+
+    static inline DecimalFloat infinity(bool negative = false) {
+        auto r = DecimalFloat();
+        r.mantissa = negative ? -1 : 1;
+        r.exponent = EXPONENT_INF;
+        return r;
+    }
+
+    static inline DecimalFloat quiet_NaN(void) {
+        auto r = DecimalFloat();
+        r.exponent = EXPONENT_NAN;
+        return r;
+    }
+
+    inline bool isInfinite(void) const {
+        return exponent == EXPONENT_INF;
+    }
+
+    inline bool isNaN(void) const {
+        return exponent == EXPONENT_NAN;
+    }
+
+    /** Convert a binary float to the shortest decimal float that converts back to it.
+     * std::to_chars() implements a shortest round-trip algorithm (Ryu), the
+     * digits it produces are parsed into the mantissa and exponent.
+     */
+    template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+    static inline DecimalFloat fromBinary(T value) {
+        if (value != value) {
+            return quiet_NaN();
+        } else if (value == std::numeric_limits<T>::infinity()) {
+            return infinity(false);
+        } else if (value == -std::numeric_limits<T>::infinity()) {
+            return infinity(true);
+        } else if (value == 0) {
+            return DecimalFloat();
+        }
+
+        // Formatted as: [-]d[.ddd]e(+|-)dd
+        char buffer[64];
+        auto result = std::to_chars(buffer, buffer + sizeof (buffer), value, std::chars_format::scientific);
+        if (result.ec != std::errc()) {
+            BOOST_THROW_EXCEPTION(decimal_float_conversion_error());
+        }
+
+        auto p = buffer;
+        bool negative = *p == '-';
+        p += negative;
+
+        uint64_t m = 0;
+        int32_t e = 0;
+        for (; *p != 'e'; p++) {
+            if (*p == '.') {
+                continue;
+            }
+            m = m * 10 + (*p - '0');
+            e -= (p > buffer + negative + 1);
+        }
+        p++;
+
+        bool negativeExponent = *p == '-';
+        int32_t shift = 0;
+        for (p++; p < result.ptr; p++) {
+            shift = shift * 10 + (*p - '0');
+        }
+        e += negativeExponent ? -shift : shift;
+
+        auto sm = static_cast<int64_t>(m);
+        return DecimalFloat(negative ? -sm : sm, e);
+    }
+
+    /** Convert to a binary float, correctly rounded.
+     * When both the mantissa and a power of ten are exactly representable,
+     * a single multiply or divide is correctly rounded (Clinger's fast path).
+     * Other values are converted with std::from_chars().
+     */
+    template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+    inline T toBinary(void) const {
+        static const double POWERS_OF_TEN[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        const int64_t MAX_EXACT_MANTISSA = 1LL << std::numeric_limits<T>::digits;
+        const int32_t MAX_EXACT_EXPONENT = std::is_same<T, float>::value ? 10 : 22;
+
+        if (isNaN()) {
+            return std::numeric_limits<T>::quiet_NaN();
+        } else if (isInfinite()) {
+            return mantissa < 0 ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::infinity();
+        } else if (mantissa == 0) {
+            return 0;
+        }
+
+        if (mantissa >= -MAX_EXACT_MANTISSA && mantissa <= MAX_EXACT_MANTISSA) {
+            if (exponent >= 0 && exponent <= MAX_EXACT_EXPONENT) {
+                return static_cast<T>(mantissa) * static_cast<T>(POWERS_OF_TEN[exponent]);
+            } else if (exponent < 0 && exponent >= -MAX_EXACT_EXPONENT) {
+                return static_cast<T>(mantissa) / static_cast<T>(POWERS_OF_TEN[-exponent]);
+            }
+        }
+
+        // Sign and digits of the mantissa, 'e', sign and digits of the exponent.
+        constexpr size_t MANTISSA_SIZE = 1 + std::numeric_limits<int64_t>::digits10 + 1;
+        constexpr size_t EXPONENT_SIZE = 1 + std::numeric_limits<int32_t>::digits10 + 1;
+        char buffer[MANTISSA_SIZE + 1 + EXPONENT_SIZE];
+        auto end = buffer + sizeof (buffer);
+
+        auto mantissaResult = std::to_chars(buffer, buffer + MANTISSA_SIZE, mantissa);
+        if (mantissaResult.ec != std::errc()) {
+            BOOST_THROW_EXCEPTION(decimal_float_conversion_error());
+        }
+        auto p = mantissaResult.ptr;
+        *p++ = 'e';
+        auto exponentResult = std::to_chars(p, end, exponent);
+        if (exponentResult.ec != std::errc()) {
+            BOOST_THROW_EXCEPTION(decimal_float_conversion_error());
+        }
+
+        T r;
+        auto result = std::from_chars(buffer, exponentResult.ptr, r);
+        if (result.ec == std::errc::result_out_of_range) {
+            // from_chars does not return the rounded value on overflow or underflow.
+            bool overflow = exponent > 0;
+            r = overflow ? std::numeric_limits<T>::infinity() : 0;
+            return mantissa < 0 ? -r : r;
+        } else if (result.ec != std::errc()) {
+            BOOST_THROW_EXCEPTION(decimal_float_conversion_error());
+        }
+        return r;
+    }
+
+    inline double toDouble(void) const {
+        return toBinary<double>();
+    }
+
+    inline std::string string(void) const {
+        if (isNaN()) {
+            return "nan";
+        } else if (isInfinite()) {
+            return mantissa < 0 ? "-inf" : "inf";
+        }
+        return std::to_string(mantissa) + "e" + std::to_string(exponent);
+    }
+};
+
+/** Number of decimal digits of a non-zero magnitude.
+ */
+static inline int decimalDigits(uint64_t value)
+{
+    int r = 1;
+    while (value >= 10) {
+        value /= 10;
+        r++;
+    }
+    return r;
+}
+
+/** Compare two decimal floats in canonical RSON sort order.
+ * -infinite, ascending values, +infinite, NaN.
+ *
+ * @return -1, 0 or 1 when a is less, equal or greater than b.
+ */
+static inline int compare(const DecimalFloat &a, const DecimalFloat &b)
+{
+    static const uint64_t POWERS_OF_TEN[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+        100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+        10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+        100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+    };
+
+    // NaN sorts after everything, infinite by sign.
+    if (a.isNaN() || b.isNaN()) {
+        return a.isNaN() - b.isNaN();
+    }
+    auto rank = [](const DecimalFloat &x) {
+        return x.isInfinite() ? (x.mantissa < 0 ? -1 : 1) : 0;
+    };
+    if (rank(a) != rank(b) || rank(a) != 0) {
+        return (rank(a) > rank(b)) - (rank(a) < rank(b));
+    }
+
+    auto signA = (a.mantissa > 0) - (a.mantissa < 0);
+    auto signB = (b.mantissa > 0) - (b.mantissa < 0);
+    if (signA != signB || signA == 0) {
+        return (signA > signB) - (signA < signB);
+    }
+
+    // Compare the magnitudes, first by the position of the most significant digit.
+    auto magnitudeA = a.mantissa < 0 ? -static_cast<uint64_t>(a.mantissa) : static_cast<uint64_t>(a.mantissa);
+    auto magnitudeB = b.mantissa < 0 ? -static_cast<uint64_t>(b.mantissa) : static_cast<uint64_t>(b.mantissa);
+    auto digitsA = decimalDigits(magnitudeA);
+    auto digitsB = decimalDigits(magnitudeB);
+    auto orderA = static_cast<int64_t>(digitsA) + a.exponent;
+    auto orderB = static_cast<int64_t>(digitsB) + b.exponent;
+
+    int r;
+    if (orderA != orderB) {
+        r = (orderA > orderB) - (orderA < orderB);
+    } else {
+        // Align to the same number of digits, which fits in 64 bits.
+        if (digitsA < digitsB) {
+            magnitudeA *= POWERS_OF_TEN[digitsB - digitsA];
+        } else {
+            magnitudeB *= POWERS_OF_TEN[digitsA - digitsB];
+        }
+        r = (magnitudeA > magnitudeB) - (magnitudeA < magnitudeB);
+    }
+    return signA < 0 ? -r : r;
+}
+
+static inline bool operator==(const DecimalFloat &a, const DecimalFloat &b)
+{
+    return a.mantissa == b.mantissa && a.exponent == b.exponent;
+}
+
+static inline bool operator!=(const DecimalFloat &a, const DecimalFloat &b)
+{
+    return !(a == b);
+}
+
+static inline bool operator<(const DecimalFloat &a, const DecimalFloat &b)
+{
+    return compare(a, b) < 0;
+}
+
+};};
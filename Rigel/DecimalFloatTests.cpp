@@ -0,0 +1,152 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "DecimalFloat tests"
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <cstring>
+#include <sstream>
+#include "DecimalFloat.hpp"
+#include "RSONEncode.hpp"
+#include "RSONDecode.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+BOOST_AUTO_TEST_CASE(DecimalFloatNormalize)
+{
+    auto a = DecimalFloat(12500, -2);
+    BOOST_CHECK_EQUAL(a.mantissa, 125);
+    BOOST_CHECK_EQUAL(a.exponent, 0);
+
+    auto b = DecimalFloat(0, 5);
+    BOOST_CHECK_EQUAL(b.mantissa, 0);
+    BOOST_CHECK_EQUAL(b.exponent, 0);
+}
+
+BOOST_AUTO_TEST_CASE(DecimalFloatShortest)
+{
+    BOOST_CHECK(DecimalFloat::fromBinary(0.1) == DecimalFloat(1, -1));
+    BOOST_CHECK(DecimalFloat::fromBinary(-123.45) == DecimalFloat(-12345, -2));
+    BOOST_CHECK(DecimalFloat::fromBinary(1e300) == DecimalFloat(1, 300));
+    BOOST_CHECK(DecimalFloat::fromBinary(5e-324) == DecimalFloat(5, -324));
+    BOOST_CHECK(DecimalFloat::fromBinary(1500.0) == DecimalFloat(15, 2));
+    BOOST_CHECK(DecimalFloat::fromBinary(0.1f) == DecimalFloat(1, -1));
+    BOOST_CHECK(DecimalFloat::fromBinary(numeric_limits<double>::max()) == DecimalFloat(17976931348623157, 292));
+    BOOST_CHECK(DecimalFloat::fromBinary(-numeric_limits<double>::infinity()) == DecimalFloat::infinity(true));
+    BOOST_CHECK(DecimalFloat::fromBinary(numeric_limits<double>::quiet_NaN()).isNaN());
+}
+
+BOOST_AUTO_TEST_CASE(DecimalFloatRoundTrip)
+{
+    BOOST_CHECK_EQUAL(DecimalFloat(1, -1).toDouble(), 0.1);
+    BOOST_CHECK_EQUAL(DecimalFloat(19999, -2).toDouble(), 199.99);
+    BOOST_CHECK_EQUAL(DecimalFloat(1, 400).toDouble(), numeric_limits<double>::infinity());
+    BOOST_CHECK_EQUAL(DecimalFloat(-1, -400).toDouble(), 0.0);
+    BOOST_CHECK_EQUAL(DecimalFloat(1, -1).toBinary<float>(), 0.1f);
+
+    // Random bit patterns must convert back to exactly the same double.
+    uint64_t state = 0x123456789abcdefULL;
+    for (int i = 0; i < 10000; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+
+        double value;
+        memcpy(&value, &state, sizeof (value));
+        if (value != value || value == numeric_limits<double>::infinity() || value == -numeric_limits<double>::infinity()) {
+            continue;
+        }
+
+        auto decimal = DecimalFloat::fromBinary(value);
+        BOOST_CHECK_EQUAL(decimal.toDouble(), value);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DecimalFloatCompare)
+{
+    auto ordered = vector<DecimalFloat>{
+        DecimalFloat::infinity(true),
+        DecimalFloat(-15, 1),
+        DecimalFloat(-149, 0),
+        DecimalFloat(-1, -3),
+        DecimalFloat(),
+        DecimalFloat(1, -20),
+        DecimalFloat(999, -3),
+        DecimalFloat(1, 0),
+        DecimalFloat(1000000000000000001, -18),
+        DecimalFloat(11, -1),
+        DecimalFloat(1, 300),
+        DecimalFloat::infinity(false),
+        DecimalFloat::quiet_NaN()
+    };
+
+    for (size_t i = 0; i < ordered.size(); i++) {
+        for (size_t j = 0; j < ordered.size(); j++) {
+            BOOST_CHECK_EQUAL(compare(ordered[i], ordered[j]), (i > j) - (i < j));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DecimalFloatRSON)
+{
+    auto price = DecimalFloat(19999, -2);
+
+    auto buffer = encode(price);
+    BOOST_CHECK(buffer == string("\x15\x9f\x38\x82\xfe", 5));
+    BOOST_CHECK_EQUAL(exactLength(price), buffer.size());
+
+    BOOST_CHECK(decode<DecimalFloat>(buffer) == price);
+    BOOST_CHECK_EQUAL(decode<double>(buffer), 199.99);
+    BOOST_CHECK(any_cast<DecimalFloat>(decode(buffer)) == price);
+
+    auto stream = stringstream(buffer);
+    BOOST_CHECK(decode<DecimalFloat>(stream) == price);
+
+    for (auto value: {DecimalFloat(), DecimalFloat::infinity(true), DecimalFloat::infinity(false)}) {
+        BOOST_CHECK(decode<DecimalFloat>(encode(value)) == value);
+    }
+    BOOST_CHECK(decode<DecimalFloat>(encode(DecimalFloat::quiet_NaN())).isNaN());
+
+    // Trailing zero digits in the mantissa are not canonical.
+    auto invalid = string("\x15\xca\xc0", 3);
+    BOOST_CHECK_THROW(validate(reinterpret_cast<const uint8_t *>(invalid.data()), invalid.size()), decode_value_error);
+    BOOST_CHECK_NO_THROW(validate(reinterpret_cast<const uint8_t *>(buffer.data()), buffer.size()));
+
+    // The largest and smallest exponent are reserved for infinity and NaN.
+    for (auto exponent: {static_cast<int64_t>(INT32_MAX), static_cast<int64_t>(INT32_MIN), static_cast<int64_t>(INT32_MAX) + 1}) {
+        auto sentinel = "\x15" + encode(static_cast<int64_t>(1)) + encode(exponent);
+        auto sentinelStream = stringstream(sentinel);
+        BOOST_CHECK_THROW(decode<DecimalFloat>(sentinel), decode_overflow_error);
+        BOOST_CHECK_THROW(decode<DecimalFloat>(sentinelStream), decode_overflow_error);
+        BOOST_CHECK_THROW(validate(reinterpret_cast<const uint8_t *>(sentinel.data()), sentinel.size()), decode_overflow_error);
+    }
+    auto largest = "\x15" + encode(static_cast<int64_t>(1)) + encode(static_cast<int64_t>(INT32_MAX - 1));
+    BOOST_CHECK(decode<DecimalFloat>(largest) == DecimalFloat(1, INT32_MAX - 1));
+    BOOST_CHECK_NO_THROW(validate(reinterpret_cast<const uint8_t *>(largest.data()), largest.size()));
+
+    // Stripping trailing zero digits must not move the exponent onto a sentinel.
+    for (auto mantissa: {static_cast<int64_t>(10), static_cast<int64_t>(100)}) {
+        auto stripped = "\x15" + encode(mantissa) + encode(static_cast<int64_t>(INT32_MAX - 1));
+        auto strippedStream = stringstream(stripped);
+        BOOST_CHECK_THROW(decode<DecimalFloat>(stripped), decode_overflow_error);
+        BOOST_CHECK_THROW(decode<DecimalFloat>(strippedStream), decode_overflow_error);
+        BOOST_CHECK_THROW(DecimalFloat(mantissa, INT32_MAX - 1), decimal_float_overflow_error);
+    }
+    auto shifted = "\x15" + encode(static_cast<int64_t>(10)) + encode(static_cast<int64_t>(INT32_MAX - 2));
+    BOOST_CHECK(decode<DecimalFloat>(shifted) == DecimalFloat(1, INT32_MAX - 1));
+}
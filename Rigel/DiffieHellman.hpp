@@ -15,19 +15,47 @@
  * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 #include "BigInt.hpp"
 #include "SHA512.hpp"
 
 namespace Orion {
 namespace Rigel {
 
+/** Get the fixed-base table of a generator.
+ * The table is built the first time a group is used, and then shared by
+ * all Diffie-Hellman instances of the process. The function has external
+ * linkage, so that all translation units share the same tables.
+ *
+ * @param g Generator.
+ * @param mc Montgomery context of the prime of the group.
+ */
+template<int M>
+inline const MontgomeryFixedBase<M> &generatorTable(const BigInt<M> &g, const MontgomeryContext<M> &mc)
+{
+    static std::mutex mutex;
+    static std::map<std::string, std::unique_ptr<const MontgomeryFixedBase<M>>> tables;
+
+    auto key = std::string(g.data(), g.size()) + std::string(mc.modulus.data(), mc.modulus.size());
+
+    auto lock = std::lock_guard<std::mutex>(mutex);
+    auto &table = tables[key];
+    if (!table) {
+        table.reset(new MontgomeryFixedBase<M>(g, mc));
+    }
+    return *table;
+}
+
 /** Implementation of Diffie-Hellman key exchange algorithm
  */
 template<int M>
 class DiffieHellman {
 public:
     BigInt<M> g;
-    BarretReduction<M+1> br;
+    MontgomeryContext<M> mc;
     BigInt<M> privateKey;
     BigInt<M> myPublicKey;
 
@@ -38,9 +66,9 @@ public:
      * @param privateKey A fixed private key loaded.
      */
     inline DiffieHellman(const BigInt<M> &g, const BigInt<M> &m, const BigInt<M> &privateKey) :
-        g(g), br(BarretReduction<M+1>(m)), privateKey(privateKey), myPublicKey()
+        g(g), mc(m), privateKey(privateKey), myPublicKey()
     {
-        myPublicKey = g.modularPower(privateKey, br);
+        myPublicKey = generatorTable(g, mc).modularPower(privateKey);
     }
 
     /** Initialize Diffie-Hellman with a random private key.
@@ -49,9 +77,9 @@ public:
      * @param m Prime used as modulo.
      */
     inline DiffieHellman(const BigInt<M> &g, const BigInt<M> &m) :
-        g(g), br(BarretReduction<M+1>(m)), privateKey(BigIntRandom<M>()), myPublicKey()
+        g(g), mc(m), privateKey(BigIntRandom<M>()), myPublicKey()
     {
-        myPublicKey = g.modularPower(privateKey, br);
+        myPublicKey = generatorTable(g, mc).modularPower(privateKey);
     }
 
     /** Get keying material.
@@ -65,7 +93,7 @@ public:
      * @return 512 Bits of keying material.
      */
     inline BigInt<512> getKeyingMaterial(const BigInt<M> &theirPublicKey, const char *otherInfo, size_t otherInfoSize) {
-        auto sharedKey = theirPublicKey.modularPower(privateKey, br);
+        auto sharedKey = theirPublicKey.modularPower(privateKey, mc);
 
         auto tmp = sharedKey.toLittleEndian();
         auto H = SHA512();
@@ -15,6 +15,10 @@
  * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
  */
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
 
 namespace Orion {
 namespace Rigel {
@@ -35,7 +39,138 @@ const char DECIMAL_FLOAT_CODE = 0x15;
 const char BINARY_FLOAT_CODE = 0x16;
 const char BYTE_ARRAY_CODE = 0x17;
 const char UTF8_STRING_CODE = 0x18;
-const char RESERVED1_CODE = 0x19;
-const char RESERVED2_CODE = 0x1a;
+const char TYPED_ARRAY_CODE = 0x19;
+const char NAMED_DICTIONARY_CODE = 0x1a;
+
+/** The default maximum nesting of lists and dictionaries.
+ * Decoders that recurse into containers stop at this depth, so that a
+ * message of only list-codes can not exhaust the stack.
+ */
+const size_t RSON_MAXIMUM_DEPTH = 256;
+
+/** The element type of a typed array.
+ */
+enum class ArrayType: uint8_t {
+    Int8 = 0,
+    UInt8 = 1,
+    Int16 = 2,
+    UInt16 = 3,
+    Int32 = 4,
+    UInt32 = 5,
+    Int64 = 6,
+    UInt64 = 7,
+    Float32 = 8,
+    Float64 = 9
+};
+
+const uint8_t MAXIMUM_ARRAY_TYPE = 9;
+
+/** Number of bytes of an element of a typed array.
+ */
+constexpr size_t arrayTypeSize(ArrayType type)
+{
+    switch (type) {
+    case ArrayType::Int8: case ArrayType::UInt8: return 1;
+    case ArrayType::Int16: case ArrayType::UInt16: return 2;
+    case ArrayType::Int32: case ArrayType::UInt32: case ArrayType::Float32: return 4;
+    default: return 8;
+    }
+}
+
+/** Types which can be the element of a typed array.
+ */
+template<typename T>
+constexpr bool isArrayElement(void)
+{
+    return
+        (std::is_integral<T>::value && !std::is_same<bool, T>::value && sizeof (T) <= 8) ||
+        std::is_same<float, T>::value ||
+        std::is_same<double, T>::value;
+}
+
+template<typename T>
+constexpr ArrayType arrayType(void)
+{
+    static_assert(isArrayElement<T>(), "Not an element type of a typed array");
+
+    if constexpr (std::is_same<float, T>::value) {
+        return ArrayType::Float32;
+    } else if constexpr (std::is_same<double, T>::value) {
+        return ArrayType::Float64;
+    } else {
+        // Types are ordered by size, signed before unsigned.
+        constexpr int log2Size = sizeof (T) == 1 ? 0 : sizeof (T) == 2 ? 1 : sizeof (T) == 4 ? 2 : 3;
+        return static_cast<ArrayType>(log2Size * 2 + std::is_unsigned<T>::value);
+    }
+}
+
+/** Call a function with a value of the C++ type of an array element type.
+ * The value is only used to select the type, for example with decltype.
+ *
+ * @return The return value of f.
+ */
+template<typename F>
+static inline auto dispatchArrayType(ArrayType type, F &&f)
+{
+    switch (type) {
+    case ArrayType::Int8: return f(static_cast<int8_t>(0));
+    case ArrayType::UInt8: return f(static_cast<uint8_t>(0));
+    case ArrayType::Int16: return f(static_cast<int16_t>(0));
+    case ArrayType::UInt16: return f(static_cast<uint16_t>(0));
+    case ArrayType::Int32: return f(static_cast<int32_t>(0));
+    case ArrayType::UInt32: return f(static_cast<uint32_t>(0));
+    case ArrayType::Int64: return f(static_cast<int64_t>(0));
+    case ArrayType::UInt64: return f(static_cast<uint64_t>(0));
+    case ArrayType::Float32: return f(static_cast<float>(0));
+    default: return f(static_cast<double>(0));
+    }
+}
+
+/** A contiguous array of numbers, encoded as a typed array.
+ * The array is referenced, not copied, and must outlive the encoder and sink.
+ *
+ * A typed array is decoded with a single copy into a std::vector of the
+ * same element type, instead of decoding each item of a list.
+ */
+template<typename T>
+struct RSONTypedArray {
+    static_assert(isArrayElement<T>(), "Not an element type of a typed array");
+
+    const T *data;
+    size_t size;
+
+    inline RSONTypedArray(const T *data, size_t size) : data(data), size(size) {}
+    inline RSONTypedArray(const std::vector<T> &items) : data(items.data()), size(items.size()) {}
+};
+
+template<typename T>
+static inline RSONTypedArray<T> typedArray(const std::vector<T> &items)
+{
+    return RSONTypedArray<T>(items);
+}
+
+/** Integer types of which lists are encoded and decoded in batches.
+ * Values of these types fit in an int64_t, which the batched encoder works on.
+ */
+template<typename T>
+constexpr bool isBatchInteger(void)
+{
+    return
+        std::is_integral<T>::value &&
+        !std::is_same<bool, T>::value &&
+        (sizeof (T) < 8 || (sizeof (T) == 8 && std::is_signed<T>::value));
+}
+
+/** Compile time description of the fields of a struct.
+ * Specializations are declared with the RSON_SCHEMA() macro from RSONSchema.hpp.
+ */
+template<typename T>
+struct RSONSchema;
+
+template<typename T, typename = void>
+struct has_rson_schema: std::false_type {};
+
+template<typename T>
+struct has_rson_schema<T, std::void_t<decltype(RSONSchema<T>::fields)>>: std::true_type {};
 
 };};
@@ -0,0 +1,647 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** Benchmarks of the RSON encoder and decoder.
+ *
+ * Each benchmark reports the time per message, the throughput over the
+ * encoded size of the message and the number of heap allocations per message.
+ *
+ * Usage: RSONBenchmarks [--filter <text>] [--time <seconds>] [--output <file.csv>] [--compare <file.csv>]
+ *  --filter   Only run the benchmarks with the text in their name.
+ *  --time     Minimum duration of each benchmark, default 0.1 seconds.
+ *  --output   Write the results as CSV, to compare with later runs.
+ *  --compare  Show the change in time per message against an earlier run.
+ *
+ * The `benchmark` target of the build runs all benchmarks and writes
+ * RSONBenchmarks.csv in the build directory.
+ */
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <functional>
+#include <boost/any.hpp>
+#include "RSONEncode.hpp"
+#include "RSONDecode.hpp"
+#include "RSONSchema.hpp"
+#include "RSONView.hpp"
+#include "RSONValue.hpp"
+#include "RSONStreamDecoder.hpp"
+#include "RSONCanonical.hpp"
+#include "CBSONEncode.hpp"
+#include "CBSONDecode.hpp"
+#include "RSONCompress.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+/** Number of calls to operator new.
+ */
+static size_t allocationCount = 0;
+
+/** Allocate memory for all forms of operator new, counting each call.
+ * The allocation functions are not inlined, so that the compiler does not
+ * match the malloc() and free() inside them against new and delete.
+ */
+__attribute__((noinline)) static void *countedAllocate(size_t size, size_t alignment = alignof(max_align_t))
+{
+    allocationCount++;
+    size = size > 0 ? size : 1;
+    void *p = nullptr;
+    if (alignment <= alignof(max_align_t)) {
+        p = malloc(size);
+    } else if (posix_memalign(&p, alignment, size) != 0) {
+        p = nullptr;
+    }
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) static void countedFree(void *p) noexcept
+{
+    free(p);
+}
+
+void *operator new(size_t size) { return countedAllocate(size); }
+void *operator new[](size_t size) { return countedAllocate(size); }
+void *operator new(size_t size, align_val_t alignment) { return countedAllocate(size, static_cast<size_t>(alignment)); }
+void *operator new[](size_t size, align_val_t alignment) { return countedAllocate(size, static_cast<size_t>(alignment)); }
+
+void operator delete(void *p) noexcept { countedFree(p); }
+void operator delete[](void *p) noexcept { countedFree(p); }
+void operator delete(void *p, size_t size) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t size) noexcept { countedFree(p); }
+void operator delete(void *p, align_val_t alignment) noexcept { countedFree(p); }
+void operator delete[](void *p, align_val_t alignment) noexcept { countedFree(p); }
+void operator delete(void *p, size_t size, align_val_t alignment) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t size, align_val_t alignment) noexcept { countedFree(p); }
+
+struct BenchmarkResult {
+    string name{};
+    size_t messageSize = 0;
+    double nsPerMessage = 0.0;
+    double MBPerSecond = 0.0;
+    double allocationsPerMessage = 0.0;
+};
+
+static string filter;
+static double minimumTime = 0.1;
+static vector<BenchmarkResult> results;
+static map<string, BenchmarkResult> baseline;
+
+/** Run a function repeatedly and report its throughput.
+ *
+ * @param name Name of the benchmark.
+ * @param messageSize Number of RSON bytes handled by a single call.
+ * @param f The function to benchmark.
+ */
+static void benchmark(const string &name, size_t messageSize, const function<void(void)> &f)
+{
+    if (name.find(filter) == string::npos) {
+        return;
+    }
+
+    // Warm up caches and calibrate the number of iterations to the minimum time.
+    size_t iterations = 1;
+    size_t allocations;
+    chrono::duration<double> duration;
+    while (true) {
+        auto allocationsBefore = allocationCount;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            f();
+        }
+        duration = chrono::steady_clock::now() - start;
+        allocations = allocationCount - allocationsBefore;
+
+        if (duration.count() >= minimumTime) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    auto r = BenchmarkResult{
+        name,
+        messageSize,
+        duration.count() * 1e9 / iterations,
+        (messageSize * iterations) / duration.count() / 1e6,
+        static_cast<double>(allocations) / iterations
+    };
+    results.push_back(r);
+
+    cout << name << ": " << r.nsPerMessage << " ns/message " << r.MBPerSecond << " MB/s " <<
+        r.allocationsPerMessage << " allocations/message";
+
+    auto i = baseline.find(name);
+    if (i != baseline.end()) {
+        auto change = (r.nsPerMessage / i->second.nsPerMessage - 1.0) * 100.0;
+        cout << " (" << showpos << change << noshowpos << "% time)";
+    }
+    cout << endl;
+}
+
+static void writeResults(const string &filename)
+{
+    auto file = ofstream(filename);
+    file << "name,bytes,ns_per_message,mb_per_second,allocations_per_message" << endl;
+    for (auto &r: results) {
+        file << r.name << "," << r.messageSize << "," << r.nsPerMessage << "," << r.MBPerSecond << "," << r.allocationsPerMessage << endl;
+    }
+}
+
+static void readBaseline(const string &filename)
+{
+    auto file = ifstream(filename);
+    if (!file) {
+        cerr << "Could not open " << filename << endl;
+        exit(1);
+    }
+
+    auto line = string();
+    getline(file, line);
+    while (getline(file, line)) {
+        auto fields = vector<string>();
+        auto stream = stringstream(line);
+        auto field = string();
+        while (getline(stream, field, ',')) {
+            fields.push_back(field);
+        }
+        if (fields.size() == 5) {
+            baseline[fields[0]] = BenchmarkResult{fields[0], stoul(fields[1]), stod(fields[2]), stod(fields[3]), stod(fields[4])};
+        }
+    }
+}
+
+// RIRPC messages, see RIRPC.md.
+struct RegisterHostCall {
+    string environment{};
+    int64_t hostTimestamp = 0;
+    string hostName{};
+};
+
+RSON_SCHEMA(RegisterHostCall, nullptr, environment, hostTimestamp, hostName)
+
+struct RegisterHostResponse {
+    int64_t masterTimestamp = 0;
+    int64_t hostTimestamp = 0;
+    int64_t hostID = 0;
+};
+
+RSON_SCHEMA(RegisterHostResponse, nullptr, masterTimestamp, hostTimestamp, hostID)
+
+struct ServiceFunction {
+    string name{};
+    int64_t ID = 0;
+};
+
+RSON_SCHEMA(ServiceFunction, nullptr, name, ID)
+
+struct ServiceInstance {
+    string serviceName{};
+    int64_t MODPGroupID = 0;
+    int64_t publicKey = 0;
+    vector<string> listeners{};
+    vector<ServiceFunction> functions{};
+};
+
+RSON_SCHEMA(ServiceInstance, nullptr, serviceName, MODPGroupID, publicKey, listeners, functions)
+
+struct SearchServiceResponse {
+    string serviceName{};
+    vector<ServiceInstance> instances{};
+};
+
+RSON_SCHEMA(SearchServiceResponse, nullptr, serviceName, instances)
+
+static RegisterHostCall registerHostCall(void)
+{
+    return RegisterHostCall{"production", 1530000000123456789, "rigel-host-17.example.com"};
+}
+
+static RegisterHostResponse registerHostResponse(void)
+{
+    return RegisterHostResponse{1530000000123987654, 1530000000123456789, 17};
+}
+
+static SearchServiceResponse searchServiceResponse(void)
+{
+    auto r = SearchServiceResponse();
+    r.serviceName = "Alnitak.messaging";
+    for (int64_t i = 0; i < 8; i++) {
+        auto instance = ServiceInstance();
+        instance.serviceName = r.serviceName;
+        instance.MODPGroupID = 14;
+        instance.publicKey = 0x5deece66d * (i + 1);
+        for (int64_t j = 0; j < 4; j++) {
+            instance.listeners.push_back("ritp://10.0." + to_string(i) + "." + to_string(j) + ":4000");
+        }
+        for (auto name: {"send", "receive", "subscribe", "unsubscribe", "history", "presence"}) {
+            instance.functions.push_back(ServiceFunction{name, static_cast<int64_t>(instance.functions.size())});
+        }
+        r.instances.push_back(instance);
+    }
+    return r;
+}
+
+static map<string, any> registerMessage(void)
+{
+    auto listeners = vector<any>();
+    for (int64_t i = 0; i < 8; i++) {
+        listeners.push_back(map<string, any>{
+            {"address", string("10.0.0.") + to_string(i)},
+            {"port", 4000 + i},
+            {"protocol", string("ritp")}
+        });
+    }
+
+    return map<string, any>{
+        {"serviceName", string("Alnitak.messaging")},
+        {"hostID", static_cast<int64_t>(42)},
+        {"time", static_cast<int64_t>(1530000000000000000)},
+        {"drift", 0.125},
+        {"listeners", listeners}
+    };
+}
+
+/** Dictionaries and lists nested inside each other.
+ */
+static any deepMessage(int depth)
+{
+    auto r = any(string("leaf"));
+    for (int64_t i = 0; i < depth; i++) {
+        r = map<string, any>{
+            {"children", vector<any>{r, i}},
+            {"depth", i}
+        };
+    }
+    return r;
+}
+
+static string chatBody(void)
+{
+    auto r = string();
+    while (r.size() < 2000) {
+        r += "Meet me at the caf\xc3\xa9 near the north gate, bring 20\xe2\x82\xac. ";
+    }
+    return r;
+}
+
+static vector<int64_t> integerList(void)
+{
+    auto r = vector<int64_t>();
+    for (int64_t i = 0; i < 1000; i++) {
+        r.push_back(i * i * 1000 - 500000);
+    }
+    return r;
+}
+
+// The encoder does not know about boost::any, so encode the test message by hand.
+template<typename S>
+static void encodeAny(S &s, const any &value)
+{
+    if (value.type() == typeid(int64_t)) {
+        encode(s, any_cast<int64_t>(value));
+    } else if (value.type() == typeid(double)) {
+        encode(s, any_cast<double>(value));
+    } else if (value.type() == typeid(string)) {
+        encode(s, any_cast<const string &>(value));
+    } else if (value.type() == typeid(vector<any>)) {
+        s += LIST_CODE;
+        for (auto &item: any_cast<const vector<any> &>(value)) {
+            encodeAny(s, item);
+        }
+        s += MARK_CODE;
+    } else if (value.type() == typeid(map<string, any>)) {
+        auto &items = any_cast<const map<string, any> &>(value);
+        s += DICTIONARY_CODE;
+        for (auto &item: items) {
+            encode(s, item.first);
+        }
+        s += MARK_CODE;
+        for (auto &item: items) {
+            encodeAny(s, item.second);
+        }
+    }
+}
+
+template<typename S>
+static void encodeAnyCBSON(S &s, const any &value)
+{
+    if (value.type() == typeid(int64_t)) {
+        encodeCBSON(s, any_cast<int64_t>(value));
+    } else if (value.type() == typeid(double)) {
+        encodeCBSON(s, any_cast<double>(value));
+    } else if (value.type() == typeid(string)) {
+        encodeCBSON(s, any_cast<string>(value));
+    } else if (value.type() == typeid(vector<any>)) {
+        auto &items = any_cast<const vector<any> &>(value);
+        encodeCBSONCode(s, CBSON_LIST_CODE, items.size());
+        for (auto &item: items) {
+            encodeAnyCBSON(s, item);
+        }
+    } else if (value.type() == typeid(map<string, any>)) {
+        auto &items = any_cast<const map<string, any> &>(value);
+        encodeCBSONCode(s, CBSON_DICTIONARY_CODE, items.size());
+        for (auto &item: items) {
+            encodeCBSONKey(s, item.first);
+            encodeAnyCBSON(s, item.second);
+        }
+    }
+}
+
+template<typename S, typename T>
+static void encodeValue(S &s, const T &value)
+{
+    if constexpr (std::is_same<T, any>::value) {
+        encodeAny(s, value);
+    } else {
+        encode(s, value);
+    }
+}
+
+/** Run the benchmarks of every encoder and decoder on a message.
+ *
+ * @param name Name of the message.
+ * @param value The message, a boost::any is only decoded by the generic decoders.
+ */
+template<typename T>
+static void benchmarkMessage(const string &name, const T &value)
+{
+    auto message = string();
+    encodeValue(message, value);
+    auto size = message.size();
+
+    // Encoders.
+    benchmark(name + " encode string", size, [&]() {
+        auto s = string();
+        encodeValue(s, value);
+    });
+    auto reused = string();
+    benchmark(name + " encode reused string", size, [&]() {
+        reused.clear();
+        encodeValue(reused, value);
+    });
+    auto buffer = vector<uint8_t>(size);
+    benchmark(name + " encode buffer sink", size, [&]() {
+        auto s = RSONBufferSink(buffer.data(), buffer.size());
+        encodeValue(s, value);
+    });
+    auto iovec = RSONIOVecSink();
+    benchmark(name + " encode iovec sink", size, [&]() {
+        iovec.clear();
+        encodeValue(iovec, value);
+    });
+    auto output = ostringstream();
+    benchmark(name + " encode stream sink", size, [&]() {
+        output.seekp(0);
+        auto s = RSONStreamSink(output);
+        encodeValue(s, value);
+        s.flush();
+    });
+
+    // Decoders.
+    benchmark(name + " decode istream", size, [&]() {
+        auto stream = stringstream(message);
+        decode(stream);
+    });
+    benchmark(name + " decode cursor", size, [&]() {
+        decode(message);
+    });
+    if constexpr (!std::is_same<T, any>::value) {
+        benchmark(name + " decode typed", size, [&]() {
+            decode<T>(message);
+        });
+        auto into = T();
+        benchmark(name + " decode into", size, [&]() {
+            decodeInto(message, into);
+        });
+    }
+    RSONArena arena;
+    benchmark(name + " decode arena", size, [&]() {
+        arena.reset();
+        decodeValue(message, arena);
+    });
+    RSONHandler handler;
+    RSONStreamDecoder streamDecoder(handler);
+    benchmark(name + " decode stream events", size, [&]() {
+        streamDecoder.feed(message);
+    });
+    RSONAnyBuilder builder([](any &&value) {});
+    RSONStreamDecoder builderDecoder(builder);
+    benchmark(name + " decode stream builder", size, [&]() {
+        builderDecoder.feed(message);
+    });
+
+    // Other passes over an encoded message.
+    auto data = reinterpret_cast<const uint8_t *>(message.data());
+    benchmark(name + " skip", size, [&]() {
+        fieldLength(data, size);
+    });
+    benchmark(name + " validate", size, [&]() {
+        validate(data, size);
+    });
+    benchmark(name + " canonicalize", size, [&]() {
+        canonicalize(message);
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    auto output = string();
+    for (int i = 1; i < argc; i++) {
+        auto option = string(argv[i]);
+        if (i + 1 == argc) {
+            cerr << "Missing value for " << option << endl;
+            return 1;
+        } else if (option == "--filter") {
+            filter = argv[++i];
+        } else if (option == "--time") {
+            minimumTime = stod(argv[++i]);
+        } else if (option == "--output") {
+            output = argv[++i];
+        } else if (option == "--compare") {
+            readBaseline(argv[++i]);
+        } else {
+            cerr << "Unknown option " << option << endl;
+            return 1;
+        }
+    }
+
+    // Realistic messages.
+    benchmarkMessage("register host call", registerHostCall());
+    benchmarkMessage("register host response", registerHostResponse());
+    benchmarkMessage("search service response", searchServiceResponse());
+    benchmarkMessage("register message", any(registerMessage()));
+    benchmarkMessage("deep message", deepMessage(64));
+    benchmarkMessage("chat body", chatBody());
+    benchmarkMessage("integer list", integerList());
+
+    auto message = string();
+    encodeAny(message, any(registerMessage()));
+
+    benchmark("view message lookup", message.size(), [&]() {
+        auto view = RSONView(message);
+        view["serviceName"].as<string>();
+        view["listeners"][7]["port"].as<int64_t>();
+    });
+
+    // The same message in CBSON.
+    auto cbsonMessage = string();
+    encodeAnyCBSON(cbsonMessage, registerMessage());
+    auto anyMessage = any(registerMessage());
+
+    benchmark("encode message cbson", cbsonMessage.size(), [&]() {
+        auto s = string();
+        encodeAnyCBSON(s, anyMessage);
+    });
+    benchmark("decode message cbson", cbsonMessage.size(), [&]() {
+        decodeCBSON(cbsonMessage);
+    });
+    benchmark("skip message cbson", cbsonMessage.size(), [&]() {
+        auto cursor = CBSONCursor(cbsonMessage);
+        skipCBSON(cursor);
+    });
+
+    // Every message after the first on a connection sends its keys as indices.
+    auto encoderStrings = CBSONInternTable();
+    auto decoderStrings = CBSONInternTable();
+    auto internedMessage = string();
+    auto internedSink = CBSONInternSink<string>(internedMessage, encoderStrings);
+    encodeAnyCBSON(internedSink, anyMessage);
+    auto internedCursor = CBSONCursor(internedMessage, &decoderStrings);
+    decodeCBSON(internedCursor);
+    internedMessage.clear();
+    encodeAnyCBSON(internedSink, anyMessage);
+
+    benchmark("encode message cbson interned", internedMessage.size(), [&]() {
+        auto s = string();
+        auto sink = CBSONInternSink<string>(s, encoderStrings);
+        encodeAnyCBSON(sink, anyMessage);
+    });
+    benchmark("decode message cbson interned", internedMessage.size(), [&]() {
+        auto cursor = CBSONCursor(internedMessage, &decoderStrings);
+        decodeCBSON(cursor);
+    });
+
+    // A stream of register messages over a single connection.
+    auto compressor = RSONCompressor();
+    auto decompressor = RSONDecompressor();
+    auto compressedMessage = compressor.compress(message);
+    decompressor.decompress(compressedMessage);
+
+    benchmark("compress message", message.size(), [&]() {
+        compressedMessage = compressor.compress(message);
+    });
+    benchmark("decompress message", message.size(), [&]() {
+        decompressor.decompress(compressedMessage);
+    });
+    cout << "compress message ratio: " << compressor.ratio() << " (" << message.size() << " -> " << compressedMessage.size() << " bytes)" << endl;
+
+    // Typical key lengths, short values and longer message bodies.
+    for (size_t length: {4, 12, 24, 64, 256}) {
+        auto ascii = string();
+        auto utf8 = string("\xc3\xa9");
+        while (ascii.size() < length) {
+            ascii += static_cast<char>('a' + ascii.size() % 26);
+            utf8 += static_cast<char>('a' + utf8.size() % 26);
+        }
+
+        auto asciiMessage = encode(ascii);
+        auto utf8Message = encode(utf8);
+
+        benchmark("decode ascii string " + to_string(length) + " istream", asciiMessage.size(), [&]() {
+            auto stream = stringstream(asciiMessage);
+            decode<string>(stream);
+        });
+        benchmark("decode ascii string " + to_string(length) + " cursor", asciiMessage.size(), [&]() {
+            decode<string>(asciiMessage);
+        });
+        benchmark("decode utf8 string " + to_string(length) + " istream", utf8Message.size(), [&]() {
+            auto stream = stringstream(utf8Message);
+            decode<string>(stream);
+        });
+        benchmark("decode utf8 string " + to_string(length) + " cursor", utf8Message.size(), [&]() {
+            decode<string>(utf8Message);
+        });
+    }
+
+    auto integers = integerList();
+    auto integersMessage = encode(integers);
+
+    benchmark("decode integers batched", integersMessage.size(), [&]() {
+        decode<vector<int64_t>>(integersMessage);
+    });
+    benchmark("encode integers batched", integersMessage.size(), [&]() {
+        encode(integers);
+    });
+
+    auto integersTypedMessage = encode(typedArray(integers));
+    benchmark("decode integers typed array", integersTypedMessage.size(), [&]() {
+        decode<vector<int64_t>>(integersTypedMessage);
+    });
+
+    auto integersCBSONMessage = encodeCBSON(integers);
+    benchmark("decode integers cbson", integersCBSONMessage.size(), [&]() {
+        decodeCBSON<vector<int64_t>>(integersCBSONMessage);
+    });
+    benchmark("encode integers cbson", integersCBSONMessage.size(), [&]() {
+        encodeCBSON(integers);
+    });
+
+    auto floats = vector<double>();
+    for (int i = 0; i < 1000; i++) {
+        floats.push_back((i - 500) * 0.37);
+    }
+    auto floatsMessage = encode(floats);
+
+    benchmark("decode floats cursor", floatsMessage.size(), [&]() {
+        decode(floatsMessage);
+    });
+    benchmark("decode floats batched", floatsMessage.size(), [&]() {
+        decode<vector<double>>(floatsMessage);
+    });
+    benchmark("encode floats batched", floatsMessage.size(), [&]() {
+        encode(floats);
+    });
+
+    auto floatsTypedMessage = encode(typedArray(floats));
+    benchmark("decode floats typed array", floatsTypedMessage.size(), [&]() {
+        decode<vector<double>>(floatsTypedMessage);
+    });
+    benchmark("encode floats typed array", floatsTypedMessage.size(), [&]() {
+        encode(typedArray(floats));
+    });
+
+    auto floatsCBSONMessage = encodeCBSON(floats);
+    benchmark("decode floats cbson", floatsCBSONMessage.size(), [&]() {
+        decodeCBSON<vector<double>>(floatsCBSONMessage);
+    });
+    benchmark("encode floats cbson", floatsCBSONMessage.size(), [&]() {
+        encodeCBSON(floats);
+    });
+
+    if (!output.empty()) {
+        writeResults(output);
+    }
+    return 0;
+}
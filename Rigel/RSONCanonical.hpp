@@ -0,0 +1,544 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <boost/exception/all.hpp>
+
+#include "RSON.hpp"
+#include "RSONDecode.hpp"
+#include "RSONEncode.hpp"
+#include "RSONSink.hpp"
+#include "DecimalFloat.hpp"
+#include "SHA512.hpp"
+
+namespace Orion {
+namespace Rigel {
+
+// Forward for comparing the items of lists and dictionaries.
+static inline int compareField(RSONCursor &a, RSONCursor &b, size_t maximumDepth = RSON_MAXIMUM_DEPTH);
+
+/** The position of the type of a field in the canonical sort order.
+ *
+ * @param cursor Cursor pointing to the start of the field.
+ * @return The rank of the type, lower ranks sort first.
+ */
+static inline int canonicalRank(const RSONCursor &cursor)
+{
+    if (cursor.empty()) {
+        BOOST_THROW_EXCEPTION(decode_eof_error());
+    }
+
+    auto c = *cursor.ptr;
+    switch (c) {
+    case NONE_CODE: return 0;
+    case FALSE_CODE: return 1;
+    case TRUE_CODE: return 2;
+    case BINARY_FLOAT_CODE: return 4;
+    case DECIMAL_FLOAT_CODE: return 5;
+    case UTF8_STRING_CODE: return 6;
+    case BYTE_ARRAY_CODE: return 7;
+    case LIST_CODE: return 8;
+    case TYPED_ARRAY_CODE: return 9;
+    case DICTIONARY_CODE: return 10;
+    case NAMED_DICTIONARY_CODE: return 10;
+    case MARK_CODE:
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    default:
+        return (c & 0x80) ? 3 : 6;
+    }
+}
+
+static inline int compareSign(int64_t a, int64_t b)
+{
+    return (a > b) - (a < b);
+}
+
+/** Compare two integers without decoding them.
+ * Integers are encoded in the least amount of bytes, so with the same sign
+ * the longer integer has the larger magnitude. Integers of the same length
+ * compare as their septets, most significant first.
+ */
+static inline int compareInteger(RSONCursor &a, RSONCursor &b)
+{
+    auto startA = a.ptr;
+    auto startB = b.ptr;
+    skip(a);
+    skip(b);
+    auto sizeA = a.ptr - startA;
+    auto sizeB = b.ptr - startB;
+
+    auto negativeA = sizeA == 1 ? (*startA & 0x20) > 0 : (*(a.ptr - 1) & 0x40) > 0;
+    auto negativeB = sizeB == 1 ? (*startB & 0x20) > 0 : (*(b.ptr - 1) & 0x40) > 0;
+    if (negativeA != negativeB) {
+        return negativeA ? -1 : 1;
+    }
+
+    if (sizeA != sizeB) {
+        auto r = compareSign(sizeA, sizeB);
+        return negativeA ? -r : r;
+    }
+
+    for (auto i = sizeA - 1; i >= 0; i--) {
+        auto mask = i == 0 ? 0x3f : 0x7f;
+        if (auto r = compareSign(startA[i] & mask, startB[i] & mask)) {
+            return r;
+        }
+    }
+    return 0;
+}
+
+/** Compare two binary floats.
+ * -infinite, ascending values, +infinite, NaN.
+ */
+static inline int compareBinaryFloat(RSONCursor &a, RSONCursor &b)
+{
+    struct BinaryFloat {
+        int rank;
+        int64_t mantissa;
+        int64_t exponent;
+    };
+
+    auto read = [](RSONCursor &cursor) {
+        auto r = BinaryFloat{0, 0, 0};
+        cursor.ptr++;
+        switch (auto t = peekType(cursor)) {
+        case Type::None: cursor.ptr++; r.rank = 2; break;
+        case Type::Boolean: r.rank = decode<bool>(cursor) ? -1 : 1; break;
+        case Type::Integer:
+            r.mantissa = decode<int64_t>(cursor);
+            if (r.mantissa != 0) {
+                r.exponent = decode<int64_t>(cursor);
+            }
+            break;
+        case Type::EndOfFile: BOOST_THROW_EXCEPTION(decode_eof_error());
+        default: BOOST_THROW_EXCEPTION(decode_type_error() << type_info(t));
+        }
+        return r;
+    };
+
+    auto x = read(a);
+    auto y = read(b);
+    if (x.rank != y.rank || x.rank != 0) {
+        return compareSign(x.rank, y.rank);
+    }
+
+    auto signX = compareSign(x.mantissa, 0);
+    auto signY = compareSign(y.mantissa, 0);
+    if (signX != signY || signX == 0) {
+        return compareSign(signX, signY);
+    }
+
+    // Compare the magnitudes, first by the position of the most significant bit.
+    auto magnitudeX = x.mantissa < 0 ? -static_cast<uint64_t>(x.mantissa) : static_cast<uint64_t>(x.mantissa);
+    auto magnitudeY = y.mantissa < 0 ? -static_cast<uint64_t>(y.mantissa) : static_cast<uint64_t>(y.mantissa);
+    auto bitsX = 64 - __builtin_clzll(magnitudeX);
+    auto bitsY = 64 - __builtin_clzll(magnitudeY);
+    auto orderX = static_cast<__int128>(bitsX) + x.exponent;
+    auto orderY = static_cast<__int128>(bitsY) + y.exponent;
+
+    int r;
+    if (orderX != orderY) {
+        r = orderX > orderY ? 1 : -1;
+    } else {
+        // Align to the same number of bits, which fits in 64 bits.
+        if (bitsX < bitsY) {
+            magnitudeX <<= bitsY - bitsX;
+        } else {
+            magnitudeY <<= bitsX - bitsY;
+        }
+        r = (magnitudeX > magnitudeY) - (magnitudeX < magnitudeY);
+    }
+    return signX < 0 ? -r : r;
+}
+
+/** The bytes of an encoded string, without copying.
+ * The last character of an ASCII string carries the stop-bit, it is kept
+ * separately with the stop-bit removed.
+ */
+struct RSONStringBytes {
+    const uint8_t *data;
+    size_t size;
+    uint8_t last;
+
+    inline RSONStringBytes(RSONCursor &cursor) :
+        RSONStringBytes(cursor, cursor.get() == UTF8_STRING_CODE) {}
+
+    /** Members are initialized in order, so size and last follow from data.
+     * The byte after a UTF-8 string is its mark, after an ASCII string
+     * it is the last character.
+     */
+    inline RSONStringBytes(RSONCursor &cursor, bool utf8) :
+        data(utf8 ? cursor.ptr : cursor.ptr - 1),
+        size((utf8 ? skipMark(cursor) : skipStopBit(cursor)) - data),
+        last(utf8 ? 0 : data[size] & 0x7f) {}
+
+    inline size_t length(void) const {
+        return size + (last != 0);
+    }
+
+    inline uint8_t operator[](size_t i) const {
+        return i < size ? data[i] : last;
+    }
+};
+
+/** Compare two strings by the bytes of their UTF-8 encoding.
+ */
+static inline int compareString(RSONCursor &a, RSONCursor &b)
+{
+    auto x = RSONStringBytes(a);
+    auto y = RSONStringBytes(b);
+
+    auto n = std::min(x.size, y.size);
+    if (auto r = memcmp(x.data, y.data, n)) {
+        return r < 0 ? -1 : 1;
+    }
+
+    for (auto i = n; ; i++) {
+        auto endX = i >= x.length();
+        auto endY = i >= y.length();
+        if (endX || endY) {
+            return compareSign(endY, endX);
+        }
+        if (x[i] != y[i]) {
+            return x[i] < y[i] ? -1 : 1;
+        }
+    }
+}
+
+/** Compare two byte arrays, left to right for each byte.
+ * All but the last chunk are full, so the chunks of both byte arrays line up.
+ */
+static inline int compareByteArray(RSONCursor &a, RSONCursor &b)
+{
+    a.ptr++;
+    b.ptr++;
+
+    while (true) {
+        size_t sizeA = a.get();
+        size_t sizeB = b.get();
+        a.require(sizeA);
+        b.require(sizeB);
+
+        if (auto r = memcmp(a.ptr, b.ptr, std::min(sizeA, sizeB))) {
+            return r < 0 ? -1 : 1;
+        }
+        a.ptr += sizeA;
+        b.ptr += sizeB;
+
+        if (sizeA != sizeB) {
+            return compareSign(sizeA, sizeB);
+        } else if (sizeA < 255) {
+            return 0;
+        }
+    }
+}
+
+/** Compare two typed arrays.
+ * By element type, then by the values of the elements left to right. Float
+ * elements sort the same as binary floats, elements with the same value,
+ * such as 0.0 and -0.0, by their bits.
+ */
+static inline int compareTypedArray(RSONCursor &a, RSONCursor &b)
+{
+    size_t countA;
+    size_t countB;
+    auto typeA = decodeTypedArrayHeader(a, countA);
+    auto typeB = decodeTypedArrayHeader(b, countB);
+    if (typeA != typeB) {
+        return compareSign(static_cast<int>(typeA), static_cast<int>(typeB));
+    }
+
+    auto dataA = a.ptr;
+    auto dataB = b.ptr;
+    a.ptr += countA * arrayTypeSize(typeA);
+    b.ptr += countB * arrayTypeSize(typeB);
+
+    return dispatchArrayType(typeA, [&](auto tag) {
+        typedef decltype(tag) E;
+
+        for (size_t i = 0; i < std::min(countA, countB); i++) {
+            E x;
+            E y;
+            memcpy(&x, dataA + i * sizeof (E), sizeof (E));
+            memcpy(&y, dataB + i * sizeof (E), sizeof (E));
+
+            if constexpr (std::is_floating_point<E>::value) {
+                auto nanX = x != x;
+                auto nanY = y != y;
+                if (nanX != nanY) {
+                    return compareSign(nanX, nanY);
+                } else if (!nanX && x != y) {
+                    return x < y ? -1 : 1;
+                } else if (auto r = memcmp(&x, &y, sizeof (E))) {
+                    return r < 0 ? -1 : 1;
+                }
+            } else if (x != y) {
+                return x < y ? -1 : 1;
+            }
+        }
+        return compareSign(countA, countB);
+    });
+}
+
+/** Compare two mark terminated sequences of fields, left to right.
+ * A sequence that is the start of a longer sequence sorts first.
+ */
+static inline int compareSequence(RSONCursor &a, RSONCursor &b, size_t maximumDepth)
+{
+    while (true) {
+        auto endA = a.peek() == MARK_CODE;
+        auto endB = b.peek() == MARK_CODE;
+        if (endA || endB) {
+            a.ptr += endA;
+            b.ptr += endB;
+            return compareSign(endB, endA);
+        }
+        if (auto r = compareField(a, b, maximumDepth)) {
+            return r;
+        }
+    }
+}
+
+/** Compare two dictionaries.
+ * By name, then keys left to right, then values left to right.
+ * A dictionary without a name sorts before a named dictionary.
+ */
+static inline int compareDictionary(RSONCursor &a, RSONCursor &b, size_t maximumDepth)
+{
+    auto namedA = a.get() == NAMED_DICTIONARY_CODE;
+    auto namedB = b.get() == NAMED_DICTIONARY_CODE;
+    if (namedA != namedB) {
+        return namedA ? 1 : -1;
+    }
+    if (namedA) {
+        if (auto r = compareField(a, b, maximumDepth)) {
+            return r;
+        }
+    }
+
+    size_t nrKeys = 0;
+    while (true) {
+        auto endA = a.peek() == MARK_CODE;
+        auto endB = b.peek() == MARK_CODE;
+        if (endA || endB) {
+            if (endA != endB) {
+                return compareSign(endB, endA);
+            }
+            a.ptr++;
+            b.ptr++;
+            break;
+        }
+        if (auto r = compareField(a, b, maximumDepth)) {
+            return r;
+        }
+        nrKeys++;
+    }
+
+    // The keys are equal, so both dictionaries have the same number of values.
+    for (size_t i = 0; i < nrKeys; i++) {
+        if (auto r = compareField(a, b, maximumDepth)) {
+            return r;
+        }
+    }
+    return 0;
+}
+
+/** Compare two encoded fields in canonical RSON sort order.
+ * Fields are compared directly on their encoded bytes, without decoding
+ * them into values. The fields must be valid, see validate().
+ *
+ * @param a Cursor pointing to the first field. When the fields are equal
+ *          both cursors point just after the field on return.
+ * @param b Cursor pointing to the second field.
+ * @param maximumDepth Maximum nesting of lists and dictionaries.
+ * @return -1, 0 or 1 when a sorts before, the same as or after b.
+ */
+static inline int compareField(RSONCursor &a, RSONCursor &b, size_t maximumDepth)
+{
+    auto rankA = canonicalRank(a);
+    auto rankB = canonicalRank(b);
+    if (rankA != rankB) {
+        return compareSign(rankA, rankB);
+    }
+
+    switch (rankA) {
+    case 0:
+    case 1:
+    case 2:
+        a.ptr++;
+        b.ptr++;
+        return 0;
+    case 3: return compareInteger(a, b);
+    case 4: return compareBinaryFloat(a, b);
+    case 5:
+        return compare(decode<DecimalFloat>(a), decode<DecimalFloat>(b));
+    case 6: return compareString(a, b);
+    case 7: return compareByteArray(a, b);
+    case 8:
+        enterContainer(maximumDepth);
+        a.ptr++;
+        b.ptr++;
+        return compareSequence(a, b, maximumDepth - 1);
+    case 9: return compareTypedArray(a, b);
+    default:
+        enterContainer(maximumDepth);
+        return compareDictionary(a, b, maximumDepth - 1);
+    }
+}
+
+/** Compare two encoded messages in canonical RSON sort order.
+ *
+ * @return -1, 0 or 1 when a sorts before, the same as or after b.
+ */
+static inline int compare(const std::string &a, const std::string &b)
+{
+    auto cursorA = RSONCursor(a);
+    auto cursorB = RSONCursor(b);
+    return compareField(cursorA, cursorB);
+}
+
+/** Canonicalize a single field.
+ * The keys of each dictionary are sorted in canonical order, with the values
+ * moved along with their keys. UTF-8 strings are re-encoded, so that strings
+ * which fit the ASCII-string form are written in that form. All other
+ * fields are validated and copied.
+ *
+ * @param s The sink to write the canonical field to.
+ * @param cursor Cursor pointing to the start of the field, on return
+ *               it points just after the field.
+ * @param maximumDepth Maximum nesting of lists and dictionaries.
+ */
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void canonicalize(S &s, RSONCursor &cursor, size_t maximumDepth = RSON_MAXIMUM_DEPTH)
+{
+    auto start = cursor.ptr;
+    auto c = cursor.peek();
+
+    switch (c) {
+    case LIST_CODE:
+        enterContainer(maximumDepth);
+        cursor.ptr++;
+        s += LIST_CODE;
+        while (cursor.peek() != MARK_CODE) {
+            canonicalize(s, cursor, maximumDepth - 1);
+        }
+        cursor.ptr++;
+        s += MARK_CODE;
+        return;
+
+    case NAMED_DICTIONARY_CODE:
+    case DICTIONARY_CODE:
+        enterContainer(maximumDepth);
+        {
+            cursor.ptr++;
+            s += static_cast<char>(c);
+            if (c == NAMED_DICTIONARY_CODE) {
+                auto t = peekType(cursor);
+                if (t != Type::None && t != Type::String) {
+                    BOOST_THROW_EXCEPTION(decode_type_error() << type_info(t));
+                }
+                canonicalize(s, cursor, maximumDepth - 1);
+            }
+
+            auto keys = std::vector<std::string>();
+            while (cursor.peek() != MARK_CODE) {
+                keys.emplace_back();
+                canonicalize(keys.back(), cursor, maximumDepth - 1);
+            }
+            cursor.ptr++;
+
+            auto values = std::vector<std::string>(keys.size());
+            for (auto &value: values) {
+                canonicalize(value, cursor, maximumDepth - 1);
+            }
+
+            auto order = std::vector<size_t>(keys.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&keys](size_t i, size_t j) {
+                return compare(keys[i], keys[j]) < 0;
+            });
+
+            for (size_t i = 0; i < order.size(); i++) {
+                if (i > 0 && compare(keys[order[i - 1]], keys[order[i]]) == 0) {
+                    // Keys must be unique within a dictionary.
+                    BOOST_THROW_EXCEPTION(decode_value_error());
+                }
+                s.append(keys[order[i]].data(), keys[order[i]].size());
+            }
+            s += MARK_CODE;
+            for (auto i: order) {
+                s.append(values[i].data(), values[i].size());
+            }
+        }
+        return;
+
+    case UTF8_STRING_CODE:
+        {
+            cursor.ptr++;
+            auto mark = skipMark(cursor);
+            if (!isUTF8(start + 1, mark)) {
+                BOOST_THROW_EXCEPTION(decode_value_error());
+            }
+            encode(s, std::string(reinterpret_cast<const char *>(start + 1), mark - (start + 1)));
+        }
+        return;
+
+    default:
+        validate(cursor);
+        s.append(reinterpret_cast<const char *>(start), cursor.ptr - start);
+        return;
+    }
+}
+
+/** Canonicalize an encoded message.
+ * Two messages with the same content, but with dictionary keys in a
+ * different order, have the same canonical form.
+ *
+ * @param message A valid encoded message.
+ * @return The canonical message.
+ */
+static inline std::string canonicalize(const std::string &message)
+{
+    auto cursor = RSONCursor(message);
+    auto r = std::string();
+    r.reserve(message.size());
+
+    canonicalize(r, cursor);
+    if (!cursor.empty()) {
+        BOOST_THROW_EXCEPTION(decode_value_error());
+    }
+    return r;
+}
+
+/** A hash of the canonical form of a message.
+ * Messages with the same content have the same hash, which can be used
+ * as the key of a cache or to find duplicate messages.
+ *
+ * @param message A valid encoded message.
+ * @return The SHA512 of the canonical message.
+ */
+static inline BigInt<512> canonicalHash(const std::string &message)
+{
+    return SHA512(canonicalize(message)).finish();
+}
+
+};};
@@ -0,0 +1,186 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "RSONCanonical tests"
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <limits>
+#include <boost/none.hpp>
+#include "RSONEncode.hpp"
+#include "RSONCanonical.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+static string named(const string &name, const string &keysAndValues)
+{
+    return "\x1a" + encode(name) + keysAndValues;
+}
+
+BOOST_AUTO_TEST_CASE(CompareOrder)
+{
+    // Fields in canonical sort order.
+    auto fields = vector<string>{
+        encode(none),
+        encode(false),
+        encode(true),
+        encode(numeric_limits<int64_t>::min()),
+        encode(-1000),
+        encode(-64),
+        encode(-63),
+        encode(-1),
+        encode(0),
+        encode(1),
+        encode(63),
+        encode(64),
+        encode(1000),
+        encode(numeric_limits<int64_t>::max()),
+        encode(numeric_limits<uint64_t>::max()),
+        encode(-numeric_limits<double>::infinity()),
+        encode(-1e300),
+        encode(-1.5),
+        encode(-1e-310),
+        encode(0.0),
+        encode(1e-310),
+        encode(0.75),
+        encode(1.0),
+        encode(1.5),
+        encode(3.0),
+        encode(1e300),
+        encode(numeric_limits<double>::infinity()),
+        encode(numeric_limits<double>::quiet_NaN()),
+        encode(DecimalFloat::infinity(true)),
+        encode(DecimalFloat(-15, -1)),
+        encode(DecimalFloat(0, 0)),
+        encode(DecimalFloat(1, -20)),
+        encode(DecimalFloat(1, 0)),
+        encode(DecimalFloat(25, -1)),
+        encode(DecimalFloat(1, 1)),
+        encode(DecimalFloat::infinity(false)),
+        encode(DecimalFloat::quiet_NaN()),
+        encode(string("")),
+        encode(string("\x01")),
+        encode(string("A")),
+        encode(string("a")),
+        encode(string("a\x01")),
+        encode(string("ab")),
+        encode(string("abc")),
+        encode(string("b")),
+        encode(string("cafe")),
+        encode(string("caf\xc3\xa9")),
+        encode(string("caf\xc3\xa9s")),
+        encode(string("\xe2\x82\xac")),
+        encode(basic_string<uint8_t>()),
+        encode(basic_string<uint8_t>(1, 0)),
+        encode(basic_string<uint8_t>(255, 1)),
+        encode(basic_string<uint8_t>(300, 1)),
+        encode(basic_string<uint8_t>(1, 2)),
+        encode(vector<int>{}),
+        encode(vector<int>{1}),
+        encode(vector<int>{1, 2}),
+        encode(vector<int>{2}),
+        encode(typedArray(vector<int8_t>{-1})),
+        encode(typedArray(vector<int8_t>{2})),
+        encode(typedArray(vector<uint8_t>{})),
+        encode(typedArray(vector<uint8_t>{1, 2})),
+        encode(typedArray(vector<uint8_t>{255})),
+        encode(typedArray(vector<double>{-numeric_limits<double>::infinity()})),
+        encode(typedArray(vector<double>{-1.0})),
+        encode(typedArray(vector<double>{0.0})),
+        encode(typedArray(vector<double>{-0.0})),
+        encode(typedArray(vector<double>{0.5, 1.0})),
+        encode(typedArray(vector<double>{numeric_limits<double>::quiet_NaN()})),
+        encode(map<string, int>{}),
+        encode(map<string, int>{{"a", 1}}),
+        encode(map<string, int>{{"a", 2}}),
+        encode(map<string, int>{{"a", 1}, {"b", 0}}),
+        encode(map<string, int>{{"b", 0}}),
+        named("A", string("\x00", 1)),
+        named("A", "a\x80" + string("\x00", 1) + encode(1)),
+        named("B", string("\x00", 1)),
+    };
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        for (size_t j = 0; j < fields.size(); j++) {
+            auto expected = (i > j) - (i < j);
+            BOOST_CHECK_MESSAGE(compare(fields[i], fields[j]) == expected, "fields " << i << " and " << j);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Canonicalize)
+{
+    auto sorted = encode(map<string, int>{{"a", 2}, {"b", 1}});
+    auto unsorted = "\x14" + encode(string("b")) + encode(string("a")) + string("\x00", 1) + encode(1) + encode(2);
+    BOOST_CHECK(canonicalize(unsorted) == sorted);
+    BOOST_CHECK(canonicalize(sorted) == sorted);
+
+    // Keys of different types, inside a list and a named dictionary.
+    auto heterogeneous = "\x13\x1a" + encode(string("Foo")) +
+        encode(string("x")) + encode(1.5) + encode(5) + encode(none) + string("\x00", 1) +
+        encode(1) + encode(2) + encode(3) + encode(4) + string("\x00", 1);
+    auto expected = "\x13\x1a" + encode(string("Foo")) +
+        encode(none) + encode(5) + encode(1.5) + encode(string("x")) + string("\x00", 1) +
+        encode(4) + encode(3) + encode(2) + encode(1) + string("\x00", 1);
+    BOOST_CHECK(canonicalize(heterogeneous) == expected);
+
+    // The name of a named dictionary is re-encoded like any other string.
+    auto utf8Name = "\x13\x1a\x18" "Foo" + string("\x00", 1) + string("\x00", 1) + string("\x00", 1);
+    BOOST_CHECK(canonicalize(utf8Name) == "\x13\x1a" + encode(string("Foo")) + string("\x00\x00", 2));
+
+    // Nested dictionaries are sorted before their parent is sorted.
+    auto nested = "\x14" + unsorted + encode(vector<int>{2}) + string("\x00", 1) + encode(none) + encode(true);
+    auto nestedExpected = "\x14" + encode(vector<int>{2}) + sorted + string("\x00", 1) + encode(true) + encode(none);
+    BOOST_CHECK(canonicalize(nested) == nestedExpected);
+
+    auto duplicate = "\x14" + encode(string("a")) + encode(string("a")) + string("\x00", 1) + encode(1) + encode(2);
+    BOOST_CHECK_THROW(canonicalize(duplicate), decode_value_error);
+    BOOST_CHECK_THROW(canonicalize(string("\x81\x80", 2)), decode_value_error);
+    BOOST_CHECK_THROW(canonicalize(encode(1) + encode(2)), decode_value_error);
+
+    // Nesting is limited, so that a message of only list codes can not exhaust the stack.
+    auto deep = string(4 * 1024 * 1024, LIST_CODE);
+    BOOST_CHECK_THROW(canonicalize(deep), decode_overflow_error);
+    BOOST_CHECK_THROW(compare(deep, deep), decode_overflow_error);
+}
+
+BOOST_AUTO_TEST_CASE(CanonicalHash)
+{
+    auto sorted = encode(map<string, int>{{"a", 2}, {"b", 1}});
+    auto unsorted = "\x14" + encode(string("b")) + encode(string("a")) + string("\x00", 1) + encode(1) + encode(2);
+    auto other = encode(map<string, int>{{"a", 1}, {"b", 2}});
+
+    BOOST_CHECK_EQUAL(canonicalHash(unsorted), canonicalHash(sorted));
+    BOOST_CHECK(canonicalHash(other) != canonicalHash(sorted));
+    BOOST_CHECK_EQUAL(canonicalHash(sorted), SHA512(sorted).finish());
+
+    // The same string encoded as an UTF-8 string and as an ASCII string.
+    for (auto &value: {string("a"), string("abc")}) {
+        auto utf8 = "\x18" + value + string("\x00", 1);
+        BOOST_CHECK_EQUAL(compare(utf8, encode(value)), 0);
+        BOOST_CHECK_EQUAL(canonicalHash(utf8), canonicalHash(encode(value)));
+        BOOST_CHECK(canonicalize(utf8) == encode(value));
+    }
+    auto utf8Keys = "\x14\x18" "b" + string("\x00", 1) + encode(string("a")) + string("\x00", 1) + encode(1) + encode(2);
+    BOOST_CHECK_EQUAL(canonicalHash(utf8Keys), canonicalHash(sorted));
+    BOOST_CHECK(canonicalize(encode(string("\xe2\x82\xac"))) == encode(string("\xe2\x82\xac")));
+    BOOST_CHECK(canonicalize(encode(string(""))) == encode(string("")));
+}
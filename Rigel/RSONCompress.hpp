@@ -0,0 +1,408 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <immintrin.h>
+#include <boost/exception/all.hpp>
+
+#include "RSONSink.hpp"
+#include "utils.hpp"
+
+namespace Orion {
+namespace Rigel {
+
+struct decompress_error: virtual boost::exception, virtual std::exception {};
+
+/** History of the messages sent over a connection.
+ * Both the compressor and the decompressor keep the same history, so that
+ * a message can refer to byte sequences of earlier messages, such as the
+ * keys of a dictionary that was sent before.
+ */
+class RSONCompressionWindow {
+public:
+    /** Matches are encoded with a 16 bit offset.
+     */
+    static constexpr size_t WINDOW_SIZE = 65535;
+
+    /** Extra bytes allocated after the end, so that copies can overshoot.
+     */
+    static constexpr size_t SLACK = 32;
+
+    inline RSONCompressionWindow(void) :
+        buffer(new uint8_t[2 * WINDOW_SIZE + SLACK]), used(0), allocated(2 * WINDOW_SIZE) {}
+
+    RSONCompressionWindow(const RSONCompressionWindow &other) = delete;
+    RSONCompressionWindow &operator=(const RSONCompressionWindow &other) = delete;
+
+    inline const uint8_t *data(void) const {
+        return buffer.get();
+    }
+
+    inline size_t size(void) const {
+        return used;
+    }
+
+protected:
+    std::unique_ptr<uint8_t[]> buffer;
+    size_t used;
+    size_t allocated;
+
+    /** Drop history older than the window, before a new message is added.
+     * The history is only shifted after it grew by half a window, so that
+     * the cost of the move is spread over many messages. Both sides slide
+     * at the same time, as it only depends on the size of the history.
+     *
+     * @return The number of bytes the history was shifted by.
+     */
+    inline size_t slide(void) {
+        if (used <= WINDOW_SIZE + WINDOW_SIZE / 2) {
+            return 0;
+        }
+
+        auto shift = used - WINDOW_SIZE;
+        memmove(buffer.get(), buffer.get() + shift, WINDOW_SIZE);
+        used = WINDOW_SIZE;
+        return shift;
+    }
+
+    /** Make room for size more bytes, plus the slack.
+     */
+    inline void reserve(size_t size) {
+        if (used + size <= allocated) {
+            return;
+        }
+
+        auto newAllocated = allocated * 2;
+        while (newAllocated < used + size) {
+            newAllocated *= 2;
+        }
+
+        auto newBuffer = std::unique_ptr<uint8_t[]>(new uint8_t[newAllocated + SLACK]);
+        memcpy(newBuffer.get(), buffer.get(), used);
+        buffer = std::move(newBuffer);
+        allocated = newAllocated;
+    }
+};
+
+/** Per-connection LZ77 compressor for RSON messages.
+ *
+ * Each message is compressed as a sequence of literals and matches, in the
+ * same layout as an LZ4 block:
+ *  - A token byte, with the number of literals in the high nibble and the
+ *    match length minus 4 in the low nibble. A nibble of 15 is followed by
+ *    bytes that are added to it, up to and including a byte less than 255.
+ *  - The literals.
+ *  - The offset of the match as a 16 bit little endian integer, which is
+ *    left out for the last sequence of the message.
+ *
+ * Matches may refer to earlier messages on the same connection. RSON sends
+ * the keys of a dictionary before its values, so the keys of messages of the
+ * same type compress into a single match. The messages must be decompressed
+ * in the same order as they were compressed, over a reliable connection.
+ */
+class RSONCompressor: public RSONCompressionWindow {
+public:
+    static constexpr int HASH_BITS = 14;
+    static constexpr size_t MINIMUM_MATCH = 4;
+
+    inline RSONCompressor(void) :
+        RSONCompressionWindow(), table(new uint32_t[1 << HASH_BITS]), bytesIn(0), bytesOut(0)
+    {
+        std::fill(table.get(), table.get() + (1 << HASH_BITS), EMPTY);
+    }
+
+    /** Compress a message.
+     *
+     * @param s The sink to write the compressed message to.
+     * @param message Pointer to the RSON encoded message.
+     * @param size The size of the message.
+     */
+    template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+    inline void compress(S &s, const uint8_t *message, size_t size) {
+        if (auto shift = slide()) {
+            for (size_t i = 0; i < (1 << HASH_BITS); i++) {
+                table[i] = table[i] != EMPTY && table[i] >= shift ? table[i] - static_cast<uint32_t>(shift) : EMPTY;
+            }
+        }
+
+        reserve(size);
+        auto base = buffer.get();
+        auto start = used;
+        memcpy(base + start, message, size);
+        used += size;
+
+        auto end = used;
+        // The last bytes are always literals, so that the 4 byte hash can be read.
+        auto matchEnd = end >= MINIMUM_MATCH ? end - MINIMUM_MATCH : start;
+
+        size_t compressedSize = 0;
+        auto literals = start;
+        auto p = start;
+        while (p < matchEnd) {
+            auto h = hash(base + p);
+            auto candidate = table[h];
+            table[h] = static_cast<uint32_t>(p);
+
+            if (candidate == EMPTY || p - candidate > WINDOW_SIZE || load32(base + candidate) != load32(base + p)) {
+                p++;
+                continue;
+            }
+
+            auto length = MINIMUM_MATCH;
+            while (p + length < end && base[candidate + length] == base[p + length]) {
+                length++;
+            }
+
+            compressedSize += appendSequence(s, base + literals, p - literals, p - candidate, length);
+
+            // Add the positions inside the match, so that later messages can match them.
+            for (auto q = p + 1; q < p + length && q < matchEnd; q++) {
+                table[hash(base + q)] = static_cast<uint32_t>(q);
+            }
+            p += length;
+            literals = p;
+        }
+        compressedSize += appendSequence(s, base + literals, end - literals, 0, 0);
+
+        bytesIn += size;
+        bytesOut += compressedSize;
+    }
+
+    inline std::string compress(const std::string &message) {
+        auto s = std::string();
+        s.reserve(message.size() + message.size() / 255 + 16);
+        compress(s, reinterpret_cast<const uint8_t *>(message.data()), message.size());
+        return s;
+    }
+
+    /** The total size of the messages before compression.
+     */
+    inline uint64_t uncompressedBytes(void) const {
+        return bytesIn;
+    }
+
+    /** The total size of the messages after compression.
+     */
+    inline uint64_t compressedBytes(void) const {
+        return bytesOut;
+    }
+
+    /** The compression ratio of all messages on the connection, uncompressed / compressed.
+     */
+    inline double ratio(void) const {
+        return bytesOut > 0 ? static_cast<double>(bytesIn) / static_cast<double>(bytesOut) : 1.0;
+    }
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    std::unique_ptr<uint32_t[]> table;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+
+    static inline uint32_t load32(const uint8_t *p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof (value));
+        return value;
+    }
+
+    static inline uint32_t hash(const uint8_t *p) {
+        return (load32(p) * 2654435761U) >> (32 - HASH_BITS);
+    }
+
+    /** Append the extension bytes of a length that did not fit in its nibble.
+     */
+    template<typename S>
+    static inline size_t appendLength(S &s, size_t length) {
+        size_t r = 1;
+        for (length -= 15; length >= 255; length -= 255, r++) {
+            s += static_cast<char>(0xff);
+        }
+        s += static_cast<char>(length);
+        return r;
+    }
+
+    /** Append a sequence of literals followed by a match.
+     *
+     * @param matchLength The length of the match, or zero for the last sequence.
+     * @return The number of bytes appended.
+     */
+    template<typename S>
+    static inline size_t appendSequence(S &s, const uint8_t *literals, size_t literalLength, size_t offset, size_t matchLength) {
+        auto matchNibble = matchLength > 0 ? matchLength - MINIMUM_MATCH : 0;
+        s += static_cast<char>((std::min(literalLength, static_cast<size_t>(15)) << 4) | std::min(matchNibble, static_cast<size_t>(15)));
+
+        size_t r = 1 + literalLength;
+        if (literalLength >= 15) {
+            r += appendLength(s, literalLength);
+        }
+        s.append(reinterpret_cast<const char *>(literals), literalLength);
+
+        if (matchLength > 0) {
+            s += static_cast<char>(offset);
+            s += static_cast<char>(offset >> 8);
+            r += 2;
+            if (matchNibble >= 15) {
+                r += appendLength(s, matchNibble);
+            }
+        }
+        return r;
+    }
+};
+
+/** Per-connection decompressor for messages compressed by RSONCompressor.
+ * Matches are copied 16 bytes at a time with SSE loads and stores.
+ *
+ * When decompress() throws, the history no longer matches the compressor
+ * and the connection must be closed.
+ */
+class RSONDecompressor: public RSONCompressionWindow {
+public:
+    /** The maximum length of a single literal run or match.
+     */
+    static constexpr size_t MAXIMUM_LENGTH = 1 << 30;
+
+    /**
+     * @param maximumMessageSize Maximum size of a decompressed message, so
+     *        that a small message can not make the decompressor allocate
+     *        an unbounded amount of memory.
+     */
+    inline RSONDecompressor(size_t maximumMessageSize = 16 * 1024 * 1024) :
+        RSONCompressionWindow(), maximumMessageSize(maximumMessageSize) {}
+
+    /** Decompress a message.
+     * A message larger than the maximum message size throws decompress_error.
+     *
+     * @param data Pointer to the compressed message.
+     * @param size Size of the compressed message.
+     * @return The message, which is valid until the next call to decompress().
+     */
+    inline std::string_view decompress(const uint8_t *data, size_t size) {
+        slide();
+
+        auto start = used;
+        auto p = data;
+        auto end = data + size;
+        while (true) {
+            if (unlikely(p == end)) {
+                BOOST_THROW_EXCEPTION(decompress_error());
+            }
+            auto token = *p++;
+
+            size_t literalLength = token >> 4;
+            if (literalLength == 15) {
+                literalLength += readLength(p, end);
+            }
+            if (unlikely(static_cast<size_t>(end - p) < literalLength)) {
+                BOOST_THROW_EXCEPTION(decompress_error());
+            }
+
+            checkMessageSize(used - start, literalLength);
+            reserve(literalLength);
+            auto dst = buffer.get() + used;
+            if (static_cast<size_t>(end - p) >= literalLength + 16) {
+                copy16(dst, p, literalLength);
+            } else {
+                memcpy(dst, p, literalLength);
+            }
+            used += literalLength;
+            p += literalLength;
+
+            if (p == end) {
+                break;
+            }
+
+            if (unlikely(end - p < 2)) {
+                BOOST_THROW_EXCEPTION(decompress_error());
+            }
+            size_t offset = p[0] | (static_cast<size_t>(p[1]) << 8);
+            p += 2;
+            if (unlikely(offset == 0 || offset > used)) {
+                BOOST_THROW_EXCEPTION(decompress_error());
+            }
+
+            size_t matchLength = token & 0x0f;
+            if (matchLength == 15) {
+                matchLength += readLength(p, end);
+            }
+            matchLength += RSONCompressor::MINIMUM_MATCH;
+
+            checkMessageSize(used - start, matchLength);
+            reserve(matchLength);
+            dst = buffer.get() + used;
+            auto src = dst - offset;
+            if (offset >= 16) {
+                // Each load only reads bytes that were stored before it.
+                copy16(dst, src, matchLength);
+            } else {
+                // Overlapping match, which repeats the last offset bytes.
+                for (size_t i = 0; i < matchLength; i++) {
+                    dst[i] = src[i];
+                }
+            }
+            used += matchLength;
+        }
+
+        return std::string_view(reinterpret_cast<const char *>(buffer.get() + start), used - start);
+    }
+
+    inline std::string decompress(const std::string &message) {
+        return std::string(decompress(reinterpret_cast<const uint8_t *>(message.data()), message.size()));
+    }
+
+private:
+    size_t maximumMessageSize;
+
+    /** Check the size of the message before growing the buffer.
+     *
+     * @param messageSize The size of the message decompressed so far.
+     * @param length The number of bytes about to be added.
+     */
+    inline void checkMessageSize(size_t messageSize, size_t length) const {
+        if (unlikely(length > maximumMessageSize - messageSize)) {
+            BOOST_THROW_EXCEPTION(decompress_error());
+        }
+    }
+
+    /** Copy in blocks of 16 bytes, which may write and read up to 15 bytes too many.
+     */
+    static inline void copy16(uint8_t *dst, const uint8_t *src, size_t size) {
+        for (size_t i = 0; i < size; i += 16) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+        }
+    }
+
+    static inline size_t readLength(const uint8_t *&p, const uint8_t *end) {
+        size_t length = 0;
+        uint8_t c;
+        do {
+            if (unlikely(p == end || length > MAXIMUM_LENGTH)) {
+                BOOST_THROW_EXCEPTION(decompress_error());
+            }
+            c = *p++;
+            length += c;
+        } while (c == 0xff);
+        return length;
+    }
+};
+
+};};
@@ -0,0 +1,120 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "RSONCompress tests"
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include <map>
+#include "RSONEncode.hpp"
+#include "RSONCompress.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+static string randomBytes(uint32_t &state, size_t size, int alphabet)
+{
+    auto r = string();
+    for (size_t i = 0; i < size; i++) {
+        state = state * 1103515245 + 12345;
+        r += static_cast<char>((state >> 16) % alphabet);
+    }
+    return r;
+}
+
+BOOST_AUTO_TEST_CASE(CompressFormat)
+{
+    auto compressor = RSONCompressor();
+
+    BOOST_CHECK(compressor.compress(string()) == string("\x00", 1));
+    BOOST_CHECK(compressor.compress(string("abc")) == string("\x30" "abc", 4));
+
+    // "xyzxyzxyzxyz": 3 literals, then an overlapping match of 9 bytes at offset 3, then nothing.
+    BOOST_CHECK(compressor.compress(string("xyzxyzxyzxyz")) == string("\x35" "xyz" "\x03\x00" "\x00", 7));
+}
+
+BOOST_AUTO_TEST_CASE(RoundTrip)
+{
+    auto compressor = RSONCompressor();
+    auto decompressor = RSONDecompressor();
+    uint32_t state = 1;
+
+    // Literal runs and matches of all lengths, including those that need extension bytes.
+    for (size_t size: {0, 1, 3, 4, 5, 14, 15, 16, 17, 18, 19, 20, 254, 269, 270, 271, 300, 1000, 70000}) {
+        for (int alphabet: {1, 2, 4, 256}) {
+            auto message = randomBytes(state, size, alphabet);
+            auto compressed = compressor.compress(message);
+            BOOST_REQUIRE(decompressor.decompress(compressed) == message);
+        }
+    }
+
+    // More than a window of history.
+    for (int i = 0; i < 100; i++) {
+        auto message = randomBytes(state, 5000, 16) + randomBytes(state, 1000, 256);
+        BOOST_REQUIRE(decompressor.decompress(compressor.compress(message)) == message);
+    }
+    BOOST_CHECK(compressor.size() == decompressor.size());
+    BOOST_CHECK(memcmp(compressor.data(), decompressor.data(), compressor.size()) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(KeysAcrossMessages)
+{
+    auto compressor = RSONCompressor();
+    auto decompressor = RSONDecompressor();
+
+    auto message = [](int i) {
+        return encode(map<string, int>{
+            {"serviceName", i}, {"publicKey", i * 3}, {"listeners", i * 7}, {"hostID", 42}
+        });
+    };
+
+    auto first = compressor.compress(message(1));
+    BOOST_CHECK(decompressor.decompress(first) == message(1));
+    size_t total = message(1).size();
+
+    // The keys of later messages are a single match into the first message.
+    for (int i = 2; i < 100; i++) {
+        auto compressed = compressor.compress(message(i));
+        BOOST_REQUIRE(compressed.size() < message(i).size() / 3);
+        BOOST_REQUIRE(decompressor.decompress(compressed) == message(i));
+        total += message(i).size();
+    }
+
+    BOOST_CHECK(compressor.uncompressedBytes() == total);
+    BOOST_CHECK(compressor.ratio() > 3.0);
+}
+
+BOOST_AUTO_TEST_CASE(Corrupt)
+{
+    auto decompressor = RSONDecompressor();
+
+    BOOST_CHECK_THROW(decompressor.decompress(string()), decompress_error);
+    BOOST_CHECK_THROW(decompressor.decompress(string("\x30" "ab", 3)), decompress_error);
+    BOOST_CHECK_THROW(decompressor.decompress(string("\x10" "a" "\x02\x00", 4)), decompress_error);
+    BOOST_CHECK_THROW(decompressor.decompress(string("\x10" "a" "\x01", 3)), decompress_error);
+    BOOST_CHECK_THROW(decompressor.decompress(string("\xf0\xff\xff", 3)), decompress_error);
+
+    // A short message may not expand beyond the maximum message size.
+    auto bounded = RSONDecompressor(1024);
+    auto bomb = string("\x1f" "a" "\x01\x00", 4) + string(10, '\xff') + string("\x00", 1);
+    BOOST_CHECK_THROW(bounded.decompress(bomb), decompress_error);
+    auto literals = string("\xf0\xff\xff\xff\xff\x0a", 6) + string(1045, 'a');
+    BOOST_CHECK_THROW(RSONDecompressor(1024).decompress(literals), decompress_error);
+    BOOST_CHECK(RSONDecompressor(1024).decompress(string("\x1f" "a" "\x01\x00" "\xff\xff\xff\x00" "\x00", 9)).size() == 1 + 15 + 3 * 255 + 4);
+}
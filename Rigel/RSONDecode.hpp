@@ -16,20 +16,33 @@
  */
 #pragma once
 #include <cstdint>
-#include <ostream>
+#include <cstring>
+#include <cmath>
+#include <istream>
+#include <sstream>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <immintrin.h>
 #include <boost/any.hpp>
 #include <boost/none.hpp>
 #include <boost/exception/all.hpp>
 
 #include "RSON.hpp"
+#include "utils.hpp"
+#include "DecimalFloat.hpp"
+#include "string_utils.hpp"
 
 namespace Orion {
 namespace Rigel {
 
+struct RSONCursor;
+
 // Forward for decoding anything in a list and dictionary.
-static inline boost::any decode(std::istream &stream);
+static inline boost::any decode(std::istream &stream, size_t maximumDepth = RSON_MAXIMUM_DEPTH);
+static inline boost::any decode(RSONCursor &cursor, size_t maximumDepth = RSON_MAXIMUM_DEPTH);
+static inline void skip(RSONCursor &cursor, size_t maximumDepth = RSON_MAXIMUM_DEPTH);
+static inline void validate(RSONCursor &cursor, size_t maximumDepth = RSON_MAXIMUM_DEPTH);
 
 enum class Type {
     EndOfFile,
@@ -41,7 +54,8 @@ enum class Type {
     BinaryFloat,
     ByteArray,
     String,
-    Integer
+    Integer,
+    TypedArray
 };
 
 struct decode_error: virtual boost::exception {};
@@ -49,9 +63,96 @@ struct decode_overflow_error: virtual decode_error, virtual std::exception {};
 struct decode_eof_error: virtual decode_error, virtual std::exception {};
 struct decode_code_error: virtual decode_error, virtual std::exception {};
 struct decode_type_error: virtual decode_error, virtual std::exception {};
+struct decode_value_error: virtual decode_error, virtual std::exception {};
+struct decode_key_error: virtual decode_error, virtual std::exception {};
+struct decode_index_error: virtual decode_error, virtual std::exception {};
 
 typedef boost::error_info<struct tag_code,char> code_info;
 typedef boost::error_info<struct tag_type,Type> type_info;
+typedef boost::error_info<struct tag_key,std::string> key_info;
+typedef boost::error_info<struct tag_index,size_t> index_info;
+
+/** Throw when a container would nest deeper than allowed.
+ *
+ * @param maximumDepth The remaining number of containers that may be entered.
+ */
+static inline void enterContainer(size_t maximumDepth)
+{
+    if (unlikely(maximumDepth == 0)) {
+        BOOST_THROW_EXCEPTION(decode_overflow_error());
+    }
+}
+
+/** Read cursor over a contiguous buffer of RSON encoded data.
+ * Decoding from a cursor advances it past the decoded field, so that
+ * consecutive fields can be decoded from the same buffer without copying.
+ * The buffer must stay alive while the cursor is in use.
+ */
+struct RSONCursor {
+    const uint8_t *ptr;
+    const uint8_t *end;
+
+    inline RSONCursor(const uint8_t *data, size_t size) :
+        ptr(data), end(data + size) {}
+
+    explicit inline RSONCursor(const std::string &str) :
+        RSONCursor(reinterpret_cast<const uint8_t *>(str.data()), str.size()) {}
+
+    RSONCursor(const RSONCursor &other) = default;
+    RSONCursor &operator=(const RSONCursor &other) = default;
+
+    inline size_t remaining(void) const {
+        return end - ptr;
+    }
+
+    inline bool empty(void) const {
+        return ptr == end;
+    }
+
+    /** Check if at least size bytes are available.
+     * Decoders call this once per field, or per chunk, instead of once per byte.
+     */
+    inline void require(size_t size) const {
+        if (unlikely(remaining() < size)) {
+            BOOST_THROW_EXCEPTION(decode_eof_error());
+        }
+    }
+
+    inline uint8_t peek(void) const {
+        require(1);
+        return *ptr;
+    }
+
+    inline uint8_t get(void) {
+        require(1);
+        return *ptr++;
+    }
+};
+
+static inline Type peekType(char c)
+{
+    switch (c) {
+    case NONE_CODE: return Type::None;
+    case TRUE_CODE: return Type::Boolean;
+    case FALSE_CODE: return Type::Boolean;
+    case LIST_CODE: return Type::List;
+    case DICTIONARY_CODE: return Type::Dictionary;
+    case NAMED_DICTIONARY_CODE: return Type::Dictionary;
+    case DECIMAL_FLOAT_CODE: return Type::DecimalFloat;
+    case BINARY_FLOAT_CODE: return Type::BinaryFloat;
+    case BYTE_ARRAY_CODE: return Type::ByteArray;
+    case UTF8_STRING_CODE: return Type::String;
+    case TYPED_ARRAY_CODE: return Type::TypedArray;
+    case MARK_CODE: BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+
+    default:
+        if (c < 0) {
+            return Type::Integer;
+        } else {
+            return Type::String;
+        }
+    }
+}
 
 static inline Type peekType(std::istream &stream)
 {
@@ -59,30 +160,17 @@ static inline Type peekType(std::istream &stream)
 
     if (p == std::char_traits<char>::eof()) {
         return Type::EndOfFile;
-
     } else {
-        auto c = std::char_traits<char>::to_char_type(p);
-        switch (c) {
-        case NONE_CODE: return Type::None;
-        case TRUE_CODE: return Type::Boolean;
-        case FALSE_CODE: return Type::Boolean;
-        case LIST_CODE: return Type::List;
-        case DICTIONARY_CODE: return Type::Dictionary;
-        case DECIMAL_FLOAT_CODE: return Type::DecimalFloat;
-        case BINARY_FLOAT_CODE: return Type::BinaryFloat;
-        case BYTE_ARRAY_CODE: return Type::ByteArray;
-        case UTF8_STRING_CODE: return Type::String;
-        case MARK_CODE: BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
-        case RESERVED1_CODE: BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
-        case RESERVED2_CODE: BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+        return peekType(std::char_traits<char>::to_char_type(p));
+    }
+}
 
-        default:
-            if (c < 0) {
-                return Type::Integer;
-            } else {
-                return Type::String;
-            }
-        }
+static inline Type peekType(const RSONCursor &cursor)
+{
+    if (cursor.empty()) {
+        return Type::EndOfFile;
+    } else {
+        return peekType(static_cast<char>(*cursor.ptr));
     }
 }
 
@@ -114,7 +202,7 @@ static inline void readIntoNoEOF(std::basic_string<uint8_t> &dst, std::istream &
 
     stream.read(reinterpret_cast<char *>(buffer), size);
 
-    if (stream.eofbit) {
+    if (stream.gcount() != size) {
         BOOST_THROW_EXCEPTION(decode_eof_error());
     }
 
@@ -142,7 +230,9 @@ static inline T decode(std::istream &stream)
 
         stop = (c & 0x80) > 0;
         septet = c & 0x7f;
-        value |= septet << bit_offset;
+        if (bit_offset < static_cast<int>(sizeof (value) * 8)) {
+            value |= static_cast<T>(septet) << bit_offset;
+        }
         bit_offset += 7;
     }
 
@@ -266,9 +356,157 @@ static inline T decode(std::istream &stream)
     return boost::none;
 }
 
+/** Check the exponent of a decimal float.
+ * The largest and smallest exponent are the sentinels of infinity and NaN
+ * in DecimalFloat, a finite float with such an exponent does not fit.
+ */
+static inline int32_t checkDecimalExponent(int32_t exponent)
+{
+    if (unlikely(exponent == DecimalFloat::EXPONENT_INF || exponent == DecimalFloat::EXPONENT_NAN)) {
+        BOOST_THROW_EXCEPTION(decode_overflow_error());
+    }
+    return exponent;
+}
+
+/** Build a decimal float from a decoded mantissa and exponent.
+ * Trailing zero digits are stripped from the mantissa here, so that the
+ * exponent is checked against the sentinels after it has been incremented.
+ */
+static inline DecimalFloat decodeDecimalFloat(int64_t mantissa, int32_t exponent)
+{
+    if (mantissa == 0) {
+        return DecimalFloat();
+    }
+    checkDecimalExponent(exponent);
+    while (mantissa % 10 == 0) {
+        if (unlikely(exponent >= DecimalFloat::EXPONENT_INF - 1)) {
+            BOOST_THROW_EXCEPTION(decode_overflow_error());
+        }
+        mantissa /= 10;
+        exponent++;
+    }
+    return DecimalFloat(mantissa, exponent);
+}
+
+template<typename T, typename std::enable_if<std::is_same<DecimalFloat, T>::value, int>::type = 0>
+static inline T decode(std::istream &stream)
+{
+    auto c = getNoEOF(stream);
+
+    if (c != DECIMAL_FLOAT_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    switch (Type t = peekType(stream)) {
+    case Type::None: // NaN
+        decode<boost::none_t>(stream);
+        return DecimalFloat::quiet_NaN();
+
+    case Type::Boolean: // true = -Inf, false = Inf
+        return DecimalFloat::infinity(decode<bool>(stream));
+
+    case Type::Integer: // mantissa
+        {
+            auto mantissa = decode<int64_t>(stream);
+            if (mantissa == 0) {
+                return DecimalFloat();
+            } else {
+                return decodeDecimalFloat(mantissa, decode<int32_t>(stream));
+            }
+        }
+
+    default:
+        BOOST_THROW_EXCEPTION(decode_type_error() << type_info(t));
+    }
+}
+
+/** Assemble an IEEE-754 floating point number from a mantissa and exponent.
+ * The bits of the result are built directly, instead of multiplying with
+ * exp2(). The mantissa is rounded to nearest-even when it does not fit,
+ * which includes denormals, and values beyond the range become infinite.
+ *
+ * @param mantissa The signed mantissa.
+ * @param exponent The binary exponent: value = mantissa * 2^exponent.
+ * @return The floating point number nearest to the value.
+ */
+template<typename T>
+static inline T makeFloatingPoint(int64_t mantissa, int64_t exponent)
+{
+    static_assert(std::numeric_limits<T>::is_iec559, "Can only decode IEEE754 floating point");
+    static_assert(sizeof (T) == 4 || sizeof (T) == 8, "Can only decode single and double precision");
+
+    typedef typename std::conditional<sizeof (T) == 4, uint32_t, uint64_t>::type bits_t;
+
+    const int MANTISSA_WIDTH = std::numeric_limits<T>::digits - 1;
+    const int EXPONENT_WIDTH = sizeof (T) == 4 ? 8 : 11;
+
+    const uint64_t MANTISSA_MASK = (1ULL << MANTISSA_WIDTH) - 1;
+    const int64_t EXPONENT_INF = (1LL << EXPONENT_WIDTH) - 1;
+    const int64_t EXPONENT_BIAS = (1LL << (EXPONENT_WIDTH - 1)) - 1;
+    const int64_t EXPONENT_DENORMAL = 1 - EXPONENT_BIAS - MANTISSA_WIDTH;
+
+    bool sign = mantissa < 0;
+    uint64_t magnitude = sign ? -static_cast<uint64_t>(mantissa) : static_cast<uint64_t>(mantissa);
+
+    bits_t r = 0;
+    if (magnitude != 0) {
+        // Far outside of the range of any floating point type, values become zero or infinite.
+        exponent = std::max(std::min(exponent, static_cast<int64_t>(100000)), static_cast<int64_t>(-100000));
+
+        // The exponent of the least significant bit that fits in the result.
+        int64_t msb = 63 - __builtin_clzll(magnitude) + exponent;
+        int64_t lsb = std::max(msb - MANTISSA_WIDTH, EXPONENT_DENORMAL);
+        int64_t shift = lsb - exponent;
+
+        uint64_t q;
+        if (shift <= 0) {
+            q = magnitude << -shift;
+
+        } else if (shift > 64) {
+            q = 0;
+
+        } else {
+            // Round to nearest, ties to even.
+            auto m = static_cast<unsigned __int128>(magnitude);
+            auto half = static_cast<unsigned __int128>(1) << (shift - 1);
+            auto remainder = m & ((half << 1) - 1);
+            q = static_cast<uint64_t>(m >> shift);
+            if (remainder > half || (remainder == half && (q & 1) == 1)) {
+                q++;
+                if (q == (2ULL << MANTISSA_WIDTH)) {
+                    q >>= 1;
+                    lsb++;
+                }
+            }
+        }
+
+        if (q > MANTISSA_MASK) { // Normal
+            auto biased_exponent = lsb + MANTISSA_WIDTH + EXPONENT_BIAS;
+            if (biased_exponent >= EXPONENT_INF) {
+                r = static_cast<bits_t>(EXPONENT_INF) << MANTISSA_WIDTH;
+            } else {
+                r = (static_cast<bits_t>(biased_exponent) << MANTISSA_WIDTH) | static_cast<bits_t>(q & MANTISSA_MASK);
+            }
+
+        } else { // Denormal or zero
+            r = static_cast<bits_t>(q);
+        }
+    }
+
+    r |= static_cast<bits_t>(sign) << (MANTISSA_WIDTH + EXPONENT_WIDTH);
+
+    T value;
+    memcpy(&value, &r, sizeof (value));
+    return value;
+}
+
 template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
 static inline T decode(std::istream &stream)
 {
+    if (peekNoEOF(stream) == DECIMAL_FLOAT_CODE) {
+        return decode<DecimalFloat>(stream).toBinary<T>();
+    }
+
     auto c = getNoEOF(stream);
 
     if (c != BINARY_FLOAT_CODE) {
@@ -296,7 +534,7 @@ static inline T decode(std::istream &stream)
             } else {
                 auto exponent = decode<int64_t>(stream);
 
-                return static_cast<T>(static_cast<double>(mantissa) * exp2(static_cast<double>(exponent)));
+                return makeFloatingPoint<T>(mantissa, exponent);
             }
         }
 
@@ -306,16 +544,17 @@ static inline T decode(std::istream &stream)
 }
 
 template<typename T, typename std::enable_if<std::is_same<T, std::vector<boost::any>>::value, int>::type = 0>
-static inline T decode(std::istream &stream)
+static inline T decode(std::istream &stream, size_t maximumDepth = RSON_MAXIMUM_DEPTH)
 {
     auto c = getNoEOF(stream);
     if (c != LIST_CODE) {
         BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
     }
+    enterContainer(maximumDepth);
 
     auto r = T();
     while (peekNoEOF(stream) != MARK_CODE) {
-        r.push_back(decode(stream));
+        r.push_back(decode(stream, maximumDepth - 1));
     }
 
     // Read the actual mark symbol, because before this we just peeked at it.
@@ -325,12 +564,17 @@ static inline T decode(std::istream &stream)
 }
 
 template<typename T, typename std::enable_if<std::is_same<T, std::map<std::string, boost::any>>::value, int>::type = 0>
-static inline T decode(std::istream &stream)
+static inline T decode(std::istream &stream, size_t maximumDepth = RSON_MAXIMUM_DEPTH)
 {
     auto c = getNoEOF(stream);
-    if (c != DICTIONARY_CODE) {
+    if (c == NAMED_DICTIONARY_CODE) {
+        // Decode a class-instance as a normal dictionary.
+        enterContainer(maximumDepth);
+        decode(stream, maximumDepth - 1);
+    } else if (c != DICTIONARY_CODE) {
         BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
     }
+    enterContainer(maximumDepth);
 
     // Read all the keys.
     auto keys = std::vector<std::string>();
@@ -344,40 +588,1294 @@ static inline T decode(std::istream &stream)
     // Now get all the values in the same order.
     auto r = T();
     for (auto key : keys) {
-        r[key] = decode(stream);
+        r[key] = decode(stream, maximumDepth - 1);
     }
 
     return r;
 }
 
-static inline boost::any decode(std::istream &stream)
+/** Read the element type of a typed array.
+ */
+template<typename Source>
+static inline ArrayType decodeArrayType(Source &source)
+{
+    auto type = decode<uint8_t>(source);
+    if (type > MAXIMUM_ARRAY_TYPE) {
+        BOOST_THROW_EXCEPTION(decode_value_error());
+    }
+    return static_cast<ArrayType>(type);
+}
+
+/** Decode a typed array into a std::vector of its element type.
+ * The elements are read in blocks, so that a corrupt count does not
+ * allocate more memory than the stream holds.
+ */
+static inline boost::any decodeTypedArray(std::istream &stream)
+{
+    auto c = getNoEOF(stream);
+    if (c != TYPED_ARRAY_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    auto type = decodeArrayType(stream);
+    auto count = decode<uint64_t>(stream);
+    return dispatchArrayType(type, [&](auto tag) -> boost::any {
+        typedef decltype(tag) E;
+        const uint64_t BLOCK_SIZE = 65536 / sizeof (E);
+
+        auto r = std::vector<E>();
+        for (auto remaining = count; remaining > 0;) {
+            auto n = std::min(remaining, BLOCK_SIZE);
+            auto offset = r.size();
+            r.resize(offset + n);
+            stream.read(reinterpret_cast<char *>(r.data() + offset), n * sizeof (E));
+            if (static_cast<uint64_t>(stream.gcount()) != n * sizeof (E)) {
+                BOOST_THROW_EXCEPTION(decode_eof_error());
+            }
+            remaining -= n;
+        }
+        return r;
+    });
+}
+
+static inline boost::any decode(std::istream &stream, size_t maximumDepth)
 {
     switch (auto t = peekType(stream)) {
     case Type::None: return decode<boost::none_t>(stream);
     case Type::Boolean: return decode<bool>(stream);
     case Type::Integer: return decode<int64_t>(stream);
     case Type::BinaryFloat: return decode<double>(stream);
+    case Type::DecimalFloat: return decode<DecimalFloat>(stream);
     case Type::String: return decode<std::string>(stream);
-    case Type::List: return decode<std::vector<boost::any>>(stream);
-    case Type::Dictionary: return decode<std::map<std::string, boost::any>>(stream);
+    case Type::List: return decode<std::vector<boost::any>>(stream, maximumDepth);
+    case Type::Dictionary: return decode<std::map<std::string, boost::any>>(stream, maximumDepth);
+    case Type::TypedArray: return decodeTypedArray(stream);
     default:
         BOOST_THROW_EXCEPTION(decode_type_error() << type_info(t));
     }
 }
 
-template <typename T>
-static inline T decode(const std::string &str)
+/** Decode an integer from a cursor.
+ *
+ * @param CHECKED When false the caller guarantees that the buffer holds
+ *                at least maximumIntegerLength<T>() bytes.
+ */
+template<typename T, bool CHECKED>
+static inline T decodeInteger(RSONCursor &cursor)
+{
+    typedef typename std::make_unsigned<T>::type U;
+    const int WIDTH = sizeof (T) * 8;
+
+    auto p = cursor.ptr;
+    if (CHECKED && p == cursor.end) {
+        BOOST_THROW_EXCEPTION(decode_eof_error());
+    }
+
+    // Extract first 6 bits.
+    uint8_t c = *p++;
+    if ((c & 0x80) == 0) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    bool stop = (c & 0x40) > 0;
+    uint8_t septet = c & 0x3f;
+    int septet_width = 6;
+    U value = septet;
+
+    // Extract next 7 bits one byte at a time.
+    int bit_offset = 6;
+    while (!stop) {
+        if (bit_offset > WIDTH) {
+            BOOST_THROW_EXCEPTION(decode_overflow_error());
+        }
+        if (CHECKED && p == cursor.end) {
+            BOOST_THROW_EXCEPTION(decode_eof_error());
+        }
+
+        c = *p++;
+        stop = (c & 0x80) > 0;
+        septet = c & 0x7f;
+        septet_width = 7;
+        value |= static_cast<U>(static_cast<U>(septet) << bit_offset);
+        bit_offset += 7;
+    }
+    cursor.ptr = p;
+
+    // The most significant bit of the last septet is the sign.
+    bool negative = ((septet >> (septet_width - 1)) & 1) > 0;
+
+    if (bit_offset < WIDTH) {
+        // Sign extend the value.
+        if (negative) {
+            value |= static_cast<U>(~static_cast<U>(0) << bit_offset);
+        }
+
+    } else {
+        // The bits of the last septet that did not fit must be copies of the sign.
+        int fitting_bits = WIDTH - (bit_offset - 7);
+        uint8_t overflowed = septet >> fitting_bits;
+        uint8_t expected = negative ? (0x7f >> fitting_bits) : 0;
+        bool top_bit = ((value >> (WIDTH - 1)) & 1) > 0;
+
+        if (overflowed != expected || (std::is_signed<T>::value && top_bit != negative)) {
+            BOOST_THROW_EXCEPTION(decode_overflow_error());
+        }
+    }
+
+    if (std::is_unsigned<T>::value && negative) {
+        BOOST_THROW_EXCEPTION(decode_overflow_error());
+    }
+
+    return static_cast<T>(value);
+}
+
+/** The maximum number of bytes an integer of type T can be encoded in.
+ */
+template<typename T>
+constexpr size_t maximumIntegerLength(void)
+{
+    return 1 + ((sizeof (T) * 8) - 6) / 7 + 1;
+}
+
+template<typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<bool, T>::value, int>::type = 0>
+static inline T decode(RSONCursor &cursor)
 {
-    auto str_stream = std::stringstream(str);
+    // Hoist the bounds check out of the loop for everything but the tail of the buffer.
+    if (likely(cursor.remaining() >= maximumIntegerLength<T>())) {
+        return decodeInteger<T, false>(cursor);
+    } else {
+        return decodeInteger<T, true>(cursor);
+    }
+}
 
-    return decode<T>(str_stream);
+/** Skip over a stop-bit terminated run of bytes.
+ *
+ * @param cursor Cursor pointing to the first byte of the run, on return
+ *               it points just after the byte with the stop-bit.
+ * @return Pointer to the byte with the stop-bit.
+ */
+static inline const uint8_t *skipStopBit(RSONCursor &cursor)
+{
+    auto p = findHighBit(cursor.ptr, cursor.end);
+    if (p == cursor.end) {
+        BOOST_THROW_EXCEPTION(decode_eof_error());
+    }
+    cursor.ptr = p + 1;
+    return p;
 }
 
-static inline boost::any decode(const std::string &str)
+/** Skip over a mark terminated run of bytes.
+ *
+ * @param cursor Cursor pointing to the first byte of the run, on return
+ *               it points just after the mark.
+ * @return Pointer to the mark.
+ */
+static inline const uint8_t *skipMark(RSONCursor &cursor)
+{
+    // memchr() is already vectorized by the C library.
+    auto p = static_cast<const uint8_t *>(memchr(cursor.ptr, MARK_CODE, cursor.remaining()));
+    if (p == nullptr) {
+        BOOST_THROW_EXCEPTION(decode_eof_error());
+    }
+    cursor.ptr = p + 1;
+    return p;
+}
+
+/** Decode a string into an existing string, reusing its capacity.
+ */
+static inline void decodeInto(RSONCursor &cursor, std::string &r)
+{
+    auto c = cursor.get();
+
+    if (c == UTF8_STRING_CODE) {
+        // nil terminated UTF-8 string.
+        auto start = cursor.ptr;
+        auto mark = skipMark(cursor);
+
+        r.assign(reinterpret_cast<const char *>(start), mark - start);
+
+    } else if (c >= 0x80 || (c >= 0x10 && c <= 0x1a)) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+
+    } else {
+        // stop-bit encoded ASCII string. May be terminated with a nil+stop-bit.
+        // Only the last character has the stop-bit set, so everything before it
+        // is copied as is, with the string allocated once.
+        auto start = cursor.ptr - 1;
+        auto last = skipStopBit(cursor);
+        auto last_char = static_cast<char>(*last & 0x7f);
+        auto size = static_cast<size_t>(last - start);
+
+        r.resize(size + (last_char != 0));
+        memcpy(&r[0], start, size);
+        if (last_char) {
+            r[size] = last_char;
+        }
+    }
+}
+
+template<typename T, typename std::enable_if<std::is_same<std::string, T>::value, int>::type = 0>
+static inline T decode(RSONCursor &cursor)
+{
+    T r;
+    decodeInto(cursor, r);
+    return r;
+}
+
+/** Decode a byte array into an existing byte string, reusing its capacity.
+ */
+static inline void decodeInto(RSONCursor &cursor, std::basic_string<uint8_t> &r)
+{
+    auto c = cursor.get();
+
+    if (c != BYTE_ARRAY_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    r.clear();
+    uint8_t chunk_size;
+    do {
+        chunk_size = cursor.get();
+        cursor.require(chunk_size);
+
+        r.append(cursor.ptr, chunk_size);
+        cursor.ptr += chunk_size;
+
+    } while (chunk_size == 255);
+}
+
+template<typename T, typename std::enable_if<std::is_same<std::basic_string<uint8_t>, T>::value, int>::type = 0>
+static inline T decode(RSONCursor &cursor)
+{
+    T r;
+    decodeInto(cursor, r);
+    return r;
+}
+
+template<typename T, typename std::enable_if<std::is_same<bool, T>::value, int>::type = 0>
+static inline T decode(RSONCursor &cursor)
+{
+    auto c = cursor.get();
+
+    switch (c) {
+    case TRUE_CODE: return true;
+    case FALSE_CODE: return false;
+    default:
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+}
+
+template<typename T, typename std::enable_if<std::is_base_of<boost::none_t, T>::value, int>::type = 0>
+static inline T decode(RSONCursor &cursor)
+{
+    auto c = cursor.get();
+
+    if (c != NONE_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    return boost::none;
+}
+
+template<typename T, typename std::enable_if<std::is_same<DecimalFloat, T>::value, int>::type = 0>
+static inline T decode(RSONCursor &cursor)
+{
+    auto c = cursor.get();
+
+    if (c != DECIMAL_FLOAT_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    switch (Type t = peekType(cursor)) {
+    case Type::None: // NaN
+        cursor.ptr++;
+        return DecimalFloat::quiet_NaN();
+
+    case Type::Boolean: // true = -Inf, false = Inf
+        return DecimalFloat::infinity(decode<bool>(cursor));
+
+    case Type::Integer: // mantissa
+        {
+            auto mantissa = decode<int64_t>(cursor);
+            if (mantissa == 0) {
+                return DecimalFloat();
+            } else {
+                return decodeDecimalFloat(mantissa, decode<int32_t>(cursor));
+            }
+        }
+
+    case Type::EndOfFile:
+        BOOST_THROW_EXCEPTION(decode_eof_error());
+
+    default:
+        BOOST_THROW_EXCEPTION(decode_type_error() << type_info(t));
+    }
+}
+
+template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+static inline T decode(RSONCursor &cursor)
+{
+    if (cursor.peek() == DECIMAL_FLOAT_CODE) {
+        return decode<DecimalFloat>(cursor).toBinary<T>();
+    }
+
+    auto c = cursor.get();
+
+    if (c != BINARY_FLOAT_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    switch (Type t = peekType(cursor)) {
+    case Type::None: // NaN
+        decode<boost::none_t>(cursor);
+        return std::numeric_limits<T>::quiet_NaN();
+
+    case Type::Boolean: // true = -Inf, false = Inf
+        if (decode<bool>(cursor)) {
+            return -std::numeric_limits<T>::infinity();
+        } else {
+            return std::numeric_limits<T>::infinity();
+        }
+
+    case Type::Integer: // mantissa
+        {
+            auto mantissa = decode<int64_t>(cursor);
+            if (mantissa == 0) {
+                return static_cast<T>(0.0);
+
+            } else {
+                auto exponent = decode<int64_t>(cursor);
+
+                return makeFloatingPoint<T>(mantissa, exponent);
+            }
+        }
+
+    case Type::EndOfFile:
+        BOOST_THROW_EXCEPTION(decode_eof_error());
+
+    default:
+        BOOST_THROW_EXCEPTION(decode_type_error() << type_info(t));
+    }
+}
+
+/** Read the header of a typed array.
+ * This checks that all elements are available in the buffer.
+ *
+ * @param cursor Cursor pointing to the typed array, on return it points
+ *               to the first element.
+ * @param count Returns the number of elements.
+ * @return The element type.
+ */
+static inline ArrayType decodeTypedArrayHeader(RSONCursor &cursor, size_t &count)
+{
+    auto c = cursor.get();
+    if (c != TYPED_ARRAY_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    auto type = decodeArrayType(cursor);
+    auto n = decode<uint64_t>(cursor);
+    if (n > cursor.remaining() / arrayTypeSize(type)) {
+        BOOST_THROW_EXCEPTION(decode_eof_error());
+    }
+    count = n;
+    return type;
+}
+
+/** Convert an element of a typed array to another type.
+ * Integers which do not fit the type throw decode_overflow_error. Integers
+ * and floats are not converted into each other, the same as for lists.
+ */
+template<typename V, typename E>
+static inline V convertArrayElement(E value)
+{
+    if constexpr (std::is_floating_point<V>::value != std::is_floating_point<E>::value) {
+        BOOST_THROW_EXCEPTION(decode_type_error() << type_info(Type::TypedArray));
+    } else if constexpr (std::is_integral<V>::value) {
+        auto x = static_cast<__int128_t>(value);
+        if (x < std::numeric_limits<V>::min() || x > std::numeric_limits<V>::max()) {
+            BOOST_THROW_EXCEPTION(decode_overflow_error());
+        }
+        return static_cast<V>(value);
+    } else {
+        return static_cast<V>(value);
+    }
+}
+
+/** Call a function for each element of a typed array.
+ * Integer elements are passed as int64_t and float elements as double,
+ * the same types as the generic decode() returns for the items of a list.
+ *
+ * @param type The element type.
+ * @param data Pointer to the first element.
+ * @param count The number of elements.
+ * @param f Function called with each element.
+ */
+template<typename F>
+static inline void forEachArrayElement(ArrayType type, const uint8_t *data, size_t count, F &&f)
+{
+    dispatchArrayType(type, [&](auto tag) {
+        typedef decltype(tag) E;
+        typedef typename std::conditional<std::is_floating_point<E>::value, double, int64_t>::type I;
+
+        for (size_t i = 0; i < count; i++) {
+            E value;
+            memcpy(&value, data + i * sizeof (E), sizeof (E));
+            f(convertArrayElement<I>(value));
+        }
+    });
+}
+
+/** Decode a typed array, appending its elements to a vector.
+ * When the element type is the item type of the vector the elements are
+ * copied with a single memcpy, otherwise each element is converted.
+ */
+template<typename V>
+static inline void decodeTypedArray(RSONCursor &cursor, std::vector<V> &r)
+{
+    size_t count;
+    auto type = decodeTypedArrayHeader(cursor, count);
+    auto data = cursor.ptr;
+
+    if (type == arrayType<V>()) {
+        auto offset = r.size();
+        r.resize(offset + count);
+        memcpy(r.data() + offset, data, count * sizeof (V));
+    } else {
+        dispatchArrayType(type, [&](auto tag) {
+            typedef decltype(tag) E;
+
+            r.reserve(r.size() + count);
+            for (size_t i = 0; i < count; i++) {
+                E value;
+                memcpy(&value, data + i * sizeof (E), sizeof (E));
+                r.push_back(convertArrayElement<V>(value));
+            }
+        });
+    }
+    cursor.ptr = data + count * arrayTypeSize(type);
+}
+
+template<typename T, typename std::enable_if<std::is_same<T, std::vector<boost::any>>::value, int>::type = 0>
+static inline T decode(RSONCursor &cursor, size_t maximumDepth = RSON_MAXIMUM_DEPTH)
+{
+    auto r = T();
+    if (cursor.peek() == TYPED_ARRAY_CODE) {
+        size_t count;
+        auto type = decodeTypedArrayHeader(cursor, count);
+        r.reserve(count);
+        forEachArrayElement(type, cursor.ptr, count, [&r](auto value) {
+            r.push_back(value);
+        });
+        cursor.ptr += count * arrayTypeSize(type);
+        return r;
+    }
+
+    auto c = cursor.get();
+    if (c != LIST_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+    enterContainer(maximumDepth);
+
+    while (cursor.peek() != MARK_CODE) {
+        r.push_back(decode(cursor, maximumDepth - 1));
+    }
+
+    // Skip over the mark symbol, because before this we just peeked at it.
+    cursor.ptr++;
+
+    return r;
+}
+
+template<typename T> struct is_vector: std::false_type {};
+template<typename T> struct is_vector<std::vector<T>>: std::true_type {};
+
+/** Decode the items of a list of integers using BMI2.
+ * Each integer is extracted from a 16 byte window with pext, after its
+ * length has been found from the stop-bits with a single movemask. Integers
+ * which would not fit the window or the type of the item fall back to the
+ * scalar decoder, so that errors are reported the same way.
+ *
+ * @param cursor Cursor pointing to the first item of the list.
+ * @param r The vector to append the integers to.
+ */
+template<typename T>
+static inline void decodeIntegersBMI2(RSONCursor &cursor, std::vector<T> &r)
+{
+    // The value bits of an integer of n bytes.
+    static const uint64_t VALUE_BITS_LO[10] = {
+        0,
+        0x000000000000003f, 0x0000000000007f3f, 0x00000000007f7f3f, 0x000000007f7f7f3f,
+        0x0000007f7f7f7f3f, 0x00007f7f7f7f7f3f, 0x007f7f7f7f7f7f3f, 0x7f7f7f7f7f7f7f3f,
+        0x7f7f7f7f7f7f7f3f
+    };
+    const int MAXIMUM_FAST_LENGTH = std::min(static_cast<int>(maximumIntegerLength<T>()) - 1, 9);
+
+    while (cursor.remaining() >= 16) {
+        auto p = cursor.ptr;
+        auto c = *p;
+
+        if (unlikely((c & 0x80) == 0)) {
+            // Mark or a non-integer field.
+            return;
+        }
+
+        // Bit 7 of the following bytes is the stop-bit.
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        auto stop_bits = static_cast<uint32_t>(_mm_movemask_epi8(block)) & ~1U;
+        int nr_bytes = (c & 0x40) ? 1 : __builtin_ctz(stop_bits | 0x10000) + 1;
+
+        if (unlikely(nr_bytes > MAXIMUM_FAST_LENGTH)) {
+            r.push_back(decodeInteger<T, false>(cursor));
+            continue;
+        }
+
+        uint64_t lo;
+        memcpy(&lo, p, sizeof (lo));
+        uint64_t value = _pext_u64(lo, VALUE_BITS_LO[nr_bytes]);
+        if (nr_bytes == 9) {
+            value |= static_cast<uint64_t>(p[8] & 0x7f) << 55;
+        }
+
+        // Sign extend.
+        auto unused_bits = 64 - (6 + 7 * (nr_bytes - 1));
+        auto signed_value = static_cast<int64_t>(value << unused_bits) >> unused_bits;
+
+        if (std::is_unsigned<T>::value && signed_value < 0) {
+            BOOST_THROW_EXCEPTION(decode_overflow_error());
+        }
+
+        r.push_back(static_cast<T>(signed_value));
+        cursor.ptr = p + nr_bytes;
+    }
+}
+
+/** Decode the items of a list of binary floats.
+ * The mantissa and exponent integers are decoded without bounds checks and
+ * assembled directly into the floating point number. Special values, decimal
+ * floats and the tail of the buffer fall back to the scalar decoder.
+ *
+ * @param cursor Cursor pointing to the first item of the list.
+ * @param r The vector to append the floats to.
+ */
+template<typename T>
+static inline void decodeFloats(RSONCursor &cursor, std::vector<T> &r)
+{
+    const size_t MAXIMUM_LENGTH = 1 + 2 * maximumIntegerLength<int64_t>();
+
+    while (cursor.remaining() >= MAXIMUM_LENGTH && cursor.ptr[0] == BINARY_FLOAT_CODE && (cursor.ptr[1] & 0x80) > 0) {
+        cursor.ptr++;
+
+        auto mantissa = decodeInteger<int64_t, false>(cursor);
+        if (mantissa == 0) {
+            r.push_back(static_cast<T>(0.0));
+        } else {
+            auto exponent = decodeInteger<int64_t, false>(cursor);
+            r.push_back(makeFloatingPoint<T>(mantissa, exponent));
+        }
+    }
+}
+
+// Vector-decode requires a prototype of schema-decode so it can decode a vector of structs.
+template<typename T, typename std::enable_if<has_rson_schema<T>::value, int>::type = 0>
+static inline T decode(RSONCursor &cursor);
+
+template<typename T, typename std::enable_if<has_rson_schema<T>::value, int>::type = 0>
+static inline void decodeInto(RSONCursor &cursor, T &r);
+
+template<typename K, typename V>
+static inline void decodeInto(RSONCursor &cursor, std::map<K, V> &r);
+
+/** Decode a list into an existing vector.
+ * The capacity of the vector is kept, and items that are containers are
+ * decoded into the items of the previous message. Items beyond the length
+ * of the list are destroyed.
+ */
+template<typename V, typename std::enable_if<!std::is_same<V, boost::any>::value, int>::type = 0>
+static inline void decodeInto(RSONCursor &cursor, std::vector<V> &r)
+{
+    if (cursor.peek() == TYPED_ARRAY_CODE) {
+        if constexpr (isArrayElement<V>()) {
+            r.clear();
+            decodeTypedArray(cursor, r);
+            return;
+        } else {
+            BOOST_THROW_EXCEPTION(decode_type_error() << type_info(Type::TypedArray));
+        }
+    }
+
+    auto c = cursor.get();
+    if (c != LIST_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    if constexpr (std::is_arithmetic<V>::value) {
+        r.clear();
+        while (true) {
+            if constexpr (isBatchInteger<V>()) {
+                decodeIntegersBMI2(cursor, r);
+            } else if constexpr (std::is_floating_point<V>::value) {
+                decodeFloats(cursor, r);
+            }
+
+            if (cursor.peek() == MARK_CODE) {
+                break;
+            }
+            r.push_back(decode<V>(cursor));
+        }
+    } else {
+        size_t n = 0;
+        for (; cursor.peek() != MARK_CODE; n++) {
+            if (n == r.size()) {
+                r.emplace_back();
+            }
+            decodeInto(cursor, r[n]);
+        }
+        r.erase(r.begin() + n, r.end());
+    }
+
+    // Skip over the mark symbol, because before this we just peeked at it.
+    cursor.ptr++;
+}
+
+template<typename T, typename std::enable_if<is_vector<T>::value && !std::is_same<T, std::vector<boost::any>>::value, int>::type = 0>
+static inline T decode(RSONCursor &cursor)
+{
+    auto r = T();
+    decodeInto(cursor, r);
+    return r;
+}
+
+/** Read the code of a dictionary.
+ * The name of a named dictionary is skipped, so that a class-instance can
+ * be read as a normal dictionary.
+ *
+ * @return The code of the field, DICTIONARY_CODE for a named dictionary.
+ */
+static inline uint8_t getDictionaryCode(RSONCursor &cursor)
+{
+    auto c = cursor.get();
+    if (c == NAMED_DICTIONARY_CODE) {
+        skip(cursor);
+        return DICTIONARY_CODE;
+    }
+    return c;
+}
+
+template<typename T, typename std::enable_if<std::is_same<T, std::map<std::string, boost::any>>::value, int>::type = 0>
+static inline T decode(RSONCursor &cursor, size_t maximumDepth = RSON_MAXIMUM_DEPTH)
+{
+    auto c = getDictionaryCode(cursor);
+    if (c != DICTIONARY_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+    enterContainer(maximumDepth);
+
+    // Read all the keys.
+    auto keys = std::vector<std::string>();
+    while (cursor.peek() != MARK_CODE) {
+        keys.push_back(decode<std::string>(cursor));
+    }
+
+    // Skip over the mark symbol, because before this we just peeked at it.
+    cursor.ptr++;
+
+    // Now get all the values in the same order.
+    auto r = T();
+    for (auto &key : keys) {
+        r.emplace_hint(r.end(), std::move(key), decode(cursor, maximumDepth - 1));
+    }
+
+    return r;
+}
+
+/** Nodes of std::map<K, V> which are reused by decodeInto().
+ * A map which is decoded into gives its nodes to the pool, after which
+ * a node is taken from the pool for each key. The key and value of a
+ * recycled node keep their memory, so a map that is decoded from messages
+ * with the same shape does not allocate.
+ *
+ * There is a pool for each type of map and for each thread. A pool keeps
+ * at most maximumFree unused nodes, nodes recycled beyond that are freed;
+ * trim() frees the unused nodes after an unusually large message.
+ */
+template<typename M>
+struct RSONNodePool {
+    typedef typename M::node_type node_type;
+
+    /** Unused nodes, the last node is reused first.
+     */
+    std::vector<node_type> free;
+
+    /** Nodes of the dictionaries being decoded, for nested maps of the same type.
+     */
+    std::vector<node_type> pending;
+
+    /** Maximum number of unused nodes kept in the pool.
+     */
+    size_t maximumFree;
+
+    inline RSONNodePool(size_t maximumFree = 4096) :
+        free(), pending(), maximumFree(maximumFree) {}
+
+    RSONNodePool(const RSONNodePool &other) = delete;
+    RSONNodePool &operator=(const RSONNodePool &other) = delete;
+
+    static inline RSONNodePool &get(void) {
+        static thread_local RSONNodePool pool;
+        return pool;
+    }
+
+    inline node_type allocate(void) {
+        if (free.empty()) {
+            // A node can only be created by a map.
+            M m;
+            m.emplace();
+            return m.extract(m.begin());
+        }
+
+        auto r = std::move(free.back());
+        free.pop_back();
+        return r;
+    }
+
+    /** Give a node to the pool, or free it when the pool is full.
+     */
+    inline void release(node_type &&node) {
+        if (free.size() < maximumFree) {
+            free.push_back(std::move(node));
+        }
+    }
+
+    /** Give the nodes of a map to the pool.
+     * The first node of the map is the first to be reused.
+     */
+    inline void recycle(M &m) {
+        while (!m.empty()) {
+            release(m.extract(std::prev(m.end())));
+        }
+    }
+
+    /** Give the pending nodes from base onward to the pool.
+     * Nodes that were inserted into a map are empty and are dropped.
+     */
+    inline void recyclePending(size_t base) {
+        for (auto i = pending.size(); i > base; i--) {
+            if (!pending[i - 1].empty()) {
+                release(std::move(pending[i - 1]));
+            }
+        }
+        pending.erase(pending.begin() + base, pending.end());
+    }
+
+    /** Free unused nodes.
+     *
+     * @param size Number of unused nodes to keep.
+     */
+    inline void trim(size_t size = 0) {
+        if (free.size() > size) {
+            free.erase(free.begin() + size, free.end());
+            free.shrink_to_fit();
+        }
+    }
+};
+
+/** Decode a dictionary into an existing map.
+ * The nodes of the map are recycled through the RSONNodePool, so that
+ * a map decoded from messages of the same shape does not allocate memory.
+ */
+template<typename K, typename V>
+static inline void decodeInto(RSONCursor &cursor, std::map<K, V> &r)
+{
+    auto &pool = RSONNodePool<std::map<K, V>>::get();
+
+    auto c = getDictionaryCode(cursor);
+    if (c != DICTIONARY_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    pool.recycle(r);
+
+    auto base = pool.pending.size();
+    try {
+        // Read all the keys.
+        while (cursor.peek() != MARK_CODE) {
+            pool.pending.push_back(pool.allocate());
+            decodeInto(cursor, pool.pending.back().key());
+        }
+
+        // Skip over the mark symbol, because before this we just peeked at it.
+        cursor.ptr++;
+
+        // Now get all the values in the same order.
+        auto size = pool.pending.size() - base;
+        for (size_t i = 0; i < size; i++) {
+            decodeInto(cursor, pool.pending[base + i].mapped());
+        }
+
+        // Keys are sorted, a duplicate key keeps the first value.
+        for (size_t i = 0; i < size; i++) {
+            r.insert(r.end(), std::move(pool.pending[base + i]));
+        }
+        pool.recyclePending(base);
+
+    } catch (...) {
+        pool.recyclePending(base);
+        throw;
+    }
+}
+
+/** Decode into an existing value.
+ * Values without memory of their own are assigned.
+ */
+template<typename T, typename std::enable_if<
+    std::is_arithmetic<T>::value ||
+    std::is_same<DecimalFloat, T>::value ||
+    std::is_base_of<boost::none_t, T>::value ||
+    std::is_same<boost::any, T>::value ||
+    std::is_same<std::vector<boost::any>, T>::value,
+    int>::type = 0>
+static inline void decodeInto(RSONCursor &cursor, T &r)
+{
+    if constexpr (std::is_same<boost::any, T>::value) {
+        r = decode(cursor);
+    } else {
+        r = decode<T>(cursor);
+    }
+}
+
+/** Decode a typed array into a std::vector of its element type.
+ */
+static inline boost::any decodeTypedArray(RSONCursor &cursor)
+{
+    auto header = cursor;
+    size_t count;
+    auto type = decodeTypedArrayHeader(header, count);
+
+    return dispatchArrayType(type, [&cursor](auto tag) -> boost::any {
+        return decode<std::vector<decltype(tag)>>(cursor);
+    });
+}
+
+static inline boost::any decode(RSONCursor &cursor, size_t maximumDepth)
+{
+    switch (auto t = peekType(cursor)) {
+    case Type::None: return decode<boost::none_t>(cursor);
+    case Type::Boolean: return decode<bool>(cursor);
+    case Type::Integer: return decode<int64_t>(cursor);
+    case Type::BinaryFloat: return decode<double>(cursor);
+    case Type::DecimalFloat: return decode<DecimalFloat>(cursor);
+    case Type::String: return decode<std::string>(cursor);
+    case Type::List: return decode<std::vector<boost::any>>(cursor, maximumDepth);
+    case Type::Dictionary: return decode<std::map<std::string, boost::any>>(cursor, maximumDepth);
+    case Type::TypedArray: return decodeTypedArray(cursor);
+    case Type::EndOfFile: BOOST_THROW_EXCEPTION(decode_eof_error());
+    default:
+        BOOST_THROW_EXCEPTION(decode_type_error() << type_info(t));
+    }
+}
+
+/** Skip over the chunks of a byte array.
+ * The chunks are skipped by following their length bytes, so the
+ * content of the byte array is never read.
+ *
+ * @param cursor Cursor pointing to the first chunk.
+ */
+static inline void skipChunks(RSONCursor &cursor)
+{
+    auto p = cursor.ptr;
+    uint8_t chunk_size;
+    do {
+        if (unlikely(p == cursor.end)) {
+            BOOST_THROW_EXCEPTION(decode_eof_error());
+        }
+        chunk_size = *p++;
+        if (unlikely(static_cast<size_t>(cursor.end - p) < chunk_size)) {
+            BOOST_THROW_EXCEPTION(decode_eof_error());
+        }
+        p += chunk_size;
+    } while (chunk_size == 255);
+    cursor.ptr = p;
+}
+
+/** Skip over a single field without decoding it.
+ *
+ * @param cursor Cursor pointing to the start of the field, on return
+ *               it points just after the field.
+ * @param maximumDepth Maximum nesting of lists and dictionaries.
+ */
+static inline void skip(RSONCursor &cursor, size_t maximumDepth)
+{
+    auto c = cursor.get();
+
+    switch (c) {
+    case NONE_CODE:
+    case TRUE_CODE:
+    case FALSE_CODE:
+        return;
+
+    case LIST_CODE:
+        enterContainer(maximumDepth);
+        while (cursor.peek() != MARK_CODE) {
+            skip(cursor, maximumDepth - 1);
+        }
+        cursor.ptr++;
+        return;
+
+    case NAMED_DICTIONARY_CODE:
+        // Skip the name, then the rest is the same as a dictionary.
+        enterContainer(maximumDepth);
+        skip(cursor, maximumDepth - 1);
+        // Fall through.
+    case DICTIONARY_CODE:
+        enterContainer(maximumDepth);
+        {
+            size_t nrKeys = 0;
+            while (cursor.peek() != MARK_CODE) {
+                skip(cursor, maximumDepth - 1);
+                nrKeys++;
+            }
+            cursor.ptr++;
+
+            for (size_t i = 0; i < nrKeys; i++) {
+                skip(cursor, maximumDepth - 1);
+            }
+        }
+        return;
+
+    case DECIMAL_FLOAT_CODE:
+    case BINARY_FLOAT_CODE:
+        switch (auto t = peekType(cursor)) {
+        case Type::None:
+        case Type::Boolean:
+            cursor.ptr++;
+            return;
+
+        case Type::Integer:
+            // A zero mantissa is not followed by an exponent.
+            if (*cursor.ptr == 0xc0) {
+                cursor.ptr++;
+            } else {
+                skip(cursor);
+                skip(cursor);
+            }
+            return;
+
+        case Type::EndOfFile:
+            BOOST_THROW_EXCEPTION(decode_eof_error());
+
+        default:
+            BOOST_THROW_EXCEPTION(decode_type_error() << type_info(t));
+        }
+
+    case BYTE_ARRAY_CODE:
+        skipChunks(cursor);
+        return;
+
+    case UTF8_STRING_CODE:
+        skipMark(cursor);
+        return;
+
+    case TYPED_ARRAY_CODE:
+        {
+            cursor.ptr--;
+            size_t count;
+            auto type = decodeTypedArrayHeader(cursor, count);
+            cursor.ptr += count * arrayTypeSize(type);
+        }
+        return;
+
+    case MARK_CODE:
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+
+    default:
+        if (c & 0x80) {
+            // Integer, the first byte has the stop-bit at bit 6.
+            if ((c & 0x40) == 0) {
+                skipStopBit(cursor);
+            }
+        } else {
+            // ASCII string.
+            skipStopBit(cursor);
+        }
+        return;
+    }
+}
+
+/** Validate an integer.
+ * Integers must be encoded in the least amount of bytes.
+ */
+static inline void validateInteger(RSONCursor &cursor)
+{
+    auto start = cursor.ptr;
+    auto c = cursor.get();
+    if ((c & 0x80) == 0) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+    if (c & 0x40) {
+        return;
+    }
+
+    auto last = skipStopBit(cursor);
+
+    // The last septet is redundant when it only contains copies of the
+    // sign-bit of the septet before it.
+    auto last_septet = *last & 0x7f;
+    auto previous_negative = (last - 1 == start) ? (*start & 0x20) > 0 : (*(last - 1) & 0x40) > 0;
+    if ((last_septet == 0x00 && !previous_negative) || (last_septet == 0x7f && previous_negative)) {
+        BOOST_THROW_EXCEPTION(decode_value_error());
+    }
+}
+
+/** Validate a single field and skip over it.
+ * This checks that the field is well formed: that all codes are valid,
+ * containers are terminated, strings only contain allowed characters
+ * and integers and floats are encoded in the least amount of bytes.
+ *
+ * @param cursor Cursor pointing to the start of the field, on return
+ *               it points just after the field.
+ * @param maximumDepth Maximum nesting of lists and dictionaries.
+ */
+static inline void validate(RSONCursor &cursor, size_t maximumDepth)
+{
+    auto start = cursor.ptr;
+    auto c = cursor.get();
+
+    switch (c) {
+    case NONE_CODE:
+    case TRUE_CODE:
+    case FALSE_CODE:
+        return;
+
+    case LIST_CODE:
+        enterContainer(maximumDepth);
+        while (cursor.peek() != MARK_CODE) {
+            validate(cursor, maximumDepth - 1);
+        }
+        cursor.ptr++;
+        return;
+
+    case NAMED_DICTIONARY_CODE:
+        // The name must be none, or a string of at least one character.
+        switch (auto t = peekType(cursor)) {
+        case Type::None:
+            cursor.ptr++;
+            break;
+
+        case Type::String:
+            if (cursor.remaining() >= 2 && cursor.ptr[0] == UTF8_STRING_CODE && cursor.ptr[1] == MARK_CODE) {
+                BOOST_THROW_EXCEPTION(decode_value_error());
+            }
+            validate(cursor, maximumDepth);
+            break;
+
+        case Type::EndOfFile:
+            BOOST_THROW_EXCEPTION(decode_eof_error());
+
+        default:
+            BOOST_THROW_EXCEPTION(decode_type_error() << type_info(t));
+        }
+        // Fall through.
+    case DICTIONARY_CODE:
+        enterContainer(maximumDepth);
+        {
+            size_t nrKeys = 0;
+            while (cursor.peek() != MARK_CODE) {
+                validate(cursor, maximumDepth - 1);
+                nrKeys++;
+            }
+            cursor.ptr++;
+
+            for (size_t i = 0; i < nrKeys; i++) {
+                validate(cursor, maximumDepth - 1);
+            }
+        }
+        return;
+
+    case DECIMAL_FLOAT_CODE:
+    case BINARY_FLOAT_CODE:
+        switch (auto t = peekType(cursor)) {
+        case Type::None:
+        case Type::Boolean:
+            cursor.ptr++;
+            return;
+
+        case Type::Integer:
+            if (*cursor.ptr == 0xc0) {
+                cursor.ptr++;
+            } else {
+                // A binary mantissa must not have trailing zero bits, the
+                // lowest bit of the mantissa is in its first byte.
+                if (c == BINARY_FLOAT_CODE && (*cursor.ptr & 1) == 0) {
+                    BOOST_THROW_EXCEPTION(decode_value_error());
+                }
+                // A decimal mantissa must not have trailing zero digits.
+                if (c == DECIMAL_FLOAT_CODE) {
+                    auto copy = cursor;
+                    if (decode<int64_t>(copy) % 10 == 0) {
+                        BOOST_THROW_EXCEPTION(decode_value_error());
+                    }
+                }
+                validateInteger(cursor);
+                if (c == DECIMAL_FLOAT_CODE) {
+                    auto copy = cursor;
+                    checkDecimalExponent(decode<int32_t>(copy));
+                }
+                validateInteger(cursor);
+            }
+            return;
+
+        case Type::EndOfFile:
+            BOOST_THROW_EXCEPTION(decode_eof_error());
+
+        default:
+            BOOST_THROW_EXCEPTION(decode_type_error() << type_info(t));
+        }
+
+    case BYTE_ARRAY_CODE:
+        skipChunks(cursor);
+        return;
+
+    case UTF8_STRING_CODE:
+        {
+            auto mark = skipMark(cursor);
+            if (!isUTF8(start + 1, mark)) {
+                BOOST_THROW_EXCEPTION(decode_value_error());
+            }
+            // A string that can be encoded as an ASCII string must be.
+            if (mark != start + 1 && isRSONASCII(start + 1, mark)) {
+                BOOST_THROW_EXCEPTION(decode_value_error());
+            }
+        }
+        return;
+
+    case TYPED_ARRAY_CODE:
+        {
+            // The element type and count must be encoded in the least amount of bytes.
+            auto header = cursor;
+            validateInteger(header);
+            validateInteger(header);
+
+            cursor.ptr = start;
+            size_t count;
+            auto type = decodeTypedArrayHeader(cursor, count);
+            cursor.ptr += count * arrayTypeSize(type);
+        }
+        return;
+
+    case MARK_CODE:
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+
+    default:
+        if (c & 0x80) {
+            cursor.ptr = start;
+            validateInteger(cursor);
+
+        } else {
+            auto last = skipStopBit(cursor);
+            auto last_char = *last & 0x7f;
+
+            // Only a single character string may be terminated with a nul.
+            if (!isRSONASCII(start, last) || (last_char == 0 && last != start + 1)) {
+                BOOST_THROW_EXCEPTION(decode_value_error());
+            }
+            if (last_char >= 0x10 && last_char <= 0x1a) {
+                BOOST_THROW_EXCEPTION(decode_value_error());
+            }
+        }
+        return;
+    }
+}
+
+/** The number of bytes of a single field.
+ *
+ * @param data Pointer to the start of the field.
+ * @param size Number of bytes available in the buffer.
+ * @return The length of the field in bytes.
+ */
+static inline size_t fieldLength(const uint8_t *data, size_t size)
+{
+    auto cursor = RSONCursor(data, size);
+    skip(cursor);
+    return cursor.ptr - data;
+}
+
+/** Validate a single field.
+ *
+ * @param data Pointer to the start of the field.
+ * @param size Number of bytes available in the buffer.
+ * @return The length of the field in bytes.
+ */
+static inline size_t validate(const uint8_t *data, size_t size)
+{
+    auto cursor = RSONCursor(data, size);
+    validate(cursor);
+    return cursor.ptr - data;
+}
+
+/** Decode a C++ value from a buffer of RSON data.
+ *
+ * @param data Pointer to the RSON encoded data.
+ * @param size Number of bytes in the buffer.
+ * @return The decoded value.
+ */
+template <typename T>
+static inline T decode(const uint8_t *data, size_t size)
+{
+    auto cursor = RSONCursor(data, size);
+
+    return decode<T>(cursor);
+}
+
+static inline boost::any decode(const uint8_t *data, size_t size)
+{
+    auto cursor = RSONCursor(data, size);
+
+    return decode(cursor);
+}
+
+/** Decode a C++ value from a string of RSON data.
+ * The string is decoded in place, without copying it into a stream.
+ *
+ * @param str String containing the RSON encoded data.
+ * @return The decoded value.
+ */
+template <typename T>
+static inline T decode(const std::string &str)
+{
+    auto cursor = RSONCursor(str);
+
+    return decode<T>(cursor);
+}
+
+static inline boost::any decode(const std::string &str)
+{
+    auto cursor = RSONCursor(str);
+
+    return decode(cursor);
+}
+
+/** Decode a C++ value from a buffer of RSON data into an existing value.
+ * Strings, vectors and maps reuse the memory of the previous value.
+ *
+ * @param data Pointer to the RSON encoded data.
+ * @param size Number of bytes in the buffer.
+ * @param r The value to decode into.
+ */
+template <typename T>
+static inline void decodeInto(const uint8_t *data, size_t size, T &r)
+{
+    auto cursor = RSONCursor(data, size);
+
+    decodeInto(cursor, r);
+}
+
+template <typename T>
+static inline void decodeInto(const std::string &str, T &r)
 {
-    auto str_stream = std::stringstream(str);
+    auto cursor = RSONCursor(str);
 
-    return decode(str_stream);
+    decodeInto(cursor, r);
 }
 
 
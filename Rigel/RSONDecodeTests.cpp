@@ -19,9 +19,12 @@
 #include <boost/test/unit_test.hpp>
 
 #include <string>
+#include <cstring>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 #include <boost/none.hpp>
+#include "RSONEncode.hpp"
 #include "RSONDecode.hpp"
 
 using namespace std;
@@ -77,6 +80,75 @@ BOOST_AUTO_TEST_CASE(DecodeDouble)
     BOOST_CHECK(decode<double>(string("\x16\xd3\xc1", 3)) == 38.0);
 }
 
+BOOST_AUTO_TEST_CASE(DecodeFloatRounding)
+{
+    // Mantissas wider than the type are rounded to nearest, ties to even.
+    BOOST_CHECK(decode<double>("\x16" + encode((static_cast<int64_t>(1) << 53) + 1) + encode(0)) == 9007199254740992.0);
+    BOOST_CHECK(decode<double>("\x16" + encode((static_cast<int64_t>(1) << 53) + 3) + encode(0)) == 9007199254740996.0);
+    BOOST_CHECK(decode<float>("\x16" + encode((static_cast<int64_t>(1) << 24) + 1) + encode(0)) == 16777216.0f);
+    BOOST_CHECK(decode<double>("\x16" + encode(-3) + encode(-1075)) == -2 * numeric_limits<double>::denorm_min());
+    BOOST_CHECK(decode<double>("\x16" + encode(1) + encode(-1075)) == 0.0);
+    BOOST_CHECK(decode<double>("\x16" + encode(3) + encode(-1076)) == numeric_limits<double>::denorm_min());
+
+    // Denormals that round up become the smallest normal number.
+    BOOST_CHECK(decode<double>("\x16" + encode((static_cast<int64_t>(1) << 53) - 1) + encode(-1075)) == numeric_limits<double>::min());
+
+    BOOST_CHECK(decode<double>("\x16" + encode(1) + encode(1024)) == numeric_limits<double>::infinity());
+    BOOST_CHECK(decode<float>("\x16" + encode(-1) + encode(128)) == -numeric_limits<float>::infinity());
+    BOOST_CHECK(decode<double>("\x16" + encode(1) + encode(1023)) == ldexp(1.0, 1023));
+    BOOST_CHECK(decode<double>("\x16" + encode(1) + encode(numeric_limits<int64_t>::min())) == 0.0);
+    BOOST_CHECK(decode<double>("\x16" + encode(-1) + encode(numeric_limits<int64_t>::max())) == -numeric_limits<double>::infinity());
+}
+
+BOOST_AUTO_TEST_CASE(DecodeFloatBitExact)
+{
+    uint64_t state = 0x0123456789abcdefULL;
+    auto random = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+
+    for (int i = 0; i < 100000; i++) {
+        auto bits64 = random();
+        double d;
+        memcpy(&d, &bits64, sizeof (d));
+
+        auto bits32 = static_cast<uint32_t>(bits64 >> 16);
+        float f;
+        memcpy(&f, &bits32, sizeof (f));
+
+        if (d == d) {
+            auto r = decode<double>(encode(d));
+            BOOST_REQUIRE(memcmp(&r, &d, sizeof (d)) == 0);
+        }
+        if (f == f) {
+            auto r = decode<float>(encode(f));
+            BOOST_REQUIRE(memcmp(&r, &f, sizeof (f)) == 0);
+        }
+    }
+
+    BOOST_CHECK(std::signbit(decode<double>(encode(-0.0))) == false);
+    BOOST_CHECK(std::isnan(decode<double>(encode(numeric_limits<double>::quiet_NaN()))));
+}
+
+BOOST_AUTO_TEST_CASE(DecodeFloatVector)
+{
+    auto values = vector<double>{0.0, -1.0, 0.1, 1e300, -1e-310, numeric_limits<double>::infinity(), -numeric_limits<double>::infinity()};
+    for (int i = 0; i < 1000; i++) {
+        values.push_back((i * 1.1 - 500.0) * exp2(i % 60 - 30));
+    }
+    BOOST_CHECK(decode<vector<double>>(encode(values)) == values);
+
+    auto floats = vector<float>{0.0f, -1.0f, 0.1f, 3e38f, numeric_limits<float>::denorm_min()};
+    BOOST_CHECK(decode<vector<float>>(encode(floats)) == floats);
+
+    // Decimal floats inside a list of binary floats.
+    auto mixed = string("\x13", 1) + encode(1.5) + encode(DecimalFloat(25, -1)) + encode(-0.25) + string("\x00", 1);
+    BOOST_CHECK(decode<vector<double>>(mixed) == vector<double>({1.5, 2.5, -0.25}));
+}
+
 BOOST_AUTO_TEST_CASE(DecodeVector)
 {
     {
@@ -115,3 +187,307 @@ BOOST_AUTO_TEST_CASE(DecodeMap)
     }
 }
 
+
+BOOST_AUTO_TEST_CASE(DecodeInt64)
+{
+    BOOST_CHECK(decode<int64_t>(encode(static_cast<int64_t>(0x123456789abcdef0)))  == 0x123456789abcdef0);
+    BOOST_CHECK(decode<int64_t>(encode(static_cast<int64_t>(-0x123456789abcdef0))) == -0x123456789abcdef0);
+    BOOST_CHECK(decode<int64_t>(encode(numeric_limits<int64_t>::max()))            == numeric_limits<int64_t>::max());
+    BOOST_CHECK(decode<int64_t>(encode(numeric_limits<int64_t>::min()))            == numeric_limits<int64_t>::min());
+    BOOST_CHECK(decode<uint64_t>(encode(numeric_limits<uint64_t>::max()))          == numeric_limits<uint64_t>::max());
+    BOOST_CHECK(decode<int32_t>(encode(static_cast<int32_t>(-100000)))             == -100000);
+}
+
+BOOST_AUTO_TEST_CASE(DecodeOverflow)
+{
+    BOOST_CHECK_THROW(decode<int8_t>(string("\x80\x82", 2)), decode_overflow_error);
+    BOOST_CHECK_THROW(decode<int8_t>(string("\xbf\xfd", 2)), decode_overflow_error);
+    BOOST_CHECK_THROW(decode<uint8_t>(string("\xff", 1)), decode_overflow_error);
+    BOOST_CHECK_THROW(decode<int32_t>(encode(static_cast<int64_t>(0x100000000))), decode_overflow_error);
+}
+
+BOOST_AUTO_TEST_CASE(DecodeEndOfFile)
+{
+    BOOST_CHECK_THROW(decode<int8_t>(string("", 0)), decode_eof_error);
+    BOOST_CHECK_THROW(decode<int64_t>(string("\x80\x00", 2)), decode_eof_error);
+    BOOST_CHECK_THROW(decode<string>(string("Hel", 3)), decode_eof_error);
+    BOOST_CHECK_THROW(decode<string>(string("\x18H\xe2\x82\xac", 5)), decode_eof_error);
+    BOOST_CHECK_THROW(decode<basic_string<uint8_t>>(string("\x17\x03\x01\x02", 4)), decode_eof_error);
+    BOOST_CHECK_THROW(decode<vector<any>>(string("\x13" "fo\xef", 4)), decode_eof_error);
+}
+
+BOOST_AUTO_TEST_CASE(DecodeByteArray)
+{
+    BOOST_CHECK(decode<basic_string<uint8_t>>(string("\x17\x00", 2)) == basic_string<uint8_t>());
+    BOOST_CHECK(decode<basic_string<uint8_t>>(string("\x17\x03\x01\x00\x02", 5)) == basic_string<uint8_t>({1, 0, 2}));
+
+    auto large = basic_string<uint8_t>(600, 0x55);
+    BOOST_CHECK(decode<basic_string<uint8_t>>(encode(large)) == large);
+}
+
+BOOST_AUTO_TEST_CASE(DecodeCursor)
+{
+    auto buffer = string("\xc1" "fo\xef" "\x11" "\x16\xc3\xc1", 8);
+    auto cursor = RSONCursor(buffer);
+
+    BOOST_CHECK(peekType(cursor) == Type::Integer);
+    BOOST_CHECK(decode<int>(cursor) == 1);
+    BOOST_CHECK(peekType(cursor) == Type::String);
+    BOOST_CHECK(decode<string>(cursor) == "foo");
+    BOOST_CHECK(decode<bool>(cursor) == true);
+    BOOST_CHECK(decode<double>(cursor) == 6.0);
+    BOOST_CHECK(peekType(cursor) == Type::EndOfFile);
+    BOOST_CHECK(cursor.empty());
+}
+
+BOOST_AUTO_TEST_CASE(DecodeStream)
+{
+    auto buffer = encode(map<string, vector<int64_t>>{{"foo", {1, -1, 1000000}}, {"bar", {}}});
+    auto stream = stringstream(buffer);
+
+    auto fromStream = any_cast<map<string, any>>(decode(stream));
+    auto fromBuffer = any_cast<map<string, any>>(decode(buffer));
+
+    BOOST_CHECK(fromStream.size() == fromBuffer.size());
+    auto streamFoo = any_cast<vector<any>>(fromStream["foo"]);
+    auto bufferFoo = any_cast<vector<any>>(fromBuffer["foo"]);
+    BOOST_CHECK(streamFoo.size() == 3);
+    BOOST_CHECK(bufferFoo.size() == 3);
+    for (size_t i = 0; i < 3; i++) {
+        BOOST_CHECK(any_cast<int64_t>(streamFoo[i]) == any_cast<int64_t>(bufferFoo[i]));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ValidateFields)
+{
+    auto longASCII = string("The quick brown fox jumps over the lazy dog, again and again.");
+    auto longUTF8 = longASCII + "\xe2\x82\xac" + longASCII;
+
+    for (auto &buffer: {
+        encode(static_cast<int64_t>(-1234567890123)), encode(string("H")), encode(string("He")),
+        encode(longASCII), encode(longUTF8), encode(string("")), encode(38.0), encode(0.0),
+        encode(basic_string<uint8_t>(510, 1)), encode(map<string, vector<string>>{{"a", {longASCII}}, {"b", {}}})
+    }) {
+        auto data = reinterpret_cast<const uint8_t *>(buffer.data());
+        BOOST_CHECK(validate(data, buffer.size()) == buffer.size());
+        BOOST_CHECK(fieldLength(data, buffer.size()) == buffer.size());
+    }
+
+    auto invalid = [](const string &buffer) {
+        auto cursor = RSONCursor(buffer);
+        validate(cursor);
+    };
+
+    BOOST_CHECK_THROW(invalid(string("\x80\x80", 2)), decode_value_error);
+    BOOST_CHECK_THROW(invalid(string("\xa0\xff", 2)), decode_value_error);
+    BOOST_CHECK_THROW(invalid(string("H\x12\xe5", 3)), decode_value_error);
+    BOOST_CHECK_THROW(invalid(string("Hel\x80", 4)), decode_value_error);
+    BOOST_CHECK_THROW(invalid(string("\x18\xc0\x80\x00", 4)), decode_value_error);
+    BOOST_CHECK_THROW(invalid(string("\x18\xed\xa0\x80\x00", 5)), decode_value_error);
+    BOOST_CHECK_THROW(invalid(string("\x16\xc2\xc0", 3)), decode_value_error);
+    BOOST_CHECK_THROW(invalid(string("\x00", 1)), decode_code_error);
+    BOOST_CHECK_THROW(invalid(string("\x19", 1)), decode_eof_error);
+    BOOST_CHECK_THROW(invalid(string("\x13\xc1", 2)), decode_eof_error);
+    BOOST_CHECK_THROW(invalid(longASCII), decode_eof_error);
+
+    // A string that fits the ASCII form must not be encoded as UTF-8.
+    BOOST_CHECK_THROW(invalid(string("\x18" "abc\x00", 5)), decode_value_error);
+    BOOST_CHECK_THROW(invalid(string("\x18" "a\x00", 3)), decode_value_error);
+}
+
+BOOST_AUTO_TEST_CASE(ValidateDepth)
+{
+    auto nested = [](size_t depth) {
+        return string(depth, LIST_CODE) + string(depth, MARK_CODE);
+    };
+
+    auto buffer = nested(RSON_MAXIMUM_DEPTH);
+    auto data = reinterpret_cast<const uint8_t *>(buffer.data());
+    BOOST_CHECK_EQUAL(validate(data, buffer.size()), buffer.size());
+    BOOST_CHECK_EQUAL(fieldLength(data, buffer.size()), buffer.size());
+
+    buffer = nested(RSON_MAXIMUM_DEPTH + 1);
+    data = reinterpret_cast<const uint8_t *>(buffer.data());
+    BOOST_CHECK_THROW(validate(data, buffer.size()), decode_overflow_error);
+    BOOST_CHECK_THROW(fieldLength(data, buffer.size()), decode_overflow_error);
+
+    // A message of only list codes must not exhaust the stack.
+    buffer = string(4 * 1024 * 1024, LIST_CODE);
+    data = reinterpret_cast<const uint8_t *>(buffer.data());
+    BOOST_CHECK_THROW(validate(data, buffer.size()), decode_overflow_error);
+    BOOST_CHECK_THROW(fieldLength(data, buffer.size()), decode_overflow_error);
+
+    buffer = nested(3);
+    auto cursor = RSONCursor(buffer);
+    BOOST_CHECK_THROW(skip(cursor, 2), decode_overflow_error);
+
+    // The name of a named dictionary may itself be a named dictionary when skipped.
+    buffer = string(64 * 1024, NAMED_DICTIONARY_CODE);
+    data = reinterpret_cast<const uint8_t *>(buffer.data());
+    BOOST_CHECK_THROW(fieldLength(data, buffer.size()), decode_overflow_error);
+    auto namedCursor = RSONCursor(buffer);
+    BOOST_CHECK_THROW(skip(namedCursor), decode_overflow_error);
+    auto dictionaryCursor = RSONCursor(buffer);
+    BOOST_CHECK_THROW(getDictionaryCode(dictionaryCursor), decode_overflow_error);
+
+    // Decoding into boost::any is bounded the same way.
+    for (auto code: {LIST_CODE, NAMED_DICTIONARY_CODE}) {
+        buffer = string(64 * 1024, code);
+        auto stream = stringstream(buffer);
+        BOOST_CHECK_THROW(decode(buffer), decode_overflow_error);
+        BOOST_CHECK_THROW(decode(stream), decode_overflow_error);
+    }
+    buffer = nested(RSON_MAXIMUM_DEPTH);
+    BOOST_CHECK_NO_THROW(decode(buffer));
+}
+
+BOOST_AUTO_TEST_CASE(FieldLength)
+{
+    auto buffer = encode(vector<int>{1, 2, 3}) + encode(string("trailing"));
+    auto data = reinterpret_cast<const uint8_t *>(buffer.data());
+
+    BOOST_CHECK(fieldLength(data, buffer.size()) == 5);
+    BOOST_CHECK(fieldLength(data + 5, buffer.size() - 5) == 8);
+}
+
+BOOST_AUTO_TEST_CASE(DecodeIntegerVector)
+{
+    auto values = vector<int64_t>{numeric_limits<int64_t>::max(), numeric_limits<int64_t>::min(), 0, -1};
+    for (int i = 0; i < 64; i++) {
+        values.push_back(1LL << i);
+        values.push_back(-(1LL << i));
+        values.push_back((1LL << i) - 1);
+    }
+    BOOST_CHECK(decode<vector<int64_t>>(encode(values)) == values);
+
+    auto unsignedValues = vector<uint32_t>{0, 1, 63, 64, 0x7fffffff, 0x80000000, 0xffffffff};
+    BOOST_CHECK(decode<vector<uint32_t>>(encode(unsignedValues)) == unsignedValues);
+
+    BOOST_CHECK(decode<vector<int8_t>>(string("\x13\x80\xfe\xbf\x81\x00", 6)) == vector<int8_t>({-128, 127}));
+    BOOST_CHECK(decode<vector<string>>(encode(vector<string>{"foo", "bar"})) == vector<string>({"foo", "bar"}));
+
+    // Errors are the same as for the scalar decoder, also inside the batch.
+    auto padding = string(20, '\xc0');
+    BOOST_CHECK_THROW(decode<vector<uint32_t>>("\x13" + padding + "\xff" + padding + string("\x00", 1)), decode_overflow_error);
+    BOOST_CHECK_THROW(decode<vector<int32_t>>("\x13" + padding + encode(static_cast<int64_t>(1) << 40) + padding + string("\x00", 1)), decode_overflow_error);
+    BOOST_CHECK_THROW(decode<vector<int64_t>>("\x13" + padding + "\x11" + padding + string("\x00", 1)), decode_code_error);
+    BOOST_CHECK_THROW(decode<vector<int64_t>>("\x13" + padding), decode_eof_error);
+}
+
+BOOST_AUTO_TEST_CASE(DecodeTypedArray)
+{
+    auto integers = vector<int32_t>();
+    for (int32_t i = 0; i < 1000; i++) {
+        integers.push_back(i * i * 997 - 500000);
+    }
+    auto floats = vector<float>{0.0f, -1.5f, numeric_limits<float>::infinity(), 1e-40f};
+    auto doubles = vector<double>{0.1, -0.0, 1e300};
+
+    BOOST_CHECK(decode<vector<int32_t>>(encode(typedArray(integers))) == integers);
+    BOOST_CHECK(decode<vector<float>>(encode(typedArray(floats))) == floats);
+    BOOST_CHECK(decode<vector<double>>(encode(typedArray(doubles))) == doubles);
+    BOOST_CHECK(decode<vector<uint8_t>>(encode(typedArray(vector<uint8_t>{}))).empty());
+
+    // Other item types are converted.
+    BOOST_CHECK(decode<vector<int64_t>>(encode(typedArray(integers))) == vector<int64_t>(integers.begin(), integers.end()));
+    BOOST_CHECK(decode<vector<double>>(encode(typedArray(floats))) == vector<double>(floats.begin(), floats.end()));
+    BOOST_CHECK(decode<vector<uint8_t>>(encode(typedArray(vector<int64_t>{0, 255}))) == vector<uint8_t>({0, 255}));
+    BOOST_CHECK_THROW(decode<vector<uint8_t>>(encode(typedArray(vector<int64_t>{256}))), decode_overflow_error);
+    BOOST_CHECK_THROW(decode<vector<uint32_t>>(encode(typedArray(vector<int8_t>{-1}))), decode_overflow_error);
+    BOOST_CHECK_THROW(decode<vector<double>>(encode(typedArray(integers))), decode_type_error);
+    BOOST_CHECK_THROW(decode<vector<string>>(encode(typedArray(integers))), decode_type_error);
+
+    // The generic decoder returns a vector of the element type.
+    auto message = encode(typedArray(floats));
+    BOOST_CHECK(peekType(RSONCursor(message)) == Type::TypedArray);
+    BOOST_CHECK(any_cast<vector<float>>(decode(message)) == floats);
+    auto stream = stringstream(message);
+    BOOST_CHECK(any_cast<vector<float>>(decode(stream)) == floats);
+
+    auto items = decode<vector<any>>(message);
+    BOOST_CHECK_EQUAL(items.size(), 4);
+    BOOST_CHECK_EQUAL(any_cast<double>(items[1]), -1.5);
+
+    // Skip, validate and errors.
+    auto buffer = encode(typedArray(integers)) + encode(string("trailing"));
+    auto data = reinterpret_cast<const uint8_t *>(buffer.data());
+    BOOST_CHECK_EQUAL(fieldLength(data, buffer.size()), 4004);
+    BOOST_CHECK_EQUAL(validate(data, buffer.size()), 4004);
+
+    BOOST_CHECK_THROW(decode<vector<int32_t>>(message.substr(0, message.size() - 1)), decode_eof_error);
+    BOOST_CHECK_THROW(fieldLength(data, 4003), decode_eof_error);
+    auto truncatedStream = stringstream(message.substr(0, message.size() - 1));
+    BOOST_CHECK_THROW(decode(truncatedStream), decode_eof_error);
+    BOOST_CHECK_THROW(decode(string("\x19\xca\xc0", 3)), decode_value_error);
+    BOOST_CHECK_THROW(decode(string("\x19\xc4\xbf\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x81", 11)), decode_eof_error);
+    BOOST_CHECK_THROW(validate(reinterpret_cast<const uint8_t *>("\x19\x84\x80\xc0"), 4), decode_value_error);
+}
+
+BOOST_AUTO_TEST_CASE(DecodeInto)
+{
+    auto first = map<string, vector<string>>{{"alpha", {"a long string that is not inlined", "b"}}, {"beta", {}}};
+    auto second = map<string, vector<string>>{{"alpha", {"another long string, not inlined", "c"}}, {"beta", {"d"}}};
+
+    auto r = map<string, vector<string>>();
+    decodeInto(encode(first), r);
+    BOOST_CHECK(r == first);
+
+    // Nodes, strings and vectors are reused by a message of the same shape.
+    auto alphaNode = &*r.find("alpha");
+    auto alphaData = r["alpha"].data();
+    auto stringData = r["alpha"][0].data();
+    decodeInto(encode(second), r);
+    BOOST_CHECK(r == second);
+    BOOST_CHECK(&*r.find("alpha") == alphaNode);
+    BOOST_CHECK(r["alpha"].data() == alphaData);
+    BOOST_CHECK(r["alpha"][0].data() == stringData);
+
+    // Surplus items and keys are removed.
+    auto third = map<string, vector<string>>{{"gamma", {"e"}}};
+    decodeInto(encode(third), r);
+    BOOST_CHECK(r == third);
+
+    // The pool keeps a bounded number of unused nodes, and can be trimmed.
+    auto &pool = RSONNodePool<map<string, vector<string>>>::get();
+    auto large = map<string, vector<string>>();
+    for (size_t i = 0; i < pool.maximumFree + 100; i++) {
+        large[to_string(i)] = {};
+    }
+    decodeInto(encode(large), r);
+    decodeInto(encode(third), r);
+    // The pool was full before a node was taken for the key of third.
+    BOOST_CHECK_EQUAL(pool.free.size(), pool.maximumFree - 1);
+    pool.trim(1);
+    BOOST_CHECK_EQUAL(pool.free.size(), 1);
+    decodeInto(encode(second), r);
+    BOOST_CHECK(r == second);
+
+    auto integers = vector<int32_t>{1, -2, 300};
+    auto v = vector<int32_t>(100, 5);
+    auto vData = v.data();
+    decodeInto(encode(integers), v);
+    BOOST_CHECK(v == integers);
+    BOOST_CHECK(v.data() == vData);
+    decodeInto(encode(typedArray(integers)), v);
+    BOOST_CHECK(v == integers);
+    BOOST_CHECK(v.data() == vData);
+
+    auto bytes = basic_string<uint8_t>(600, 0x55);
+    auto b = basic_string<uint8_t>(1000, 0);
+    auto bData = b.data();
+    decodeInto(encode(bytes), b);
+    BOOST_CHECK(b == bytes);
+    BOOST_CHECK(b.data() == bData);
+
+    // An error leaves the pool consistent.
+    auto truncated = encode(second);
+    truncated.resize(truncated.size() - 2);
+    BOOST_CHECK_THROW(decodeInto(truncated, r), decode_eof_error);
+    decodeInto(encode(first), r);
+    BOOST_CHECK(r == first);
+
+    auto duplicate = "\x14" + encode(string("a")) + encode(string("a")) + string("\x00", 1) + encode(vector<string>{"x"}) + encode(vector<string>{"y"});
+    decodeInto(duplicate, r);
+    BOOST_CHECK_EQUAL(r.size(), 1);
+    BOOST_CHECK(r["a"] == vector<string>{"x"});
+}
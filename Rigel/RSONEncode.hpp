@@ -16,37 +16,39 @@
  */
 #pragma once
 #include <cstdint>
+#include <cstring>
 #include <ostream>
 #include <vector>
 #include <map>
 #include <limits>
 #include <string>
 #include <type_traits>
+#include <immintrin.h>
 #include <boost/none.hpp>
 #include <boost/exception/all.hpp>
 
 #include "RSON.hpp"
 #include "RSONLength.hpp"
+#include "RSONSink.hpp"
+#include "string_utils.hpp"
 
 namespace Orion {
 namespace Rigel {
 
-struct encode_error: virtual boost::exception {};
-struct encode_type_error: virtual encode_error, virtual std::exception {};
-struct encode_value_error: virtual encode_error, virtual std::exception {};
-
-static inline void encode(std::string &s, bool value)
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encode(S &s, bool value)
 {
     s += value ? TRUE_CODE : FALSE_CODE;
 }
 
-static inline void encode(std::string &s, boost::none_t value)
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encode(S &s, boost::none_t value)
 {
     s += NONE_CODE;
 }
 
-template<typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
-static inline void encode(std::string &s, T value)
+template<typename S, typename T, typename std::enable_if<is_rson_sink<S>::value && std::is_integral<T>::value, int>::type = 0>
+static inline void encode(S &s, T value)
 {
     T end_value = value >= 0 ? 0 : -1;
     uint8_t end_top_bit = value >= 0 ? 0 : 1;
@@ -73,11 +75,22 @@ static inline void encode(std::string &s, T value)
     }
 }
 
+/** Split an IEEE-754 floating point number into a mantissa and exponent.
+ * The mantissa is normalized to have no trailing zero bits, using a single
+ * count-trailing-zeros instead of a loop.
+ *
+ * @param value The value to split.
+ * @param exponent The exponent, INT32_MAX for infinite and INT32_MIN for NaN.
+ * @param mantissa The signed mantissa, INT64_MIN for -infinite, INT64_MAX for +infinite.
+ */
 template<typename T>
 static inline void splitFloatingPoint(T value, int32_t &exponent, int64_t &mantissa)
 {
     static_assert(std::numeric_limits<T>::is_iec559, "Can only encode IEEE754 floating point");
     static_assert(std::numeric_limits<T>::radix == 2, "Can only encode IEEE754 floating point");
+    static_assert(sizeof (T) == 4 || sizeof (T) == 8, "Can only encode single and double precision");
+
+    typedef typename std::conditional<sizeof (T) == 4, uint32_t, uint64_t>::type bits_t;
 
     const int MANTISSA_WIDTH = std::numeric_limits<T>::digits - 1;
     const int EXPONENT_WIDTH = sizeof(value) == 4 ? 8 : 11;
@@ -85,173 +98,274 @@ static inline void splitFloatingPoint(T value, int32_t &exponent, int64_t &manti
     const uint64_t MANTISSA_MASK = (1ULL << MANTISSA_WIDTH) - 1;
     const uint64_t EXPONENT_MASK = (1ULL << EXPONENT_WIDTH) - 1;
 
-    const int64_t MANTISSA_INF = 0;
-    const int64_t MANTISSA_IMPLICIT_BIT = 1LL << MANTISSA_WIDTH;
-    const int64_t MANTISSA_SIGNALLING_NAN = 1LL << (MANTISSA_WIDTH - 1);
+    const uint64_t MANTISSA_IMPLICIT_BIT = 1ULL << MANTISSA_WIDTH;
+    const uint64_t MANTISSA_QUIET_NAN = 1ULL << (MANTISSA_WIDTH - 1);
     const int32_t EXPONENT_BIAS = (1L << (EXPONENT_WIDTH - 1)) - 1;
     const int32_t EXPONENT_INF = EXPONENT_MASK;
     const int32_t EXPONENT_DENORMAL = 0;
 
-    uint64_t value_as_int;
-    if (sizeof (value) == 4) {
-        uint32_t tmp;
-        memcpy(&tmp, &value, sizeof (tmp));
-        value_as_int = tmp;
-    } else if (sizeof (value) == 8) {
-        uint64_t tmp;
-        memcpy(&tmp, &value, sizeof (tmp));
-        value_as_int = tmp;
-    } else {
-        BOOST_THROW_EXCEPTION(encode_type_error());
-    }
+    bits_t value_as_int;
+    memcpy(&value_as_int, &value, sizeof (value_as_int));
 
     bool sign = (value_as_int >> (MANTISSA_WIDTH + EXPONENT_WIDTH)) > 0;
-    exponent = (value_as_int >> MANTISSA_WIDTH) & EXPONENT_MASK;
-    mantissa = value_as_int & MANTISSA_MASK;
+    int32_t biased_exponent = (value_as_int >> MANTISSA_WIDTH) & EXPONENT_MASK;
+    uint64_t bits = value_as_int & MANTISSA_MASK;
 
-    if (exponent == EXPONENT_DENORMAL) { // Denormal
-        exponent = EXPONENT_BIAS - MANTISSA_WIDTH - 1;
+    if (biased_exponent == EXPONENT_INF) {
+        if (bits == 0) { // Infinite
+            exponent = INT32_MAX;
+            mantissa = sign ? INT64_MIN : INT64_MAX;
 
-    } else if (exponent == EXPONENT_INF && mantissa == MANTISSA_INF) { // Infinite
-        exponent = INT32_MAX;
-        mantissa = sign ? INT64_MIN : INT64_MAX;
+        } else if ((bits & MANTISSA_QUIET_NAN) == 0) { // Signalling NaN
+            BOOST_THROW_EXCEPTION(encode_value_error());
 
-    } else if (exponent == EXPONENT_INF && (mantissa & MANTISSA_SIGNALLING_NAN) > 0) { // Signalling Nan
-        BOOST_THROW_EXCEPTION(encode_value_error());
+        } else { // Quiet NaN
+            exponent = INT32_MIN;
+            mantissa = 0;
+        }
+        return;
 
-    } else if (exponent == EXPONENT_INF) { // Quiet Nan
-        exponent = INT32_MIN;
+    } else if (biased_exponent == EXPONENT_DENORMAL) {
+        if (bits == 0) { // Zero
+            exponent = 0;
+            mantissa = 0;
+            return;
+        }
+        exponent = 1 - EXPONENT_BIAS - MANTISSA_WIDTH;
 
     } else { // Normal
-        exponent = exponent - EXPONENT_BIAS - MANTISSA_WIDTH;
-        mantissa |= MANTISSA_IMPLICIT_BIT;
+        bits |= MANTISSA_IMPLICIT_BIT;
+        exponent = biased_exponent - EXPONENT_BIAS - MANTISSA_WIDTH;
     }
-}
 
-template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
-static inline void encode(std::string &s, T value)
-{
-    int32_t exponent;
-    int64_t mantissa;
+    // Normalize by dropping trailing zero bits.
+    auto trailing_zeros = __builtin_ctzll(bits);
+    bits >>= trailing_zeros;
+    exponent += trailing_zeros;
 
-    splitFloatingPoint(value, exponent, mantissa);
+    mantissa = sign ? -static_cast<int64_t>(bits) : static_cast<int64_t>(bits);
+}
 
-    s += BINARY_FLOAT_CODE;
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encode(S &s, const DecimalFloat &value)
+{
+    s += DECIMAL_FLOAT_CODE;
 
-    switch (exponent) {
-    case INT32_MIN: // NaN
+    if (value.isNaN()) {
         encode(s, boost::none);
-        break;
-
-    case INT32_MAX: // Infinite
-        encode(s, static_cast<bool>(mantissa == INT64_MIN));
-        break;
-
-    default: // Number
-        if (mantissa == 0) {
-            encode(s, 0);
-
-        } else {
-            // Normalize by dropping trailing zero bits.
-            while ((mantissa & 1) == 0) {
-                mantissa >>= 1;
-                exponent++;
-            }
-            encode(s, mantissa);
-            encode(s, exponent);
-        }
+    } else if (value.isInfinite()) {
+        encode(s, value.mantissa < 0);
+    } else if (value.mantissa == 0) {
+        encode(s, 0);
+    } else {
+        encode(s, value.mantissa);
+        encode(s, value.exponent);
     }
 }
 
-static inline void encode(std::string &s, const std::string &value)
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encode(S &s, const std::string &value)
 {
-    auto start_position = s.length();
-    bool is_ascii = true;
-
-    // Start copying the string-value into the output.
-    // Adjust when the string-value is not ASCII.
-    for (const auto &c : value) {
-        if (c == 0x00) {
-            BOOST_THROW_EXCEPTION(encode_value_error());
-        }
+    auto data = reinterpret_cast<const uint8_t *>(value.data());
+    auto size = value.size();
 
-        s += c;
-        if (is_ascii && (c < 0 || (c >= 0x10 && c <= 0x1a))) {
-            // Since this is not an ASCII string, we insert an UTF8_STRING_CODE.
-            // Which will cause the string to do a memcpy() operation. So start
-            // this early.
-            s.insert(start_position, 1, UTF8_STRING_CODE);
-            is_ascii = false;
-        }
-    }
+    switch (classifyRSONString(data, data + size)) {
+    case RSONStringClass::ContainsNul:
+        BOOST_THROW_EXCEPTION(encode_value_error());
 
-    if (is_ascii) {
-        switch (value.length()) {
-        case 0:
-            // A zero length ASCII string must be encoded as
-            // a UTF-8 string. Which will cause two bytes to
-            // be emited in the stream.
-            s.insert(start_position, 1, UTF8_STRING_CODE);
-            is_ascii = false;
-            break;
-
-        case 1:
+    case RSONStringClass::ASCII:
+        if (size == 1) {
             // A one length ASCII string must be terminated with a nul, with
-            // the stop bit set. Which will cause two bytes to
-            // be emited in the stream.
+            // the stop bit set.
+            s += value[0];
+            s += static_cast<char>(0x80);
+        } else if (size > 1) {
+            // Set the stop-bit on the last character of the ASCII-string.
+            s.append(value.data(), size - 1);
+            s += static_cast<char>(value[size - 1] | 0x80);
+        } else {
+            // A zero length ASCII string must be encoded as a UTF-8 string.
+            s += UTF8_STRING_CODE;
             s += MARK_CODE;
-            break;
-
-        default:
-            break;
         }
-    }
+        break;
 
-    if (is_ascii) {
-        // Set the stop-bit on the last character of the ASCII-string.
-        s.back() |= 0x80;
-    } else {
-        // Terminate the utf-8 string with nul.
+    case RSONStringClass::UTF8:
+        s += UTF8_STRING_CODE;
+        s.append(value.data(), size);
         s += MARK_CODE;
+        break;
     }
 }
 
-static inline void encode(std::string &s, const std::basic_string<uint8_t> &value)
+template<typename S, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encode(S &s, const std::basic_string<uint8_t> &value)
 {
     s += BYTE_ARRAY_CODE;
 
     size_t nr_full_chunks = value.length() / 255;
     size_t last_chunk_size = value.length() % 255;
 
-    // Copy chunks of 255 bytes length.
+    // Chunks of 255 bytes length, which a sink may reference instead of copy.
     for (size_t chunk = 0; chunk < nr_full_chunks; chunk++) {
         s += static_cast<char>(0xff);
-        s.append(reinterpret_cast<const char *>(&value.data()[chunk * 255]), 255);
+        appendReference(s, &value.data()[chunk * 255], 255);
     }
 
     // Last chunk, with length less than 255, including zero.
     s += static_cast<char>(last_chunk_size);
-    s.append(reinterpret_cast<const char *>(&value.data()[value.length() - last_chunk_size]), last_chunk_size);
+    appendReference(s, &value.data()[value.length() - last_chunk_size], last_chunk_size);
 }
 
 // Vector-encode requires a prototype of map-encode so it can encode a vector of maps.
-template<typename U, typename V>
-static inline void encode(std::string &s, const std::map<U, V> &container);
+template<typename S, typename U, typename V, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encode(S &s, const std::map<U, V> &container);
+
+// Vector-encode requires a prototype of schema-encode so it can encode a vector of structs.
+template<typename S, typename T, typename std::enable_if<is_rson_sink<S>::value && has_rson_schema<T>::value, int>::type = 0>
+static inline void encode(S &s, const T &value);
 
+/** Encode an integer into a buffer using BMI2.
+ * The integer is spread over septets with a single pdep instruction for
+ * the first 8 bytes and one for the last 2 bytes, the length is calculated
+ * from the number of leading sign-bits.
+ *
+ * @param p Pointer to the buffer, which must have room for 16 bytes.
+ *          On return points beyond the encoded integer.
+ * @param value The value to encode.
+ */
+static inline void encodeIntegerBMI2(uint8_t *&p, int64_t value)
+{
+    // The stop-bits for an integer of n bytes.
+    static const uint64_t STOP_BITS_LO[11] = {
+        0,
+        0x00000000000000c0, 0x0000000000008080, 0x0000000000800080, 0x0000000080000080,
+        0x0000008000000080, 0x0000800000000080, 0x0080000000000080, 0x8000000000000080,
+        0x0000000000000080, 0x0000000000000080
+    };
+    static const uint64_t STOP_BITS_HI[11] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0x0080, 0x8000
+    };
+
+    auto nr_bytes = exactLengthInteger(value);
+
+    uint64_t lo = _pdep_u64(static_cast<uint64_t>(value), 0x7f7f7f7f7f7f7f3f);
+    uint64_t hi = _pdep_u64(static_cast<uint64_t>(value >> 55), 0x7f7f);
+    lo |= STOP_BITS_LO[nr_bytes];
+    hi |= STOP_BITS_HI[nr_bytes];
+
+    memcpy(p, &lo, sizeof (lo));
+    memcpy(p + 8, &hi, sizeof (hi));
+    p += nr_bytes;
+}
+
+/** Encode a binary float into a buffer using BMI2.
+ *
+ * @param p Pointer to the buffer, which must have room for 48 bytes.
+ *          On return points beyond the encoded float.
+ * @param value The value to encode.
+ */
 template<typename T>
-static inline void encode(std::string &s, const std::vector<T> &container)
+static inline void encodeFloatingPointBMI2(uint8_t *&p, T value)
 {
-    s += LIST_CODE;
+    int32_t exponent;
+    int64_t mantissa;
 
-    for (auto const &item: container) {
-        encode(s, item);
+    splitFloatingPoint(value, exponent, mantissa);
+
+    *p++ = BINARY_FLOAT_CODE;
+
+    switch (exponent) {
+    case INT32_MIN: // NaN
+        *p++ = NONE_CODE;
+        break;
+
+    case INT32_MAX: // Infinite
+        *p++ = mantissa == INT64_MIN ? TRUE_CODE : FALSE_CODE;
+        break;
+
+    default: // Number
+        encodeIntegerBMI2(p, mantissa);
+        if (mantissa != 0) {
+            encodeIntegerBMI2(p, exponent);
+        }
     }
+}
 
-    s += MARK_CODE;
+template<typename S, typename T, typename std::enable_if<is_rson_sink<S>::value && std::is_floating_point<T>::value, int>::type = 0>
+static inline void encode(S &s, T value)
+{
+    uint8_t buffer[48];
+    auto p = buffer;
+
+    encodeFloatingPointBMI2(p, value);
+    s.append(reinterpret_cast<const char *>(buffer), p - buffer);
+}
+
+template<typename S, typename T, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encode(S &s, const std::vector<T> &container)
+{
+    if constexpr (isBatchInteger<T>()) {
+        // Encode into a small buffer first, this leaves room for the 16 byte
+        // stores without growing the string beyond its exact length.
+        uint8_t buffer[256];
+        auto p = buffer;
+
+        s += LIST_CODE;
+        for (auto const &item: container) {
+            if (p - buffer > static_cast<ptrdiff_t>(sizeof (buffer) - 16)) {
+                s.append(reinterpret_cast<const char *>(buffer), p - buffer);
+                p = buffer;
+            }
+            encodeIntegerBMI2(p, static_cast<int64_t>(item));
+        }
+        s.append(reinterpret_cast<const char *>(buffer), p - buffer);
+        s += MARK_CODE;
+
+    } else if constexpr (std::is_floating_point<T>::value) {
+        uint8_t buffer[256];
+        auto p = buffer;
+
+        s += LIST_CODE;
+        for (auto const &item: container) {
+            if (p - buffer > static_cast<ptrdiff_t>(sizeof (buffer) - 48)) {
+                s.append(reinterpret_cast<const char *>(buffer), p - buffer);
+                p = buffer;
+            }
+            encodeFloatingPointBMI2(p, item);
+        }
+        s.append(reinterpret_cast<const char *>(buffer), p - buffer);
+        s += MARK_CODE;
+
+    } else {
+        s += LIST_CODE;
+
+        for (auto const &item: container) {
+            encode(s, item);
+        }
+
+        s += MARK_CODE;
+    }
+}
+
+/** Encode a typed array.
+ * The code is followed by the element type and the number of elements,
+ * then by the elements as a little endian array, which is passed to the
+ * sink without encoding each element.
+ */
+template<typename S, typename T, typename std::enable_if<is_rson_sink<S>::value, int>::type = 0>
+static inline void encode(S &s, const RSONTypedArray<T> &value)
+{
+    static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The elements of a typed array are copied as little endian");
+
+    s += TYPED_ARRAY_CODE;
+    encode(s, static_cast<uint8_t>(arrayType<T>()));
+    encode(s, static_cast<uint64_t>(value.size));
+    appendReference(s, reinterpret_cast<const uint8_t *>(value.data), value.size * sizeof (T));
 }
 
-template<typename U, typename V>
-static inline void encode(std::string &s, const std::map<U, V> &container)
+template<typename S, typename U, typename V, typename std::enable_if<is_rson_sink<S>::value, int>::type>
+static inline void encode(S &s, const std::map<U, V> &container)
 {
     s += DICTIONARY_CODE;
 
@@ -268,9 +382,10 @@ static inline void encode(std::string &s, const std::map<U, V> &container)
 }
 
 /** Encode a C++ value into RSON.
- * This function will reserve space in the string for the whole value to be
- * encoded. This should improve encoding performance by elmintating multiple
- * memory allocations during appending to the string.
+ * This function will reserve space in the string for exactly the whole value
+ * to be encoded. This should improve encoding performance by elmintating
+ * multiple memory allocations during appending to the string, without
+ * allocating more memory than is needed.
  *
  * The returned string may contain nul-characters.
  *
@@ -282,13 +397,15 @@ static inline std::string encode(const T &value)
 {
     std::string s;
 
-    s.reserve(length(value));
+    s.reserve(exactLength(value));
     encode(s, value);
 
     return s;
 }
 
 /** Encode a C++ value into RSON and send it to a stream.
+ * The value is completely encoded before it is written, so nothing is
+ * written to the stream when encoding fails.
  *
  * @param stream The stream to write the RSON encoded value to.
  * @param value The value to be encoded to RSON.
@@ -81,6 +81,35 @@ BOOST_AUTO_TEST_CASE(EncodeDouble)
     BOOST_CHECK(encode(static_cast<double>(38.0)) == string("\x16\xd3\xc1", 3));
 }
 
+BOOST_AUTO_TEST_CASE(EncodeFloatSpecial)
+{
+    BOOST_CHECK(encode(static_cast<double>(-1.0)) == string("\x16\xff\xc0", 3));
+    BOOST_CHECK(encode(static_cast<float>(-0.5)) == string("\x16\xff\xff", 3));
+    BOOST_CHECK(encode(static_cast<double>(-6.0)) == string("\x16\xfd\xc1", 3));
+    BOOST_CHECK(encode(numeric_limits<double>::denorm_min()) == "\x16\xc1" + encode(-1074));
+    BOOST_CHECK(encode(numeric_limits<float>::denorm_min()) == "\x16\xc1" + encode(-149));
+    BOOST_CHECK(encode(numeric_limits<double>::quiet_NaN()) == string("\x16\x10", 2));
+    BOOST_CHECK(encode(numeric_limits<double>::infinity()) == string("\x16\x12", 2));
+    BOOST_CHECK(encode(-numeric_limits<float>::infinity()) == string("\x16\x11", 2));
+    BOOST_CHECK_THROW(encode(numeric_limits<double>::signaling_NaN()), encode_value_error);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeFloatVector)
+{
+    auto values = vector<double>{0.0, -1.0, 0.1, 1e300, -1e-310, numeric_limits<double>::infinity(), numeric_limits<double>::quiet_NaN()};
+    for (int i = 0; i < 100; i++) {
+        values.push_back(i * 1.1 - 50.0);
+    }
+
+    auto expected = string("\x13", 1);
+    for (auto value: values) {
+        expected += encode(value);
+    }
+    expected += string("\x00", 1);
+    BOOST_CHECK(encode(values) == expected);
+    BOOST_CHECK_EQUAL(exactLength(values), expected.size());
+}
+
 BOOST_AUTO_TEST_CASE(EncodeBoolean)
 {
     BOOST_CHECK(encode(none) == string("\x10", 1));
@@ -100,3 +129,98 @@ BOOST_AUTO_TEST_CASE(EncodeMap)
 }
 
 
+BOOST_AUTO_TEST_CASE(EncodeLongString)
+{
+    auto ascii = string("The quick brown fox jumps over the lazy dog, again and again.");
+
+    BOOST_CHECK(encode(ascii) == ascii.substr(0, ascii.size() - 1) + "\xae");
+    BOOST_CHECK(encode(ascii + "\xe2\x82\xac") == "\x18" + ascii + "\xe2\x82\xac" + string("\x00", 1));
+    BOOST_CHECK(encode(ascii + "\x15" + ascii) == "\x18" + ascii + "\x15" + ascii + string("\x00", 1));
+    BOOST_CHECK_THROW(encode(ascii + string("\x00", 1) + ascii), encode_value_error);
+    BOOST_CHECK_THROW(encode(ascii + ascii + string("\x00", 1)), encode_value_error);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeIntegerVector)
+{
+    // The batched encoder must be bit-exact with the scalar encoder.
+    auto values = vector<int64_t>{
+        0, 1, -1, 31, -32, 63, -64, 127, -128, 8191, -8192, 8192,
+        numeric_limits<int32_t>::max(), numeric_limits<int32_t>::min(),
+        numeric_limits<int64_t>::max(), numeric_limits<int64_t>::min(),
+        (1LL << 55) - 1, -(1LL << 55), 1LL << 55, 1LL << 61, -(1LL << 61) - 1
+    };
+    for (int i = 0; i < 64; i++) {
+        values.push_back(1LL << i);
+        values.push_back(-(1LL << i));
+        values.push_back((1LL << i) - 1);
+    }
+
+    auto expected = string("\x13");
+    for (auto value: values) {
+        encode(expected, value);
+    }
+    expected += string("\x00", 1);
+    BOOST_CHECK(encode(values) == expected);
+
+    auto unsignedValues = vector<uint32_t>{0, 1, 63, 64, 0x7fffffff, 0x80000000, 0xffffffff};
+    auto unsignedExpected = string("\x13");
+    for (auto value: unsignedValues) {
+        encode(unsignedExpected, value);
+    }
+    unsignedExpected += string("\x00", 1);
+    BOOST_CHECK(encode(unsignedValues) == unsignedExpected);
+}
+
+
+BOOST_AUTO_TEST_CASE(EncodeExactLength)
+{
+    for (int i = 0; i < 64; i++) {
+        for (auto value: {1LL << i, -(1LL << i), (1LL << i) - 1, -(1LL << i) - 1}) {
+            BOOST_CHECK_EQUAL(exactLength(static_cast<int64_t>(value)), encode(static_cast<int64_t>(value)).size());
+            BOOST_CHECK_EQUAL(exactLength(static_cast<int32_t>(value)), encode(static_cast<int32_t>(value)).size());
+            BOOST_CHECK_EQUAL(exactLength(static_cast<uint64_t>(value)), encode(static_cast<uint64_t>(value)).size());
+            BOOST_CHECK_EQUAL(exactLength(static_cast<uint16_t>(value)), encode(static_cast<uint16_t>(value)).size());
+        }
+    }
+
+    for (auto value: {0.0, 1.0, 0.1, 3.0, -2.5, -0.1, 1e300, 1e-300, 4e-320, -numeric_limits<double>::infinity(), numeric_limits<double>::quiet_NaN()}) {
+        BOOST_CHECK_EQUAL(exactLength(value), encode(value).size());
+        BOOST_CHECK_EQUAL(exactLength(static_cast<float>(value)), encode(static_cast<float>(value)).size());
+    }
+
+    for (auto value: {string(""), string("a"), string("ab"), string("caf\xc3\xa9"), string(300, 'x')}) {
+        BOOST_CHECK_EQUAL(exactLength(value), encode(value).size());
+    }
+
+    for (size_t size: {0, 1, 254, 255, 256, 510, 1000}) {
+        auto value = basic_string<uint8_t>(size, 0x55);
+        BOOST_CHECK_EQUAL(exactLength(value), encode(value).size());
+    }
+
+    auto integers = vector<int64_t>();
+    for (int64_t i = 0; i < 1000; i++) {
+        integers.push_back(i * i * i - 500000);
+    }
+    BOOST_CHECK_EQUAL(exactLength(integers), encode(integers).size());
+
+    auto strings = vector<string>{"hello", "w", "", "\xe2\x82\xac"};
+    BOOST_CHECK_EQUAL(exactLength(strings), encode(strings).size());
+
+    auto dictionary = map<string, vector<int32_t>>{{"a", {1, 2, 3}}, {"bcd", {}}, {"\xc3\xa9", {-100000}}};
+    BOOST_CHECK_EQUAL(exactLength(dictionary), encode(dictionary).size());
+}
+
+BOOST_AUTO_TEST_CASE(EncodeTypedArray)
+{
+    auto values = vector<int16_t>{1, -2, 0x1234};
+    BOOST_CHECK(encode(typedArray(values)) == string("\x19\xc2\xc3\x01\x00\xfe\xff\x34\x12", 9));
+    BOOST_CHECK(encode(typedArray(vector<double>{})) == string("\x19\xc9\xc0", 3));
+    BOOST_CHECK(encode(typedArray(vector<float>{1.0f})) == string("\x19\xc8\xc1\x00\x00\x80\x3f", 7));
+    BOOST_CHECK(encode(typedArray(vector<uint64_t>{1})) == string("\x19\xc7\xc1\x01\x00\x00\x00\x00\x00\x00\x00", 11));
+
+    auto large = vector<int32_t>(1000, -1);
+    auto encoded = encode(typedArray(large));
+    BOOST_CHECK_EQUAL(encoded.size(), 4004);
+    BOOST_CHECK_EQUAL(exactLength(typedArray(large)), encoded.size());
+    BOOST_CHECK(encoded.substr(0, 4) == "\x19\xc4\xa8\x8f");
+}
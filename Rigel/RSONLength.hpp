@@ -17,8 +17,16 @@
 #pragma once
 #include <boost/none.hpp>
 #include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
 #include <vector>
 #include <map>
+#include <immintrin.h>
+
+#include "RSON.hpp"
+#include "DecimalFloat.hpp"
+#include "string_utils.hpp"
 
 namespace Orion {
 namespace Rigel {
@@ -86,6 +94,12 @@ static inline size_t length(const std::vector<T> &container)
     return r;
 }
 
+template<typename T>
+static inline size_t length(const RSONTypedArray<T> &value)
+{
+    return 2 + length(static_cast<uint64_t>(value.size)) + value.size * sizeof (T);
+}
+
 template<typename U, typename V>
 static inline size_t length(const std::map<U, V> &container)
 {
@@ -99,4 +113,150 @@ static inline size_t length(const std::map<U, V> &container)
     return r;
 }
 
+/** Exact number of bytes of an encoded integer.
+ * The first byte holds 6 bits and every following byte 7 bits, and the
+ * value needs to be encoded including its sign-bit.
+ */
+static inline size_t exactLengthInteger(int64_t value)
+{
+    auto nr_bits = 65 - _lzcnt_u64(static_cast<uint64_t>(value ^ (value >> 63)));
+    return 1 + nr_bits / 7;
+}
+
+static inline size_t exactLengthInteger(__int128_t value)
+{
+    auto folded = static_cast<__uint128_t>(value ^ (value >> 127));
+    auto hi = static_cast<uint64_t>(folded >> 64);
+    auto lo = static_cast<uint64_t>(folded);
+
+    auto nr_bits = 129 - (hi ? _lzcnt_u64(hi) : 64 + _lzcnt_u64(lo));
+    return 1 + nr_bits / 7;
+}
+
+static inline size_t exactLength(__int128_t v) { return exactLengthInteger(v); }
+static inline size_t exactLength(int64_t v) { return exactLengthInteger(v); }
+static inline size_t exactLength(int32_t v) { return exactLengthInteger(static_cast<int64_t>(v)); }
+static inline size_t exactLength(int16_t v) { return exactLengthInteger(static_cast<int64_t>(v)); }
+static inline size_t exactLength(int8_t v) { return exactLengthInteger(static_cast<int64_t>(v)); }
+
+static inline size_t exactLength(__uint128_t v) { return v >> 127 ? 19 : exactLengthInteger(static_cast<__int128_t>(v)); }
+static inline size_t exactLength(uint64_t v) { return v >> 63 ? 10 : exactLengthInteger(static_cast<int64_t>(v)); }
+static inline size_t exactLength(uint32_t v) { return exactLengthInteger(static_cast<int64_t>(v)); }
+static inline size_t exactLength(uint16_t v) { return exactLengthInteger(static_cast<int64_t>(v)); }
+static inline size_t exactLength(uint8_t v) { return exactLengthInteger(static_cast<int64_t>(v)); }
+
+/** Exact number of bytes of an encoded binary float.
+ * The mantissa is normalized by dropping trailing zero bits, the same way
+ * as the encoder does.
+ */
+template<typename T>
+static inline size_t exactLengthFloat(T value)
+{
+    const int MANTISSA_WIDTH = std::numeric_limits<T>::digits - 1;
+    const int EXPONENT_WIDTH = sizeof (value) == 4 ? 8 : 11;
+    const uint64_t MANTISSA_MASK = (1ULL << MANTISSA_WIDTH) - 1;
+    const int32_t EXPONENT_MASK = (1 << EXPONENT_WIDTH) - 1;
+    const int32_t EXPONENT_BIAS = (1 << (EXPONENT_WIDTH - 1)) - 1;
+
+    uint64_t value_as_int = 0;
+    memcpy(&value_as_int, &value, sizeof (value));
+
+    int32_t exponent = (value_as_int >> MANTISSA_WIDTH) & EXPONENT_MASK;
+    uint64_t mantissa = value_as_int & MANTISSA_MASK;
+
+    if (exponent == EXPONENT_MASK || (exponent == 0 && mantissa == 0)) {
+        // NaN, infinite or zero take a single field after the code.
+        return 2;
+    } else if (exponent == 0) {
+        exponent = 1 - EXPONENT_BIAS - MANTISSA_WIDTH;
+    } else {
+        mantissa |= 1ULL << MANTISSA_WIDTH;
+        exponent = exponent - EXPONENT_BIAS - MANTISSA_WIDTH;
+    }
+
+    auto trailing_zeros = __builtin_ctzll(mantissa);
+    mantissa >>= trailing_zeros;
+    exponent += trailing_zeros;
+
+    return 1 + exactLengthInteger(static_cast<int64_t>(mantissa)) + exactLengthInteger(static_cast<int64_t>(exponent));
+}
+
+static inline size_t exactLength(const DecimalFloat &value)
+{
+    if (value.isNaN() || value.isInfinite() || value.mantissa == 0) {
+        return 2;
+    }
+    return 1 + exactLengthInteger(value.mantissa) + exactLengthInteger(static_cast<int64_t>(value.exponent));
+}
+
+static inline size_t exactLength(float v) { return exactLengthFloat(v); }
+static inline size_t exactLength(double v) { return exactLengthFloat(v); }
+
+static inline size_t exactLength(const std::string &value)
+{
+    auto data = reinterpret_cast<const uint8_t *>(value.data());
+
+    switch (classifyRSONString(data, data + value.size())) {
+    case RSONStringClass::ASCII:
+        // Empty strings are encoded as UTF-8 strings, a single character is
+        // followed by a nul with the stop-bit.
+        return value.length() <= 1 ? 2 : value.length();
+    default:
+        return value.length() + 2;
+    }
+}
+
+static inline size_t exactLength(const std::basic_string<uint8_t> &value)
+{
+    // Each full chunk has a length byte, followed by the last partial chunk.
+    return 1 + value.length() / 255 + 1 + value.length();
+}
+
+static inline size_t exactLength(bool value)
+{
+    return 1;
+}
+
+static inline size_t exactLength(boost::none_t value)
+{
+    return 1;
+}
+
+template<typename U, typename V>
+static inline size_t exactLength(const std::map<U, V> &container);
+
+template<typename T, typename std::enable_if<has_rson_schema<T>::value, int>::type = 0>
+static inline size_t exactLength(const T &value);
+
+template<typename T>
+static inline size_t exactLength(const std::vector<T> &container)
+{
+    size_t r = 2;
+
+    for (auto const &item: container) {
+        r+= exactLength(item);
+    }
+
+    return r;
+}
+
+template<typename T>
+static inline size_t exactLength(const RSONTypedArray<T> &value)
+{
+    return 2 + exactLength(static_cast<uint64_t>(value.size)) + value.size * sizeof (T);
+}
+
+template<typename U, typename V>
+static inline size_t exactLength(const std::map<U, V> &container)
+{
+    size_t r = 2;
+
+    for (auto const &item: container) {
+        r+= exactLength(item.first);
+        r+= exactLength(item.second);
+    }
+
+    return r;
+}
+
 };};
@@ -0,0 +1,347 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <boost/preprocessor/punctuation/comma_if.hpp>
+#include <boost/preprocessor/seq/for_each_i.hpp>
+#include <boost/preprocessor/stringize.hpp>
+#include <boost/preprocessor/variadic/to_seq.hpp>
+
+#include "RSON.hpp"
+#include "RSONLength.hpp"
+#include "RSONEncode.hpp"
+#include "RSONDecode.hpp"
+
+namespace Orion {
+namespace Rigel {
+
+/** A field of a struct, with the key it is encoded with.
+ */
+template<typename T, typename M>
+struct RSONField {
+    typedef M value_type;
+
+    const char *key;
+    M T::*member;
+};
+
+/** Compile time information derived from RSONSchema<T>.
+ *
+ * The keys of a dictionary must be sorted, the order in which the fields
+ * are encoded is therefor calculated at compile time. Encoding a struct
+ * becomes a copy of the pre-encoded keys, followed by the values.
+ */
+template<typename T>
+struct RSONSchemaInfo {
+    static constexpr auto &fields = RSONSchema<T>::fields;
+    static constexpr size_t N = std::tuple_size<std::remove_const_t<std::remove_reference_t<decltype(fields)>>>::value;
+
+    template<size_t... I>
+    static constexpr std::array<std::string_view, N> getKeys(std::index_sequence<I...>) {
+        return {{std::string_view(std::get<I>(fields).key)...}};
+    }
+
+    /** Keys in the order the fields are declared in.
+     */
+    static constexpr std::array<std::string_view, N> keys = getKeys(std::make_index_sequence<N>());
+
+    /** Field indices sorted by key, using insertion sort.
+     * Strings are sorted by the byte values of their UTF-8 encoding, which is
+     * how std::char_traits<char> compares.
+     */
+    static constexpr std::array<size_t, N> sortKeys(void) {
+        std::array<size_t, N> r = {};
+        for (size_t i = 0; i < N; i++) {
+            r[i] = i;
+        }
+        for (size_t i = 1; i < N; i++) {
+            for (size_t j = i; j > 0 && keys[r[j]] < keys[r[j - 1]]; j--) {
+                auto tmp = r[j];
+                r[j] = r[j - 1];
+                r[j - 1] = tmp;
+            }
+        }
+        return r;
+    }
+
+    static constexpr std::array<size_t, N> order = sortKeys();
+
+    static constexpr bool uniqueKeys(void) {
+        for (size_t i = 1; i < N; i++) {
+            if (keys[order[i]] == keys[order[i - 1]]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static_assert(N > 0, "A schema needs at least one field");
+    static_assert(uniqueKeys(), "Keys of a schema must be unique");
+
+    /** The encoded code, name and sorted keys, up to and including the mark.
+     */
+    static const std::string &prefix(void) {
+        static const std::string r = [] {
+            auto s = std::string();
+            if (RSONSchema<T>::name != nullptr) {
+                s += NAMED_DICTIONARY_CODE;
+                encode(s, std::string(RSONSchema<T>::name));
+            } else {
+                s += DICTIONARY_CODE;
+            }
+            for (size_t i = 0; i < N; i++) {
+                encode(s, std::string(keys[order[i]]));
+            }
+            s += MARK_CODE;
+            return s;
+        }();
+        return r;
+    }
+
+    /** The encoded keys in sorted order.
+     * Keys are canonically encoded, so an encoded key can be matched with memcmp.
+     */
+    static const std::array<std::string, N> &encodedKeys(void) {
+        static const std::array<std::string, N> r = [] {
+            auto r = std::array<std::string, N>();
+            for (size_t i = 0; i < N; i++) {
+                r[i] = encode(std::string(keys[order[i]]));
+            }
+            return r;
+        }();
+        return r;
+    }
+
+    template<size_t J>
+    static inline const auto &field(void) {
+        return std::get<order[J]>(fields);
+    }
+
+    template<typename S, size_t... J>
+    static inline void encodeValues(S &s, const T &value, std::index_sequence<J...>) {
+        (encode(s, value.*(field<J>().member)), ...);
+    }
+
+    template<size_t... J>
+    static inline size_t lengthValues(const T &value, std::index_sequence<J...>) {
+        return (exactLength(value.*(field<J>().member)) + ...);
+    }
+
+    template<size_t J>
+    static void decodeValue(RSONCursor &cursor, T &value) {
+        decodeInto(cursor, value.*(field<J>().member));
+    }
+
+    /** Reset a field to the value it has in a default constructed struct.
+     */
+    template<size_t J>
+    static void resetValue(T &value) {
+        static const T defaultValue = T();
+        value.*(field<J>().member) = defaultValue.*(field<J>().member);
+    }
+
+    typedef void (*decoder_t)(RSONCursor &, T &);
+    typedef void (*resetter_t)(T &);
+
+    template<size_t... J>
+    static constexpr std::array<decoder_t, N> getDecoders(std::index_sequence<J...>) {
+        return {{&decodeValue<J>...}};
+    }
+
+    template<size_t... J>
+    static constexpr std::array<resetter_t, N> getResetters(std::index_sequence<J...>) {
+        return {{&resetValue<J>...}};
+    }
+
+    /** Decoders of each value, indexed by the sorted position of its key.
+     */
+    static constexpr std::array<decoder_t, N> decoders = getDecoders(std::make_index_sequence<N>());
+
+    /** Resetters of each value, indexed by the sorted position of its key.
+     */
+    static constexpr std::array<resetter_t, N> resetters = getResetters(std::make_index_sequence<N>());
+
+    /** Find the sorted position of an encoded key.
+     * Keys of a message are sorted in the same order as the schema, so the
+     * key is first compared with the next expected key. Only for keys that
+     * are missing or unknown the key is decoded and searched for.
+     *
+     * @param cursor Cursor pointing to the key, on return it points just after the key.
+     * @param expected The sorted position of the next expected key.
+     * @return The sorted position of the key, or N if the key is unknown.
+     */
+    static inline size_t findKey(RSONCursor &cursor, size_t expected) {
+        auto &encoded = encodedKeys();
+
+        if (expected < N) {
+            auto &e = encoded[expected];
+            if (cursor.remaining() >= e.size() && memcmp(cursor.ptr, e.data(), e.size()) == 0) {
+                cursor.ptr += e.size();
+                return expected;
+            }
+        }
+
+        if (peekType(cursor) != Type::String) {
+            skip(cursor);
+            return N;
+        }
+
+        auto key = decode<std::string>(cursor);
+        size_t lo = expected;
+        size_t hi = N;
+        while (lo < hi) {
+            auto mid = (lo + hi) / 2;
+            if (keys[order[mid]] < key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return (lo < N && keys[order[lo]] == key) ? lo : N;
+    }
+};
+
+/** Encode a struct with a schema as a (named) dictionary.
+ */
+template<typename S, typename T, typename std::enable_if<is_rson_sink<S>::value && has_rson_schema<T>::value, int>::type>
+static inline void encode(S &s, const T &value)
+{
+    typedef RSONSchemaInfo<T> Info;
+
+    auto &prefix = Info::prefix();
+    s.append(prefix.data(), prefix.size());
+    Info::encodeValues(s, value, std::make_index_sequence<Info::N>());
+}
+
+template<typename T, typename std::enable_if<has_rson_schema<T>::value, int>::type>
+static inline size_t exactLength(const T &value)
+{
+    typedef RSONSchemaInfo<T> Info;
+
+    return Info::prefix().size() + Info::lengthValues(value, std::make_index_sequence<Info::N>());
+}
+
+/** Decode a struct with a schema from a (named) dictionary into an existing struct.
+ * Fields are decoded into the fields of the struct, so that strings, vectors
+ * and maps reuse their memory. Fields that are missing from the dictionary
+ * are reset to their default value, and keys that are not in the schema
+ * are skipped.
+ */
+template<typename T, typename std::enable_if<has_rson_schema<T>::value, int>::type>
+static inline void decodeInto(RSONCursor &cursor, T &r)
+{
+    typedef RSONSchemaInfo<T> Info;
+    const size_t NOT_FOUND = SIZE_MAX;
+
+    auto c = cursor.get();
+    if (c == NAMED_DICTIONARY_CODE) {
+        if (RSONSchema<T>::name != nullptr && peekType(cursor) == Type::String) {
+            if (decode<std::string>(cursor) != RSONSchema<T>::name) {
+                BOOST_THROW_EXCEPTION(decode_type_error() << type_info(Type::Dictionary));
+            }
+        } else {
+            skip(cursor);
+        }
+    } else if (c != DICTIONARY_CODE) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+    }
+
+    // For each sorted key, the position of that key in the dictionary.
+    size_t positions[Info::N];
+    for (size_t j = 0; j < Info::N; j++) {
+        positions[j] = NOT_FOUND;
+    }
+
+    size_t nrKeys = 0;
+    size_t expected = 0;
+    for (; cursor.peek() != MARK_CODE; nrKeys++) {
+        auto j = Info::findKey(cursor, expected);
+        if (j < Info::N) {
+            positions[j] = nrKeys;
+            expected = j + 1;
+        }
+    }
+
+    // Skip over the mark symbol, because before this we just peeked at it.
+    cursor.ptr++;
+
+    size_t j = 0;
+    for (size_t i = 0; i < nrKeys; i++) {
+        while (j < Info::N && (positions[j] == NOT_FOUND || positions[j] < i)) {
+            j++;
+        }
+        if (j < Info::N && positions[j] == i) {
+            Info::decoders[j](cursor, r);
+        } else {
+            skip(cursor);
+        }
+    }
+
+    for (j = 0; j < Info::N; j++) {
+        if (positions[j] == NOT_FOUND) {
+            Info::resetters[j](r);
+        }
+    }
+}
+
+/** Decode a struct with a schema from a (named) dictionary.
+ * Fields that are missing from the dictionary keep their default value,
+ * and keys that are not in the schema are skipped.
+ */
+template<typename T, typename std::enable_if<has_rson_schema<T>::value, int>::type>
+static inline T decode(RSONCursor &cursor)
+{
+    auto r = T();
+    decodeInto(cursor, r);
+    return r;
+}
+
+};};
+
+#define RSON_SCHEMA_FIELD(r, T, i, field)\
+    BOOST_PP_COMMA_IF(i) ::Orion::Rigel::RSONField<T, decltype(T::field)>{BOOST_PP_STRINGIZE(field), &T::field}
+
+/** Declare the fields of a struct, so that it can be encoded and decoded.
+ * The struct is encoded as a named dictionary, with the names of the
+ * fields as keys. This macro must be used in the global namespace.
+ *
+ * Decoding value-initializes the struct with T(), which -Weffc++ reports
+ * for members without an initializer; give every field a default member
+ * initializer, such as `std::string label{};` and `int64_t x = 0;`.
+ *
+ * Example:
+ *     RSON_SCHEMA(Point, "Point", x, y, label)
+ *
+ * @param T The type of the struct.
+ * @param NAME The name of the class as a string literal, or nullptr to encode
+ *             the struct as a normal dictionary.
+ * @param ... The names of the fields.
+ */
+#define RSON_SCHEMA(T, NAME, ...)\
+    template<> struct Orion::Rigel::RSONSchema<T> {\
+        static constexpr const char *name = NAME;\
+        static constexpr auto fields = std::make_tuple(\
+            BOOST_PP_SEQ_FOR_EACH_I(RSON_SCHEMA_FIELD, T, BOOST_PP_VARIADIC_TO_SEQ(__VA_ARGS__))\
+        );\
+    };
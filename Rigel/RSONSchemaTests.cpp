@@ -0,0 +1,159 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "RSONSchema tests"
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include "RSONSchema.hpp"
+#include "RSONView.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+struct Listener {
+    string protocol{};
+    string address{};
+    int64_t port = 0;
+};
+
+RSON_SCHEMA(Listener, "Listener", protocol, address, port)
+
+struct Service {
+    string serviceName{};
+    vector<Listener> listeners{};
+    double drift = 0.0;
+    bool enabled = false;
+    vector<int32_t> tags{};
+};
+
+RSON_SCHEMA(Service, nullptr, serviceName, listeners, drift, enabled, tags)
+
+static Service testService(void)
+{
+    auto r = Service();
+    r.serviceName = "Alnitak";
+    r.listeners = {{"ritp", "10.0.0.1", 4000}, {"ritp", "10.0.0.2", 4001}};
+    r.drift = 0.125;
+    r.enabled = true;
+    r.tags = {1, -2, 300};
+    return r;
+}
+
+BOOST_AUTO_TEST_CASE(SchemaKeyOrder)
+{
+    typedef RSONSchemaInfo<Listener> Info;
+
+    BOOST_CHECK_EQUAL(Info::keys[Info::order[0]], "address");
+    BOOST_CHECK_EQUAL(Info::keys[Info::order[1]], "port");
+    BOOST_CHECK_EQUAL(Info::keys[Info::order[2]], "protocol");
+}
+
+BOOST_AUTO_TEST_CASE(SchemaEncode)
+{
+    auto listener = Listener{"ritp", "10.0.0.1", 4000};
+
+    auto expected = string("\x1a");
+    encode(expected, string("Listener"));
+    encode(expected, string("address"));
+    encode(expected, string("port"));
+    encode(expected, string("protocol"));
+    expected += MARK_CODE;
+    encode(expected, string("10.0.0.1"));
+    encode(expected, static_cast<int64_t>(4000));
+    encode(expected, string("ritp"));
+
+    auto buffer = encode(listener);
+    BOOST_CHECK(buffer == expected);
+    BOOST_CHECK_EQUAL(exactLength(listener), buffer.size());
+
+    auto cursor = RSONCursor(buffer);
+    BOOST_CHECK_NO_THROW(validate(cursor));
+}
+
+BOOST_AUTO_TEST_CASE(SchemaRoundTrip)
+{
+    auto service = testService();
+    auto buffer = encode(service);
+    BOOST_CHECK_EQUAL(exactLength(service), buffer.size());
+
+    auto r = decode<Service>(buffer);
+    BOOST_CHECK_EQUAL(r.serviceName, service.serviceName);
+    BOOST_CHECK_EQUAL(r.drift, service.drift);
+    BOOST_CHECK_EQUAL(r.enabled, service.enabled);
+    BOOST_CHECK(r.tags == service.tags);
+    BOOST_CHECK_EQUAL(r.listeners.size(), 2);
+    BOOST_CHECK_EQUAL(r.listeners[1].address, "10.0.0.2");
+    BOOST_CHECK_EQUAL(r.listeners[1].port, 4001);
+    BOOST_CHECK_EQUAL(r.listeners[1].protocol, "ritp");
+
+    // A class-instance can be read as a normal dictionary.
+    auto view = RSONView(buffer);
+    BOOST_CHECK_EQUAL(view["listeners"][0]["port"].as<int64_t>(), 4000);
+    auto any = any_cast<map<string, boost::any>>(decode(buffer));
+    BOOST_CHECK_EQUAL(any.size(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(SchemaMissingAndUnknownFields)
+{
+    // A dictionary from a newer and older version of the struct.
+    auto buffer = encode(map<string, string>{
+        {"aaa", "unknown"},
+        {"address", "10.0.0.3"},
+        {"protocol", "ritp"},
+        {"zzz", "unknown"}
+    });
+
+    auto r = decode<Listener>(buffer);
+    BOOST_CHECK_EQUAL(r.address, "10.0.0.3");
+    BOOST_CHECK_EQUAL(r.protocol, "ritp");
+    BOOST_CHECK_EQUAL(r.port, 0);
+}
+
+BOOST_AUTO_TEST_CASE(SchemaWrongName)
+{
+    auto buffer = encode(Listener{"ritp", "10.0.0.1", 4000});
+    buffer[2] = 'X';
+
+    BOOST_CHECK_THROW(decode<Listener>(buffer), decode_type_error);
+}
+
+BOOST_AUTO_TEST_CASE(SchemaDecodeInto)
+{
+    auto service = testService();
+    auto r = Service();
+    decodeInto(encode(service), r);
+    BOOST_CHECK_EQUAL(r.serviceName, service.serviceName);
+    BOOST_CHECK_EQUAL(r.listeners.size(), 2);
+
+    // The listeners are decoded into the listeners of the previous message.
+    auto listenersData = r.listeners.data();
+    service.listeners[1].address = "10.0.0.3";
+    decodeInto(encode(service), r);
+    BOOST_CHECK(r.listeners.data() == listenersData);
+    BOOST_CHECK_EQUAL(r.listeners[1].address, "10.0.0.3");
+    BOOST_CHECK(r.tags == service.tags);
+
+    // Fields that are missing are reset to their default value.
+    auto listener = Listener{"ritp", "10.0.0.1", 4000};
+    decodeInto(encode(map<string, string>{{"address", "10.0.0.4"}}), listener);
+    BOOST_CHECK_EQUAL(listener.address, "10.0.0.4");
+    BOOST_CHECK_EQUAL(listener.protocol, "");
+    BOOST_CHECK_EQUAL(listener.port, 0);
+}
@@ -0,0 +1,339 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <sys/uio.h>
+#include <boost/exception/all.hpp>
+
+namespace Orion {
+namespace Rigel {
+
+struct encode_error: virtual boost::exception {};
+struct encode_type_error: virtual encode_error, virtual std::exception {};
+struct encode_value_error: virtual encode_error, virtual std::exception {};
+struct encode_overflow_error: virtual encode_error, virtual std::exception {};
+
+/** Output sinks for the RSON encoder.
+ * A sink has the same append interface as std::string, which is itself
+ * a sink:
+ *  - `s += c` appends a single byte.
+ *  - `s.append(data, size)` appends a copy of size bytes.
+ *
+ * Large blocks of data, such as the chunks of a byte array, are passed to
+ * appendReference(), which sinks may overload to keep a reference to the
+ * data instead of copying it.
+ */
+template<typename S>
+struct is_rson_sink: std::false_type {};
+
+template<>
+struct is_rson_sink<std::string>: std::true_type {};
+
+/** Append a block of data which outlives the sink.
+ * By default the data is copied into the sink.
+ */
+template<typename S>
+static inline void appendReference(S &s, const uint8_t *data, size_t size)
+{
+    s.append(reinterpret_cast<const char *>(data), size);
+}
+
+/** A sink writing into a fixed size, caller provided buffer.
+ * For example a send buffer, directly after a packet header.
+ * Writing beyond the end of the buffer throws encode_overflow_error,
+ * exactLength() may be used to check beforehand if a value fits.
+ */
+class RSONBufferSink {
+    uint8_t *start;
+    uint8_t *ptr;
+    uint8_t *end;
+
+public:
+    inline RSONBufferSink(uint8_t *data, size_t size) :
+        start(data), ptr(data), end(data + size) {}
+
+    RSONBufferSink(const RSONBufferSink &other) = delete;
+    RSONBufferSink &operator=(const RSONBufferSink &other) = delete;
+
+    inline RSONBufferSink &operator+=(char c) {
+        if (ptr == end) {
+            BOOST_THROW_EXCEPTION(encode_overflow_error());
+        }
+        *(ptr++) = static_cast<uint8_t>(c);
+        return *this;
+    }
+
+    inline RSONBufferSink &append(const char *data, size_t size) {
+        if (size > static_cast<size_t>(end - ptr)) {
+            BOOST_THROW_EXCEPTION(encode_overflow_error());
+        }
+        memcpy(ptr, data, size);
+        ptr += size;
+        return *this;
+    }
+
+    inline const uint8_t *data(void) const {
+        return start;
+    }
+
+    /** Number of bytes written.
+     */
+    inline size_t size(void) const {
+        return ptr - start;
+    }
+
+    inline size_t capacity(void) const {
+        return end - start;
+    }
+
+    inline void clear(void) {
+        ptr = start;
+    }
+};
+
+template<>
+struct is_rson_sink<RSONBufferSink>: std::true_type {};
+
+/** A growable, contiguous sink.
+ * Unlike std::string the memory is not initialized when growing, and
+ * clear() keeps the memory so that it can be reused for the next message.
+ */
+class RSONArenaSink {
+    std::unique_ptr<uint8_t[]> buffer;
+    size_t used;
+    size_t allocated;
+
+    inline void grow(size_t size) {
+        auto newAllocated = allocated * 2;
+        while (newAllocated < used + size) {
+            newAllocated *= 2;
+        }
+
+        auto newBuffer = std::unique_ptr<uint8_t[]>(new uint8_t[newAllocated]);
+        memcpy(newBuffer.get(), buffer.get(), used);
+        buffer = std::move(newBuffer);
+        allocated = newAllocated;
+    }
+
+public:
+    inline RSONArenaSink(size_t capacity = 256) :
+        buffer(new uint8_t[capacity > 0 ? capacity : 1]), used(0), allocated(capacity > 0 ? capacity : 1) {}
+
+    RSONArenaSink(const RSONArenaSink &other) = delete;
+    RSONArenaSink &operator=(const RSONArenaSink &other) = delete;
+
+    inline RSONArenaSink &operator+=(char c) {
+        if (used == allocated) {
+            grow(1);
+        }
+        buffer[used++] = static_cast<uint8_t>(c);
+        return *this;
+    }
+
+    inline RSONArenaSink &append(const char *data, size_t size) {
+        if (size > allocated - used) {
+            grow(size);
+        }
+        memcpy(&buffer[used], data, size);
+        used += size;
+        return *this;
+    }
+
+    inline const uint8_t *data(void) const {
+        return buffer.get();
+    }
+
+    inline size_t size(void) const {
+        return used;
+    }
+
+    inline size_t capacity(void) const {
+        return allocated;
+    }
+
+    inline void clear(void) {
+        used = 0;
+    }
+};
+
+template<>
+struct is_rson_sink<RSONArenaSink>: std::true_type {};
+
+/** A sink producing a scatter/gather list for writev() and sendmsg().
+ * Small writes are copied into blocks owned by the sink, large blocks
+ * passed to appendReference() are referenced without copying. Referenced
+ * data must stay alive until the iovecs have been sent.
+ *
+ * RSON byte arrays are encoded in chunks of 255 bytes, each followed by a
+ * length byte, so referencing them would cost two iovecs per chunk. The
+ * default threshold is above the chunk size so that they are copied, only
+ * the unchunked typed arrays and CBSON byte arrays are referenced. Once half
+ * of IOV_MAX is used, references are copied as well, so that iovcnt() stays
+ * within IOV_MAX.
+ */
+class RSONIOVecSink {
+    std::vector<std::unique_ptr<uint8_t[]>> blocks;
+    std::vector<struct iovec> vectors;
+    size_t initialBlockSize;
+    size_t blockSize;
+    size_t blockUsed;
+    size_t referenceThreshold;
+    size_t total;
+
+    /** Make sure the last iovec points to the end of the current block.
+     */
+    inline uint8_t *reserve(size_t size) {
+        if (blocks.empty() || blockUsed + size > blockSize) {
+            // Blocks double in size, so that the number of iovecs grows with
+            // the logarithm of the message size.
+            blockSize = std::max(size, blocks.empty() ? initialBlockSize : 2 * blockSize);
+            blocks.emplace_back(new uint8_t[blockSize]);
+            blockUsed = 0;
+            vectors.push_back({blocks.back().get(), 0});
+
+        } else if (static_cast<uint8_t *>(vectors.back().iov_base) + vectors.back().iov_len != blocks.back().get() + blockUsed) {
+            // The last iovec is a reference, continue in the current block.
+            vectors.push_back({blocks.back().get() + blockUsed, 0});
+        }
+
+        auto p = blocks.back().get() + blockUsed;
+        blockUsed += size;
+        vectors.back().iov_len += size;
+        total += size;
+        return p;
+    }
+
+public:
+    /**
+     * @param blockSize Size of the first block in which small writes are copied.
+     * @param referenceThreshold Minimum size of a reference to be sent without copying.
+     */
+    inline RSONIOVecSink(size_t blockSize = 4096, size_t referenceThreshold = 1024) :
+        blocks(), vectors(), initialBlockSize(blockSize), blockSize(blockSize), blockUsed(0), referenceThreshold(referenceThreshold), total(0) {}
+
+    RSONIOVecSink(const RSONIOVecSink &other) = delete;
+    RSONIOVecSink &operator=(const RSONIOVecSink &other) = delete;
+
+    inline RSONIOVecSink &operator+=(char c) {
+        *reserve(1) = static_cast<uint8_t>(c);
+        return *this;
+    }
+
+    inline RSONIOVecSink &append(const char *data, size_t size) {
+        memcpy(reserve(size), data, size);
+        return *this;
+    }
+
+    inline RSONIOVecSink &appendReference(const uint8_t *data, size_t size) {
+        // A reference may be followed by a new iovec for the next small write,
+        // half of IOV_MAX is kept for the blocks.
+        if (size < referenceThreshold || vectors.size() + 2 > IOV_MAX / 2) {
+            return append(reinterpret_cast<const char *>(data), size);
+        }
+
+        vectors.push_back({const_cast<uint8_t *>(data), size});
+        total += size;
+        return *this;
+    }
+
+    inline const struct iovec *iov(void) const {
+        return vectors.data();
+    }
+
+    inline size_t iovcnt(void) const {
+        return vectors.size();
+    }
+
+    /** Total number of bytes in all iovecs.
+     */
+    inline size_t size(void) const {
+        return total;
+    }
+
+    inline void clear(void) {
+        blocks.clear();
+        vectors.clear();
+        blockUsed = 0;
+        total = 0;
+    }
+};
+
+template<>
+struct is_rson_sink<RSONIOVecSink>: std::true_type {};
+
+static inline void appendReference(RSONIOVecSink &s, const uint8_t *data, size_t size)
+{
+    s.appendReference(data, size);
+}
+
+/** A sink writing to a stream through a small buffer.
+ * The buffer is flushed to the stream when it is full, and must be flushed
+ * with flush() after the value has been encoded. When encoding fails part
+ * of the value may already have been written; use encode(std::ostream &, ...)
+ * when a message must be written completely or not at all.
+ */
+class RSONStreamSink {
+    std::ostream &stream;
+    char buffer[1024];
+    size_t used;
+
+public:
+    explicit inline RSONStreamSink(std::ostream &stream) :
+        stream(stream), used(0) {}
+
+    RSONStreamSink(const RSONStreamSink &other) = delete;
+    RSONStreamSink &operator=(const RSONStreamSink &other) = delete;
+
+    inline void flush(void) {
+        stream.write(buffer, used);
+        used = 0;
+    }
+
+    inline RSONStreamSink &operator+=(char c) {
+        if (used == sizeof (buffer)) {
+            flush();
+        }
+        buffer[used++] = c;
+        return *this;
+    }
+
+    inline RSONStreamSink &append(const char *data, size_t size) {
+        if (size > sizeof (buffer) - used) {
+            flush();
+        }
+        if (size >= sizeof (buffer)) {
+            stream.write(data, size);
+        } else {
+            memcpy(&buffer[used], data, size);
+            used += size;
+        }
+        return *this;
+    }
+};
+
+template<>
+struct is_rson_sink<RSONStreamSink>: std::true_type {};
+
+};};
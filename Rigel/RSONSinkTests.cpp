@@ -0,0 +1,132 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "RSONSink tests"
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <sstream>
+#include "RSONEncode.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+static map<string, vector<int64_t>> testValue(void)
+{
+    return map<string, vector<int64_t>>{
+        {"hello", {1, -1, 1000000}},
+        {"caf\xc3\xa9", {}},
+        {"x", {numeric_limits<int64_t>::min()}}
+    };
+}
+
+BOOST_AUTO_TEST_CASE(BufferSink)
+{
+    auto value = testValue();
+    auto expected = encode(value);
+
+    // Encode after a packet header.
+    uint8_t packet[16 + 64];
+    memset(packet, 0xaa, sizeof (packet));
+    RSONBufferSink sink(&packet[16], sizeof (packet) - 16);
+    encode(sink, value);
+
+    BOOST_CHECK_EQUAL(sink.size(), expected.size());
+    BOOST_CHECK(memcmp(&packet[16], expected.data(), expected.size()) == 0);
+    BOOST_CHECK_EQUAL(packet[15], 0xaa);
+
+    RSONBufferSink small(&packet[16], expected.size() - 1);
+    BOOST_CHECK_THROW(encode(small, value), encode_overflow_error);
+}
+
+BOOST_AUTO_TEST_CASE(ArenaSink)
+{
+    auto value = testValue();
+    auto expected = encode(value);
+
+    RSONArenaSink sink(1);
+    encode(sink, value);
+    BOOST_CHECK(string(reinterpret_cast<const char *>(sink.data()), sink.size()) == expected);
+
+    auto capacity = sink.capacity();
+    sink.clear();
+    encode(sink, value);
+    BOOST_CHECK(string(reinterpret_cast<const char *>(sink.data()), sink.size()) == expected);
+    BOOST_CHECK_EQUAL(sink.capacity(), capacity);
+}
+
+BOOST_AUTO_TEST_CASE(IOVecSink)
+{
+    auto bytes = basic_string<uint8_t>();
+    for (int i = 0; i < 1000; i++) {
+        bytes.push_back(static_cast<uint8_t>(i));
+    }
+    auto value = vector<basic_string<uint8_t>>{bytes, basic_string<uint8_t>(3, 0x55)};
+    auto expected = encode(value);
+
+    RSONIOVecSink sink(64, 255);
+    encode(sink, value);
+
+    auto gathered = string();
+    bool referenced = false;
+    for (size_t i = 0; i < sink.iovcnt(); i++) {
+        auto &iov = sink.iov()[i];
+        gathered.append(static_cast<const char *>(iov.iov_base), iov.iov_len);
+        referenced |= iov.iov_base == &value[0][255];
+    }
+    BOOST_CHECK(gathered == expected);
+    BOOST_CHECK_EQUAL(sink.size(), expected.size());
+    BOOST_CHECK(referenced);
+
+    // By default the chunks of a byte array are copied.
+    RSONIOVecSink copied;
+    encode(copied, value);
+    BOOST_CHECK_EQUAL(copied.iovcnt(), 1);
+    BOOST_CHECK_EQUAL(copied.size(), expected.size());
+
+    // Large typed arrays are referenced, until the list nears IOV_MAX.
+    auto numbers = vector<int64_t>(1000, 5);
+    RSONIOVecSink limited(16);
+    for (size_t i = 0; i < 2 * IOV_MAX; i++) {
+        encode(limited, typedArray(numbers));
+    }
+    BOOST_CHECK(limited.iovcnt() <= IOV_MAX);
+    BOOST_CHECK_EQUAL(limited.size(), 2 * IOV_MAX * encode(typedArray(numbers)).size());
+}
+
+BOOST_AUTO_TEST_CASE(StreamSink)
+{
+    auto value = vector<string>(100, string("The quick brown fox jumps over the lazy dog."));
+    auto stream = stringstream();
+
+    encode(stream, value);
+    BOOST_CHECK(stream.str() == encode(value));
+
+    auto sinkStream = stringstream();
+    RSONStreamSink sink(sinkStream);
+    encode(sink, value);
+    sink.flush();
+    BOOST_CHECK(sinkStream.str() == encode(value));
+
+    // Nothing is written when the value can not be encoded.
+    auto invalid = value;
+    invalid.push_back(string("nul\x00", 4));
+    auto failed = stringstream();
+    BOOST_CHECK_THROW(encode(failed, invalid), encode_value_error);
+    BOOST_CHECK(failed.str().empty());
+}
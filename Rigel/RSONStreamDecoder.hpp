@@ -0,0 +1,741 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <functional>
+#include <boost/any.hpp>
+#include <boost/none.hpp>
+#include <boost/exception/all.hpp>
+
+#include "RSON.hpp"
+#include "RSONDecode.hpp"
+#include "DecimalFloat.hpp"
+#include "string_utils.hpp"
+
+namespace Orion {
+namespace Rigel {
+
+/** Receives the events of the RSONStreamDecoder.
+ * Strings and byte arrays are passed complete, the elements of typed arrays
+ * in chunks as they arrive; the views are only valid during the call.
+ */
+class RSONHandler {
+public:
+    virtual ~RSONHandler() {}
+
+    virtual void onNone(void) {}
+    virtual void onBoolean(bool value) {}
+    virtual void onInteger(int64_t value) {}
+    virtual void onFloat(double value) {}
+
+    /** A decimal float, by default passed to onFloat() as a double.
+     */
+    virtual void onDecimalFloat(const DecimalFloat &value) { onFloat(value.toDouble()); }
+    virtual void onString(std::string_view value) {}
+    virtual void onByteArray(std::basic_string_view<uint8_t> value) {}
+
+    virtual void onListBegin(void) {}
+    virtual void onListEnd(void) {}
+
+    /** Start of a typed array, by default passed as a list of integers or floats.
+     * @param type The element type.
+     * @param count The number of elements that follow.
+     */
+    virtual void onTypedArrayBegin(ArrayType type, size_t count) { onListBegin(); }
+
+    /** Elements of a typed array, as they arrive.
+     * @param type The element type.
+     * @param data The little endian elements, which may not be aligned.
+     * @param count The number of elements in this chunk.
+     */
+    virtual void onTypedArrayChunk(ArrayType type, const uint8_t *data, size_t count) {
+        forEachArrayElement(type, data, count, [this](auto value) {
+            if constexpr (std::is_floating_point<decltype(value)>::value) {
+                onFloat(value);
+            } else {
+                onInteger(value);
+            }
+        });
+    }
+
+    virtual void onTypedArrayEnd(void) { onListEnd(); }
+
+    /** Start of a dictionary, the keys follow.
+     * @param name The name of a named dictionary, or empty.
+     */
+    virtual void onDictionaryBegin(std::string_view name) {}
+
+    /** All keys have been received, the values follow.
+     */
+    virtual void onKeysEnd(void) {}
+    virtual void onDictionaryEnd(void) {}
+
+    /** A top level field has been completely decoded.
+     */
+    virtual void onFieldEnd(void) {}
+
+    /** The decoder was reset, the partially decoded field is forgotten.
+     */
+    virtual void onReset(void) {}
+};
+
+/** A push-style, resumable RSON decoder.
+ * Data is passed in chunks of any size as it arrives, for example the
+ * fragments of a RITP message. Events are emitted as soon as a value is
+ * complete, so large lists and dictionaries are processed before the last
+ * chunk is received. Only a single string or byte array is buffered,
+ * typed arrays are passed on in chunks of whole elements. A string or byte
+ * array larger than the maximum field size throws decode_overflow_error.
+ *
+ * After an exception the decoder must be reset().
+ */
+class RSONStreamDecoder {
+    enum class State {
+        Field,
+        Integer,
+        AsciiString,
+        UTF8String,
+        ByteArrayLength,
+        ByteArrayChunk,
+        Float,
+        TypedArrayHeader,
+        TypedArray
+    };
+
+    enum class IntegerTarget {
+        Value,
+        Mantissa,
+        Exponent,
+        ArrayType,
+        ArrayCount
+    };
+
+    enum class FrameType {
+        List,
+        Name,
+        Keys,
+        Values
+    };
+
+    struct Frame {
+        FrameType type;
+        size_t nrKeys;
+    };
+
+    RSONHandler &handler;
+    size_t maximumDepth;
+    size_t maximumFieldSize;
+
+    State state;
+    std::vector<Frame> frames;
+    std::string buffer;
+
+    IntegerTarget integerTarget;
+    __uint128_t integerValue;
+    unsigned int integerBits;
+
+    bool decimal;
+    int64_t mantissa;
+    size_t chunkRemaining;
+    bool lastChunk;
+
+    ArrayType arrayType;
+    size_t arrayCount;
+
+    /** Add to the string or byte array being buffered.
+     */
+    inline void appendField(const uint8_t *data, size_t size) {
+        if (size > maximumFieldSize - buffer.size()) {
+            BOOST_THROW_EXCEPTION(decode_overflow_error());
+        }
+        buffer.append(reinterpret_cast<const char *>(data), size);
+    }
+
+    inline void pushFrame(FrameType type) {
+        if (frames.size() >= maximumDepth) {
+            BOOST_THROW_EXCEPTION(decode_overflow_error());
+        }
+        frames.push_back({type, 0});
+    }
+
+    /** Called after a complete value has been emitted.
+     */
+    inline void valueEnd(void) {
+        state = State::Field;
+
+        if (frames.empty()) {
+            handler.onFieldEnd();
+            return;
+        }
+
+        auto &frame = frames.back();
+        switch (frame.type) {
+        case FrameType::Keys:
+            frame.nrKeys++;
+            return;
+
+        case FrameType::Values:
+            if (--frame.nrKeys == 0) {
+                frames.pop_back();
+                handler.onDictionaryEnd();
+                valueEnd();
+            }
+            return;
+
+        default:
+            return;
+        }
+    }
+
+    /** Dictionaries without keys have no values.
+     */
+    inline void keysEnd(void) {
+        handler.onKeysEnd();
+        if (frames.back().nrKeys == 0) {
+            frames.pop_back();
+            handler.onDictionaryEnd();
+            valueEnd();
+        } else {
+            frames.back().type = FrameType::Values;
+            state = State::Field;
+        }
+    }
+
+    /** The name of a named dictionary must be a string or none.
+     */
+    inline bool isName(void) const {
+        return !frames.empty() && frames.back().type == FrameType::Name;
+    }
+
+    inline void name(std::string_view value) {
+        frames.back().type = FrameType::Keys;
+        state = State::Field;
+        handler.onDictionaryBegin(value);
+    }
+
+    inline void requireNotName(void) const {
+        if (isName()) {
+            BOOST_THROW_EXCEPTION(decode_type_error());
+        }
+    }
+
+    inline void emitString(void) {
+        if (isName()) {
+            name(buffer);
+        } else {
+            handler.onString(buffer);
+            valueEnd();
+        }
+    }
+
+    /** Emit a float from its mantissa and exponent, or special value.
+     */
+    inline void emitFloat(int64_t mantissa, int64_t exponent) {
+        if (decimal) {
+            if (exponent == DecimalFloat::EXPONENT_INF) {
+                handler.onDecimalFloat(DecimalFloat::infinity(mantissa < 0));
+            } else if (exponent == DecimalFloat::EXPONENT_NAN) {
+                handler.onDecimalFloat(DecimalFloat::quiet_NaN());
+            } else {
+                handler.onDecimalFloat(decodeDecimalFloat(mantissa, static_cast<int32_t>(exponent)));
+            }
+        } else {
+            if (exponent == DecimalFloat::EXPONENT_INF) {
+                handler.onFloat(mantissa < 0 ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity());
+            } else if (exponent == DecimalFloat::EXPONENT_NAN) {
+                handler.onFloat(std::numeric_limits<double>::quiet_NaN());
+            } else {
+                handler.onFloat(makeFloatingPoint<double>(mantissa, exponent));
+            }
+        }
+        valueEnd();
+    }
+
+    inline void typedArrayEnd(void) {
+        handler.onTypedArrayEnd();
+        valueEnd();
+    }
+
+    /** Start decoding an integer from its first byte.
+     */
+    inline void integerBegin(uint8_t c, IntegerTarget target) {
+        integerTarget = target;
+        integerValue = c & 0x3f;
+        integerBits = 6;
+
+        if (c & 0x40) {
+            integerEnd();
+        } else {
+            state = State::Integer;
+        }
+    }
+
+    inline void integerEnd(void) {
+        // Sign extend from the number of bits received.
+        auto shift = 128 - integerBits;
+        auto value = static_cast<__int128_t>(integerValue << shift) >> shift;
+        if (value < INT64_MIN || value > INT64_MAX) {
+            BOOST_THROW_EXCEPTION(decode_overflow_error());
+        }
+
+        switch (integerTarget) {
+        case IntegerTarget::Value:
+            requireNotName();
+            handler.onInteger(static_cast<int64_t>(value));
+            valueEnd();
+            break;
+
+        case IntegerTarget::Mantissa:
+            if (value == 0) {
+                emitFloat(0, 0);
+            } else {
+                mantissa = static_cast<int64_t>(value);
+                state = State::Float;
+                integerTarget = IntegerTarget::Exponent;
+            }
+            break;
+
+        case IntegerTarget::Exponent:
+            if (decimal && (value < INT32_MIN + 1 || value > INT32_MAX - 1)) {
+                BOOST_THROW_EXCEPTION(decode_overflow_error());
+            }
+            // Binary exponents beyond this range already underflow or overflow a double.
+            if (!decimal) {
+                value = std::max(std::min(value, static_cast<__int128_t>(100000)), static_cast<__int128_t>(-100000));
+            }
+            emitFloat(mantissa, static_cast<int64_t>(value));
+            break;
+
+        case IntegerTarget::ArrayType:
+            if (value < 0 || value > MAXIMUM_ARRAY_TYPE) {
+                BOOST_THROW_EXCEPTION(decode_value_error());
+            }
+            arrayType = static_cast<ArrayType>(value);
+            state = State::TypedArrayHeader;
+            integerTarget = IntegerTarget::ArrayCount;
+            break;
+
+        case IntegerTarget::ArrayCount:
+            if (value < 0 || static_cast<uint64_t>(value) > SIZE_MAX / arrayTypeSize(arrayType)) {
+                BOOST_THROW_EXCEPTION(decode_overflow_error());
+            }
+            arrayCount = static_cast<size_t>(value);
+            chunkRemaining = arrayCount * arrayTypeSize(arrayType);
+            buffer.clear();
+            handler.onTypedArrayBegin(arrayType, arrayCount);
+            if (chunkRemaining == 0) {
+                typedArrayEnd();
+            } else {
+                state = State::TypedArray;
+            }
+            break;
+        }
+    }
+
+    /** Decode the first byte of a field.
+     */
+    inline void field(uint8_t c) {
+        switch (c) {
+        case MARK_CODE:
+            if (frames.empty()) {
+                BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+            }
+            switch (frames.back().type) {
+            case FrameType::List:
+                frames.pop_back();
+                handler.onListEnd();
+                valueEnd();
+                return;
+
+            case FrameType::Keys:
+                keysEnd();
+                return;
+
+            default:
+                BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+            }
+
+        case NONE_CODE:
+            if (isName()) {
+                name(std::string_view());
+            } else {
+                handler.onNone();
+                valueEnd();
+            }
+            return;
+
+        case TRUE_CODE:
+        case FALSE_CODE:
+            requireNotName();
+            handler.onBoolean(c == TRUE_CODE);
+            valueEnd();
+            return;
+
+        case LIST_CODE:
+            requireNotName();
+            pushFrame(FrameType::List);
+            handler.onListBegin();
+            return;
+
+        case DICTIONARY_CODE:
+            requireNotName();
+            pushFrame(FrameType::Keys);
+            handler.onDictionaryBegin(std::string_view());
+            return;
+
+        case NAMED_DICTIONARY_CODE:
+            requireNotName();
+            pushFrame(FrameType::Name);
+            return;
+
+        case BINARY_FLOAT_CODE:
+        case DECIMAL_FLOAT_CODE:
+            requireNotName();
+            decimal = c == DECIMAL_FLOAT_CODE;
+            integerTarget = IntegerTarget::Mantissa;
+            state = State::Float;
+            return;
+
+        case BYTE_ARRAY_CODE:
+            requireNotName();
+            buffer.clear();
+            state = State::ByteArrayLength;
+            return;
+
+        case UTF8_STRING_CODE:
+            buffer.clear();
+            state = State::UTF8String;
+            return;
+
+        case TYPED_ARRAY_CODE:
+            requireNotName();
+            integerTarget = IntegerTarget::ArrayType;
+            state = State::TypedArrayHeader;
+            return;
+
+        default:
+            if (c & 0x80) {
+                integerBegin(c, IntegerTarget::Value);
+            } else {
+                buffer.assign(1, static_cast<char>(c));
+                state = State::AsciiString;
+            }
+            return;
+        }
+    }
+
+    /** Decode the byte after the float code.
+     */
+    inline void floatField(uint8_t c) {
+        if (integerTarget == IntegerTarget::Mantissa) {
+            switch (c) {
+            case NONE_CODE: return emitFloat(0, DecimalFloat::EXPONENT_NAN);
+            case TRUE_CODE: return emitFloat(-1, DecimalFloat::EXPONENT_INF);
+            case FALSE_CODE: return emitFloat(1, DecimalFloat::EXPONENT_INF);
+            }
+        }
+
+        if ((c & 0x80) == 0) {
+            BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+        }
+        integerBegin(c, integerTarget);
+    }
+
+    /** Decode the first byte of the element type or count of a typed array.
+     */
+    inline void typedArrayHeaderField(uint8_t c) {
+        if ((c & 0x80) == 0) {
+            BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+        }
+        integerBegin(c, integerTarget);
+    }
+
+public:
+    /**
+     * @param handler The handler receiving the events.
+     * @param maximumDepth Maximum nesting of lists and dictionaries.
+     * @param maximumFieldSize Maximum size of a string or byte array.
+     */
+    inline RSONStreamDecoder(RSONHandler &handler, size_t maximumDepth = RSON_MAXIMUM_DEPTH, size_t maximumFieldSize = 16 * 1024 * 1024) :
+        handler(handler), maximumDepth(maximumDepth), maximumFieldSize(maximumFieldSize), state(State::Field), frames(), buffer(),
+        integerTarget(IntegerTarget::Value), integerValue(0), integerBits(0),
+        decimal(false), mantissa(0), chunkRemaining(0), lastChunk(false),
+        arrayType(ArrayType::Int8), arrayCount(0) {}
+
+    RSONStreamDecoder(const RSONStreamDecoder &other) = delete;
+    RSONStreamDecoder &operator=(const RSONStreamDecoder &other) = delete;
+
+    /** Forget a partially decoded field.
+     * The handler is told with onReset(), so that it can forget it too.
+     */
+    inline void reset(void) {
+        state = State::Field;
+        frames.clear();
+        buffer.clear();
+        handler.onReset();
+    }
+
+    /** True when no field is partially decoded.
+     */
+    inline bool idle(void) const {
+        return state == State::Field && frames.empty();
+    }
+
+    /** Decode a chunk of data.
+     * Fields may be split at any byte over multiple chunks.
+     */
+    inline void feed(const uint8_t *data, size_t size) {
+        auto p = data;
+        auto end = data + size;
+
+        while (p != end) {
+            switch (state) {
+            case State::Field:
+                field(*p++);
+                break;
+
+            case State::Float:
+                floatField(*p++);
+                break;
+
+            case State::TypedArrayHeader:
+                typedArrayHeaderField(*p++);
+                break;
+
+            case State::TypedArray:
+                {
+                    // Only an element split over two chunks is buffered.
+                    auto elementSize = arrayTypeSize(arrayType);
+                    auto n = std::min(chunkRemaining, static_cast<size_t>(end - p));
+                    chunkRemaining -= n;
+
+                    if (!buffer.empty()) {
+                        auto m = std::min(elementSize - buffer.size(), n);
+                        buffer.append(reinterpret_cast<const char *>(p), m);
+                        p += m;
+                        n -= m;
+                        if (buffer.size() == elementSize) {
+                            handler.onTypedArrayChunk(arrayType, reinterpret_cast<const uint8_t *>(buffer.data()), 1);
+                            buffer.clear();
+                        }
+                    }
+
+                    auto nrElements = n / elementSize;
+                    if (nrElements > 0) {
+                        handler.onTypedArrayChunk(arrayType, p, nrElements);
+                        p += nrElements * elementSize;
+                        n -= nrElements * elementSize;
+                    }
+                    buffer.append(reinterpret_cast<const char *>(p), n);
+                    p += n;
+
+                    if (chunkRemaining == 0) {
+                        typedArrayEnd();
+                    }
+                }
+                break;
+
+            case State::Integer:
+                {
+                    auto c = *p++;
+                    if (integerBits >= 6 + 9 * 7) {
+                        BOOST_THROW_EXCEPTION(decode_overflow_error());
+                    }
+                    integerValue |= static_cast<__uint128_t>(c & 0x7f) << integerBits;
+                    integerBits += 7;
+                    if (c & 0x80) {
+                        integerEnd();
+                    }
+                }
+                break;
+
+            case State::AsciiString:
+                {
+                    auto last = findHighBit(p, end);
+                    appendField(p, last - p);
+                    p = last;
+                    if (p != end) {
+                        auto c = static_cast<uint8_t>(*p++ & 0x7f);
+                        // A string may be terminated with a nul, as the cursor decoder does.
+                        if (c != 0) {
+                            appendField(&c, 1);
+                        }
+                        emitString();
+                    }
+                }
+                break;
+
+            case State::UTF8String:
+                {
+                    auto mark = static_cast<const uint8_t *>(memchr(p, MARK_CODE, end - p));
+                    auto last = mark ? mark : end;
+                    appendField(p, last - p);
+                    p = last;
+                    if (mark) {
+                        p++;
+                        emitString();
+                    }
+                }
+                break;
+
+            case State::ByteArrayLength:
+                chunkRemaining = *p++;
+                lastChunk = chunkRemaining < 255;
+                state = State::ByteArrayChunk;
+                // An empty last chunk completes the byte array immediately.
+                // Fall through.
+
+            case State::ByteArrayChunk:
+                {
+                    auto n = std::min(chunkRemaining, static_cast<size_t>(end - p));
+                    appendField(p, n);
+                    p += n;
+                    chunkRemaining -= n;
+
+                    if (chunkRemaining == 0) {
+                        if (lastChunk) {
+                            handler.onByteArray(std::basic_string_view<uint8_t>(
+                                reinterpret_cast<const uint8_t *>(buffer.data()), buffer.size()
+                            ));
+                            valueEnd();
+                        } else {
+                            state = State::ByteArrayLength;
+                        }
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    inline void feed(const std::string &data) {
+        feed(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+    }
+};
+
+/** A handler which builds complete values from the events.
+ * Values are built the same as the generic decode(), as boost::any holding
+ * std::map<std::string, boost::any> and std::vector<boost::any>, and
+ * typed arrays as a std::vector of their element type.
+ */
+class RSONAnyBuilder: public RSONHandler {
+    struct Frame {
+        bool isDictionary;
+        bool inValues;
+        std::vector<std::string> keys;
+        std::vector<boost::any> items;
+    };
+
+    std::vector<Frame> frames;
+    std::function<void(boost::any &&)> callback;
+
+    // The elements of the typed array being received.
+    ArrayType arrayType;
+    std::string arrayData;
+
+    inline void add(boost::any &&value) {
+        if (frames.empty()) {
+            callback(std::move(value));
+            return;
+        }
+
+        auto &frame = frames.back();
+        if (frame.isDictionary && !frame.inValues) {
+            auto key = boost::any_cast<std::string>(&value);
+            if (key == nullptr) {
+                BOOST_THROW_EXCEPTION(decode_type_error());
+            }
+            frame.keys.push_back(std::move(*key));
+        } else {
+            frame.items.push_back(std::move(value));
+        }
+    }
+
+public:
+    /**
+     * @param callback Called with each completely decoded top level value.
+     */
+    inline RSONAnyBuilder(std::function<void(boost::any &&)> callback) :
+        frames(), callback(std::move(callback)), arrayType(ArrayType::Int8), arrayData() {}
+
+    void onReset(void) override {
+        frames.clear();
+        arrayData.clear();
+    }
+
+    void onNone(void) override { add(boost::none); }
+    void onBoolean(bool value) override { add(value); }
+    void onInteger(int64_t value) override { add(value); }
+    void onFloat(double value) override { add(value); }
+    void onDecimalFloat(const DecimalFloat &value) override { add(value); }
+    void onString(std::string_view value) override { add(std::string(value)); }
+    void onByteArray(std::basic_string_view<uint8_t> value) override { add(std::basic_string<uint8_t>(value)); }
+
+    void onTypedArrayBegin(ArrayType type, size_t count) override {
+        arrayType = type;
+        arrayData.clear();
+    }
+
+    void onTypedArrayChunk(ArrayType type, const uint8_t *data, size_t count) override {
+        arrayData.append(reinterpret_cast<const char *>(data), count * arrayTypeSize(type));
+    }
+
+    void onTypedArrayEnd(void) override {
+        dispatchArrayType(arrayType, [&](auto tag) {
+            auto items = std::vector<decltype(tag)>(arrayData.size() / sizeof (tag));
+            memcpy(items.data(), arrayData.data(), arrayData.size());
+            add(std::move(items));
+        });
+    }
+
+    void onListBegin(void) override {
+        frames.push_back({false, false, {}, {}});
+    }
+
+    void onListEnd(void) override {
+        auto items = std::move(frames.back().items);
+        frames.pop_back();
+        add(std::move(items));
+    }
+
+    void onDictionaryBegin(std::string_view name) override {
+        frames.push_back({true, false, {}, {}});
+    }
+
+    void onKeysEnd(void) override {
+        frames.back().inValues = true;
+    }
+
+    void onDictionaryEnd(void) override {
+        auto &frame = frames.back();
+        auto r = std::map<std::string, boost::any>();
+        for (size_t i = 0; i < frame.keys.size(); i++) {
+            r.emplace_hint(r.end(), std::move(frame.keys[i]), std::move(frame.items[i]));
+        }
+        frames.pop_back();
+        add(std::move(r));
+    }
+};
+
+};};
@@ -0,0 +1,221 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "RSONStreamDecoder tests"
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <sstream>
+#include "RSONEncode.hpp"
+#include "RSONStreamDecoder.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+/** Records the events as text, to compare decoding with different chunking.
+ */
+class RecordingHandler: public RSONHandler {
+public:
+    stringstream events;
+
+    RecordingHandler() : events() {}
+
+    void onNone(void) override { events << "none "; }
+    void onBoolean(bool value) override { events << (value ? "true " : "false "); }
+    void onInteger(int64_t value) override { events << value << " "; }
+    void onFloat(double value) override { events << value << "f "; }
+    void onString(string_view value) override { events << "'" << value << "' "; }
+    void onByteArray(basic_string_view<uint8_t> value) override { events << "b" << value.size() << " "; }
+    void onListBegin(void) override { events << "[ "; }
+    void onListEnd(void) override { events << "] "; }
+    void onDictionaryBegin(string_view name) override { events << name << "{ "; }
+    void onKeysEnd(void) override { events << ": "; }
+    void onDictionaryEnd(void) override { events << "} "; }
+    void onFieldEnd(void) override { events << "; "; }
+};
+
+static string testMessage(void)
+{
+    auto r = string();
+    r += NAMED_DICTIONARY_CODE;
+    encode(r, string("Service"));
+    encode(r, string("bytes"));
+    encode(r, string("empty"));
+    encode(r, string("floats"));
+    encode(r, string("integers"));
+    encode(r, string("samples"));
+    encode(r, string("strings"));
+    r += MARK_CODE;
+    encode(r, basic_string<uint8_t>(600, 0x55));
+    encode(r, map<string, int32_t>());
+    encode(r, vector<double>{0.0, 0.5, 3.0, numeric_limits<double>::infinity()});
+    encode(r, vector<int64_t>{0, -1, 1000000, numeric_limits<int64_t>::min(), numeric_limits<int64_t>::max()});
+    encode(r, typedArray(vector<int16_t>{-3, 300, 7}));
+    encode(r, vector<string>{"", "a", "hello", "caf\xc3\xa9"});
+    return r;
+}
+
+BOOST_AUTO_TEST_CASE(StreamEvents)
+{
+    RecordingHandler handler;
+    RSONStreamDecoder decoder(handler);
+
+    decoder.feed(encode(map<string, vector<int32_t>>{{"a", {1, 2}}, {"b", {}}}));
+    decoder.feed(encode(string("x")));
+    BOOST_CHECK_EQUAL(handler.events.str(), "{ 'a' 'b' : [ 1 2 ] [ ] } ; 'x' ; ");
+
+    // Typed arrays are passed as lists by default.
+    decoder.feed(encode(typedArray(vector<float>{1.5f, -2.0f})));
+    decoder.feed(encode(typedArray(vector<uint8_t>{})));
+    BOOST_CHECK_EQUAL(handler.events.str(), "{ 'a' 'b' : [ 1 2 ] [ ] } ; 'x' ; [ 1.5f -2f ] ; [ ] ; ");
+    BOOST_CHECK(decoder.idle());
+
+    // A nul terminator is dropped, the same as the cursor decoder does.
+    RecordingHandler nulHandler;
+    RSONStreamDecoder nulDecoder(nulHandler);
+    auto terminated = string("ab\x80", 3);
+    nulDecoder.feed(terminated);
+    BOOST_CHECK_EQUAL(nulHandler.events.str(), "'" + decode<string>(terminated) + "' ; ");
+    BOOST_CHECK_EQUAL(nulHandler.events.str(), "'ab' ; ");
+}
+
+/** Collects the elements of typed arrays, and counts the chunks they arrive in.
+ */
+class TypedArrayHandler: public RSONHandler {
+public:
+    vector<int32_t> elements;
+    size_t nrChunks;
+
+    TypedArrayHandler() : elements(), nrChunks(0) {}
+
+    void onTypedArrayChunk(ArrayType type, const uint8_t *data, size_t count) override {
+        nrChunks++;
+        forEachArrayElement(type, data, count, [this](auto value) { elements.push_back(static_cast<int32_t>(value)); });
+    }
+};
+
+BOOST_AUTO_TEST_CASE(StreamTypedArrayChunks)
+{
+    auto values = vector<int32_t>();
+    for (int32_t i = 0; i < 1000; i++) {
+        values.push_back(i * 65537 - 500);
+    }
+    auto message = encode(typedArray(values));
+
+    // Elements are passed on as they arrive, instead of buffering the array.
+    TypedArrayHandler handler;
+    RSONStreamDecoder decoder(handler);
+    for (size_t i = 0; i < message.size(); i += 7) {
+        decoder.feed(message.substr(i, 7));
+    }
+    BOOST_CHECK(handler.elements == values);
+    BOOST_CHECK(handler.nrChunks > values.size() / 2);
+    BOOST_CHECK(decoder.idle());
+}
+
+BOOST_AUTO_TEST_CASE(StreamChunks)
+{
+    auto message = testMessage();
+
+    RecordingHandler wholeHandler;
+    RSONStreamDecoder whole(wholeHandler);
+    whole.feed(message);
+    auto expected = wholeHandler.events.str();
+    BOOST_CHECK(expected.substr(0, 9) == "Service{ ");
+
+    // Split the message at every position in two chunks.
+    for (size_t split = 0; split <= message.size(); split++) {
+        RecordingHandler handler;
+        RSONStreamDecoder decoder(handler);
+        decoder.feed(message.substr(0, split));
+        BOOST_CHECK(decoder.idle() == (split == 0 || split == message.size()));
+        decoder.feed(message.substr(split));
+        BOOST_CHECK_EQUAL(handler.events.str(), expected);
+    }
+
+    // One byte at a time.
+    RecordingHandler handler;
+    RSONStreamDecoder decoder(handler);
+    for (auto c: message) {
+        decoder.feed(string(1, c));
+    }
+    BOOST_CHECK_EQUAL(handler.events.str(), expected);
+}
+
+BOOST_AUTO_TEST_CASE(StreamBuilder)
+{
+    auto message = testMessage();
+
+    auto values = vector<any>();
+    RSONAnyBuilder builder([&](any &&value) { values.push_back(move(value)); });
+    RSONStreamDecoder decoder(builder);
+
+    for (size_t i = 0; i < message.size(); i += 7) {
+        decoder.feed(message.substr(i, 7));
+    }
+    decoder.feed(encode(static_cast<int64_t>(42)));
+
+    BOOST_CHECK_EQUAL(values.size(), 2);
+    auto dictionary = any_cast<map<string, any>>(values[0]);
+    BOOST_CHECK_EQUAL(any_cast<basic_string<uint8_t>>(dictionary["bytes"]).size(), 600);
+    BOOST_CHECK((any_cast<map<string, any>>(dictionary["empty"]).empty()));
+    BOOST_CHECK_EQUAL(any_cast<double>(any_cast<vector<any>>(dictionary["floats"])[2]), 3.0);
+    BOOST_CHECK_EQUAL(any_cast<int64_t>(any_cast<vector<any>>(dictionary["integers"])[3]), numeric_limits<int64_t>::min());
+    BOOST_CHECK(any_cast<vector<int16_t>>(dictionary["samples"]) == vector<int16_t>({-3, 300, 7}));
+    BOOST_CHECK_EQUAL(any_cast<string>(any_cast<vector<any>>(dictionary["strings"])[3]), "caf\xc3\xa9");
+    BOOST_CHECK_EQUAL(any_cast<int64_t>(values[1]), 42);
+}
+
+BOOST_AUTO_TEST_CASE(StreamErrors)
+{
+    RSONHandler handler;
+    RSONStreamDecoder decoder(handler, 2);
+
+    BOOST_CHECK_THROW(decoder.feed(string("\x13\x13\x13")), decode_overflow_error);
+    decoder.reset();
+    BOOST_CHECK_THROW(decoder.feed(string("\x00", 1)), decode_code_error);
+    decoder.reset();
+    BOOST_CHECK_THROW(decoder.feed(string("\x1a\xc1")), decode_type_error);
+    decoder.reset();
+    BOOST_CHECK_THROW(decoder.feed(string(11, '\x00').insert(0, "\x80") + "\x80"), decode_overflow_error);
+}
+
+BOOST_AUTO_TEST_CASE(StreamReset)
+{
+    auto values = vector<any>();
+    RSONAnyBuilder builder([&](any &&value) { values.push_back(move(value)); });
+    RSONStreamDecoder decoder(builder, RSON_MAXIMUM_DEPTH, 16);
+
+    // After an error inside a list, the builder forgets the list too.
+    BOOST_CHECK_THROW(decoder.feed(string("\x13\x13\x1a\xc1")), decode_type_error);
+    decoder.reset();
+    decoder.feed(encode(vector<int64_t>{1, 2}));
+    BOOST_REQUIRE_EQUAL(values.size(), 1);
+    BOOST_CHECK(any_cast<vector<any>>(values[0]).size() == 2);
+
+    // Strings and byte arrays are buffered up to the maximum field size.
+    decoder.feed(encode(string(16, 'x')));
+    BOOST_CHECK_THROW(decoder.feed(encode(string(17, 'x'))), decode_overflow_error);
+    decoder.reset();
+    BOOST_CHECK_THROW(decoder.feed(encode(string(17, 'x') + "\xc3\xa9")), decode_overflow_error);
+    decoder.reset();
+    BOOST_CHECK_THROW(decoder.feed(encode(basic_string<uint8_t>(17, 0x55))), decode_overflow_error);
+    decoder.reset();
+    decoder.feed(encode(basic_string<uint8_t>(16, 0x55)));
+    BOOST_CHECK_EQUAL(values.size(), 3);
+}
@@ -0,0 +1,518 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <boost/exception/all.hpp>
+
+#include "RSON.hpp"
+#include "RSONDecode.hpp"
+#include "DecimalFloat.hpp"
+
+namespace Orion {
+namespace Rigel {
+
+/** A bump allocator for decoded messages.
+ * Memory is allocated from large blocks and is only freed all at once with
+ * reset(), which keeps the first block to be reused for the next message.
+ */
+class RSONArena {
+    std::vector<std::unique_ptr<uint8_t[]>> blocks;
+    size_t blockSize;
+    size_t firstBlockSize;
+    uint8_t *ptr;
+    uint8_t *end;
+
+    inline void addBlock(size_t size) {
+        auto newSize = std::max(size, blockSize);
+        blocks.emplace_back(new uint8_t[newSize]);
+        if (blocks.size() == 1) {
+            firstBlockSize = newSize;
+        }
+        ptr = blocks.back().get();
+        end = ptr + newSize;
+    }
+
+    static inline uint8_t *align(uint8_t *p, size_t alignment) {
+        return reinterpret_cast<uint8_t *>((reinterpret_cast<uintptr_t>(p) + alignment - 1) & ~(alignment - 1));
+    }
+
+public:
+    inline RSONArena(size_t blockSize = 4096) :
+        blocks(), blockSize(blockSize), firstBlockSize(0), ptr(nullptr), end(nullptr) {}
+
+    RSONArena(const RSONArena &other) = delete;
+    RSONArena &operator=(const RSONArena &other) = delete;
+
+    /** Allocate uninitialized memory.
+     *
+     * @param size Number of bytes to allocate.
+     * @param alignment Alignment of the memory, a power of two.
+     */
+    inline void *allocate(size_t size, size_t alignment) {
+        if (unlikely(ptr == nullptr || size + alignment > static_cast<size_t>(end - ptr))) {
+            addBlock(size + alignment);
+        }
+
+        auto p = align(ptr, alignment);
+        ptr = p + size;
+        return p;
+    }
+
+    template<typename T>
+    inline T *allocate(size_t nrItems) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena items are never destructed");
+        return static_cast<T *>(allocate(nrItems * sizeof (T), alignof(T)));
+    }
+
+    /** Free all memory allocated from the arena.
+     */
+    inline void reset(void) {
+        if (blocks.size() > 1) {
+            blocks.erase(blocks.begin() + 1, blocks.end());
+        }
+        if (blocks.empty()) {
+            ptr = end = nullptr;
+        } else {
+            ptr = blocks.front().get();
+            end = ptr + firstBlockSize;
+        }
+    }
+};
+
+/** Types of a RSONValue, in canonical sort order.
+ */
+enum class RSONValueType : uint8_t {
+    None,
+    Boolean,
+    Integer,
+    Float,
+    Decimal,
+    String,
+    ByteArray,
+    List,
+    Dictionary
+};
+
+/** A decoded RSON value.
+ * A value is 16 bytes; scalars and strings up to 8 bytes are stored inside
+ * the value, a decimal float keeps its mantissa and exponent, longer strings and the items of lists and dictionaries are
+ * stored in an RSONArena.
+ *
+ * The items of a dictionary are stored as all keys followed by all values.
+ * RSON requires keys to be sorted, so lookups use binary search.
+ */
+class RSONValue {
+    RSONValueType tag;
+    union {
+        uint32_t count;
+        int32_t exponent;
+    };
+    union {
+        bool boolean;
+        int64_t integer;
+        double real;
+        char small[8];
+        const char *chars;
+        const uint8_t *bytes;
+        const RSONValue *items;
+    };
+
+    /** The size of a string, byte array or container, which must fit in count.
+     */
+    static inline uint32_t checkedCount(size_t size) {
+        if (unlikely(size > UINT32_MAX)) {
+            BOOST_THROW_EXCEPTION(decode_overflow_error());
+        }
+        return static_cast<uint32_t>(size);
+    }
+
+public:
+    static const size_t SMALL_STRING_SIZE = sizeof (small);
+
+    inline RSONValue(void) : tag(RSONValueType::None), count(0), integer(0) {}
+
+    RSONValue(const RSONValue &other) = default;
+    RSONValue &operator=(const RSONValue &other) = default;
+
+    static inline RSONValue fromBool(bool value) {
+        auto r = RSONValue();
+        r.tag = RSONValueType::Boolean;
+        r.boolean = value;
+        return r;
+    }
+
+    static inline RSONValue fromInteger(int64_t value) {
+        auto r = RSONValue();
+        r.tag = RSONValueType::Integer;
+        r.integer = value;
+        return r;
+    }
+
+    static inline RSONValue fromFloat(double value) {
+        auto r = RSONValue();
+        r.tag = RSONValueType::Float;
+        r.real = value;
+        return r;
+    }
+
+    static inline RSONValue fromDecimal(const DecimalFloat &value) {
+        auto r = RSONValue();
+        r.tag = RSONValueType::Decimal;
+        r.integer = value.mantissa;
+        r.exponent = value.exponent;
+        return r;
+    }
+
+    /** A string, which is copied in the value or in the arena.
+     */
+    static inline RSONValue fromString(const char *data, size_t size, RSONArena &arena) {
+        auto r = RSONValue();
+        r.tag = RSONValueType::String;
+        r.count = checkedCount(size);
+        if (size <= SMALL_STRING_SIZE) {
+            memcpy(r.small, data, size);
+        } else {
+            auto p = arena.allocate<char>(size);
+            memcpy(p, data, size);
+            r.chars = p;
+        }
+        return r;
+    }
+
+    /** An ASCII string, which is copied in the value or in the arena
+     * with the stop-bit removed from its last character.
+     *
+     * @param data The first character of the encoded string.
+     * @param last The last character, which carries the stop-bit.
+     */
+    static inline RSONValue fromASCIIString(const uint8_t *data, const uint8_t *last, RSONArena &arena) {
+        auto lastChar = static_cast<char>(*last & 0x7f);
+        auto size = static_cast<size_t>(last - data) + (lastChar != 0);
+
+        auto r = RSONValue();
+        r.tag = RSONValueType::String;
+        r.count = checkedCount(size);
+        auto p = size <= SMALL_STRING_SIZE ? r.small : arena.allocate<char>(size);
+        memcpy(p, data, last - data);
+        if (lastChar) {
+            p[size - 1] = lastChar;
+        }
+        if (size > SMALL_STRING_SIZE) {
+            r.chars = p;
+        }
+        return r;
+    }
+
+    static inline RSONValue fromByteArray(const uint8_t *data, size_t size) {
+        auto r = RSONValue();
+        r.tag = RSONValueType::ByteArray;
+        r.count = checkedCount(size);
+        r.bytes = data;
+        return r;
+    }
+
+    /**
+     * @param items Items in the arena; for a dictionary all keys followed by all values.
+     * @param size Number of items in a list, or key/value pairs in a dictionary.
+     */
+    static inline RSONValue fromItems(RSONValueType type, const RSONValue *items, size_t size) {
+        auto r = RSONValue();
+        r.tag = type;
+        r.count = checkedCount(size);
+        r.items = items;
+        return r;
+    }
+
+    inline RSONValueType type(void) const {
+        return tag;
+    }
+
+    inline bool isNone(void) const {
+        return tag == RSONValueType::None;
+    }
+
+    inline void requireType(RSONValueType type) const {
+        if (tag != type) {
+            BOOST_THROW_EXCEPTION(decode_type_error());
+        }
+    }
+
+    inline bool asBool(void) const {
+        requireType(RSONValueType::Boolean);
+        return boolean;
+    }
+
+    inline int64_t asInteger(void) const {
+        requireType(RSONValueType::Integer);
+        return integer;
+    }
+
+    inline double asFloat(void) const {
+        if (tag == RSONValueType::Integer) {
+            return static_cast<double>(integer);
+        }
+        if (tag == RSONValueType::Decimal) {
+            return asDecimal().toDouble();
+        }
+        requireType(RSONValueType::Float);
+        return real;
+    }
+
+    inline DecimalFloat asDecimal(void) const {
+        requireType(RSONValueType::Decimal);
+        auto r = DecimalFloat();
+        r.mantissa = integer;
+        r.exponent = exponent;
+        return r;
+    }
+
+    /** The string, which is only valid while the value and its arena are alive.
+     */
+    inline std::string_view asString(void) const {
+        requireType(RSONValueType::String);
+        return std::string_view(count <= SMALL_STRING_SIZE ? small : chars, count);
+    }
+
+    inline std::basic_string_view<uint8_t> asByteArray(void) const {
+        requireType(RSONValueType::ByteArray);
+        return std::basic_string_view<uint8_t>(bytes, count);
+    }
+
+    /** The number of items in a list, or key/value pairs in a dictionary.
+     */
+    inline size_t size(void) const {
+        if (tag != RSONValueType::List && tag != RSONValueType::Dictionary) {
+            BOOST_THROW_EXCEPTION(decode_type_error());
+        }
+        return count;
+    }
+
+    /** Get an item from a list, or a value from a dictionary by position.
+     */
+    inline const RSONValue &operator[](size_t index) const {
+        if (index >= size()) {
+            BOOST_THROW_EXCEPTION(decode_index_error() << index_info(index));
+        }
+        return tag == RSONValueType::List ? items[index] : items[count + index];
+    }
+
+    /** Get a key from a dictionary by position.
+     */
+    inline const RSONValue &key(size_t index) const {
+        requireType(RSONValueType::Dictionary);
+        if (index >= count) {
+            BOOST_THROW_EXCEPTION(decode_index_error() << index_info(index));
+        }
+        return items[index];
+    }
+
+    /** Find a value in a dictionary by its string key.
+     *
+     * @return The value, or nullptr when the key is not found.
+     */
+    inline const RSONValue *find(std::string_view key) const {
+        requireType(RSONValueType::Dictionary);
+
+        // Keys of other types sort either before or after all strings.
+        size_t lo = 0;
+        size_t hi = count;
+        while (lo < hi) {
+            auto mid = (lo + hi) / 2;
+            auto &k = items[mid];
+            if (k.tag < RSONValueType::String || (k.tag == RSONValueType::String && k.asString() < key)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        if (lo < count && items[lo].tag == RSONValueType::String && items[lo].asString() == key) {
+            return &items[count + lo];
+        }
+        return nullptr;
+    }
+
+    inline bool contains(std::string_view key) const {
+        return find(key) != nullptr;
+    }
+
+    inline const RSONValue &operator[](std::string_view key) const {
+        auto r = find(key);
+        if (r == nullptr) {
+            BOOST_THROW_EXCEPTION(decode_key_error() << key_info(std::string(key)));
+        }
+        return *r;
+    }
+};
+
+static_assert(sizeof (RSONValue) == 16, "RSONValue should be compact");
+static_assert(std::is_trivially_copyable<RSONValue>::value, "RSONValue is copied with memcpy");
+
+/** Decode a field into a RSONValue.
+ * Items of lists and dictionaries are collected on a stack, and copied
+ * into a contiguous array in the arena when the container is complete.
+ * Nesting lists and dictionaries deeper than maximumDepth throws decode_overflow_error.
+ */
+static inline RSONValue decodeValue(RSONCursor &cursor, RSONArena &arena, std::vector<RSONValue> &stack, size_t maximumDepth)
+{
+    switch (auto t = peekType(cursor)) {
+    case Type::None:
+        cursor.ptr++;
+        return RSONValue();
+
+    case Type::Boolean:
+        return RSONValue::fromBool(decode<bool>(cursor));
+
+    case Type::Integer:
+        return RSONValue::fromInteger(decode<int64_t>(cursor));
+
+    case Type::BinaryFloat:
+        return RSONValue::fromFloat(decode<double>(cursor));
+
+    case Type::DecimalFloat:
+        return RSONValue::fromDecimal(decode<DecimalFloat>(cursor));
+
+    case Type::String:
+        if (*cursor.ptr == UTF8_STRING_CODE) {
+            // UTF-8 strings are copied without decoding.
+            auto start = cursor.ptr + 1;
+            auto mark = skipMark(cursor);
+            return RSONValue::fromString(reinterpret_cast<const char *>(start), mark - start, arena);
+        } else {
+            // ASCII strings are copied straight into the arena.
+            auto start = cursor.ptr;
+            auto last = skipStopBit(cursor);
+            return RSONValue::fromASCIIString(start, last, arena);
+        }
+
+    case Type::ByteArray:
+        {
+            // All chunks but the last hold 255 bytes, so the size follows
+            // from the encoded length and the chunks are copied straight
+            // into the arena.
+            auto start = ++cursor.ptr;
+            skipChunks(cursor);
+            auto encodedSize = static_cast<size_t>(cursor.ptr - start) - 1;
+            auto size = encodedSize - encodedSize / 256;
+
+            auto p = arena.allocate<uint8_t>(size);
+            auto q = p;
+            for (auto chunk = start; chunk != cursor.ptr; chunk += 1 + *chunk) {
+                memcpy(q, chunk + 1, *chunk);
+                q += *chunk;
+            }
+            return RSONValue::fromByteArray(p, size);
+        }
+
+    case Type::List:
+        {
+            enterContainer(maximumDepth);
+            auto base = stack.size();
+
+            cursor.ptr++;
+            while (cursor.peek() != MARK_CODE) {
+                stack.push_back(decodeValue(cursor, arena, stack, maximumDepth - 1));
+            }
+            cursor.ptr++;
+
+            auto size = stack.size() - base;
+            auto items = arena.allocate<RSONValue>(size);
+            memcpy(static_cast<void *>(items), stack.data() + base, size * sizeof (RSONValue));
+            stack.resize(base);
+            return RSONValue::fromItems(RSONValueType::List, items, size);
+        }
+
+    case Type::TypedArray:
+        {
+            // The elements become the items of a list.
+            size_t count;
+            auto type = decodeTypedArrayHeader(cursor, count);
+            auto items = arena.allocate<RSONValue>(count);
+            auto item = items;
+            forEachArrayElement(type, cursor.ptr, count, [&item](auto value) {
+                if constexpr (std::is_floating_point<decltype(value)>::value) {
+                    *item++ = RSONValue::fromFloat(value);
+                } else {
+                    *item++ = RSONValue::fromInteger(value);
+                }
+            });
+            cursor.ptr += count * arrayTypeSize(type);
+            return RSONValue::fromItems(RSONValueType::List, items, count);
+        }
+
+    case Type::Dictionary:
+        {
+            enterContainer(maximumDepth);
+            auto base = stack.size();
+
+            getDictionaryCode(cursor);
+            while (cursor.peek() != MARK_CODE) {
+                stack.push_back(decodeValue(cursor, arena, stack, maximumDepth - 1));
+            }
+            cursor.ptr++;
+
+            auto size = stack.size() - base;
+            for (size_t i = 0; i < size; i++) {
+                stack.push_back(decodeValue(cursor, arena, stack, maximumDepth - 1));
+            }
+
+            auto items = arena.allocate<RSONValue>(size * 2);
+            memcpy(static_cast<void *>(items), stack.data() + base, size * 2 * sizeof (RSONValue));
+            stack.resize(base);
+            return RSONValue::fromItems(RSONValueType::Dictionary, items, size);
+        }
+
+    case Type::EndOfFile:
+        BOOST_THROW_EXCEPTION(decode_eof_error());
+
+    default:
+        BOOST_THROW_EXCEPTION(decode_type_error() << type_info(t));
+    }
+}
+
+/** Decode a field into a RSONValue.
+ * All memory for the value is allocated from the arena, the value stays
+ * valid until the arena is reset.
+ *
+ * @param cursor Cursor pointing to the field, on return it points just after the field.
+ * @param arena The arena to allocate from.
+ * @param maximumDepth Maximum nesting of lists and dictionaries.
+ * @return The decoded value.
+ */
+static inline RSONValue decodeValue(RSONCursor &cursor, RSONArena &arena, size_t maximumDepth = RSON_MAXIMUM_DEPTH)
+{
+    // The stack keeps its memory between messages.
+    static thread_local std::vector<RSONValue> stack;
+
+    stack.clear();
+    return decodeValue(cursor, arena, stack, maximumDepth);
+}
+
+static inline RSONValue decodeValue(const std::string &str, RSONArena &arena, size_t maximumDepth = RSON_MAXIMUM_DEPTH)
+{
+    auto cursor = RSONCursor(str);
+    return decodeValue(cursor, arena, maximumDepth);
+}
+
+};};
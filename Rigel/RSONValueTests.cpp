@@ -0,0 +1,129 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "RSONValue tests"
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include "RSONEncode.hpp"
+#include "RSONValue.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+BOOST_AUTO_TEST_CASE(ValueScalar)
+{
+    RSONArena arena;
+
+    BOOST_CHECK(decodeValue(encode(boost::none), arena).isNone());
+    BOOST_CHECK_EQUAL(decodeValue(encode(true), arena).asBool(), true);
+    BOOST_CHECK_EQUAL(decodeValue(encode(static_cast<int64_t>(-12345)), arena).asInteger(), -12345);
+    BOOST_CHECK_EQUAL(decodeValue(encode(0.5), arena).asFloat(), 0.5);
+    BOOST_CHECK_THROW(decodeValue(encode(0.5), arena).asInteger(), decode_type_error);
+
+    // Decimal floats keep their mantissa and exponent.
+    auto price = decodeValue(encode(DecimalFloat(19999, -2)), arena);
+    BOOST_CHECK(price.type() == RSONValueType::Decimal);
+    BOOST_CHECK(price.asDecimal() == DecimalFloat(19999, -2));
+    BOOST_CHECK_EQUAL(price.asFloat(), 199.99);
+    BOOST_CHECK(decodeValue(encode(DecimalFloat(1, 1000)), arena).asDecimal() == DecimalFloat(1, 1000));
+    BOOST_CHECK(decodeValue(encode(DecimalFloat::infinity(true)), arena).asDecimal() == DecimalFloat::infinity(true));
+    BOOST_CHECK(decodeValue(encode(DecimalFloat::quiet_NaN()), arena).asDecimal().isNaN());
+    BOOST_CHECK_THROW(decodeValue(encode(0.5), arena).asDecimal(), decode_type_error);
+
+    for (auto size: {0, 1, 254, 255, 256, 510, 511, 1000}) {
+        auto bytes = basic_string<uint8_t>();
+        for (int i = 0; i < size; i++) {
+            bytes.push_back(static_cast<uint8_t>(i));
+        }
+        BOOST_CHECK(decodeValue(encode(bytes), arena).asByteArray() == bytes);
+    }
+
+    // Sizes of 4 GiB and more do not fit in a value.
+    auto tooLarge = static_cast<size_t>(UINT32_MAX) + 1;
+    BOOST_CHECK_THROW(RSONValue::fromByteArray(nullptr, tooLarge), decode_overflow_error);
+    BOOST_CHECK_THROW(RSONValue::fromItems(RSONValueType::List, nullptr, tooLarge), decode_overflow_error);
+    BOOST_CHECK_EQUAL(RSONValue::fromByteArray(nullptr, UINT32_MAX).asByteArray().size(), UINT32_MAX);
+}
+
+BOOST_AUTO_TEST_CASE(ValueString)
+{
+    RSONArena arena;
+
+    for (auto value: {string(""), string("a"), string("12345678"), string("123456789"), string("caf\xc3\xa9"), string(100, 'x')}) {
+        auto r = decodeValue(encode(value), arena);
+        BOOST_CHECK_EQUAL(r.asString(), value);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ValueContainers)
+{
+    RSONArena arena(64);
+
+    auto buffer = string();
+    buffer += DICTIONARY_CODE;
+    encode(buffer, static_cast<int64_t>(5));
+    encode(buffer, string("address"));
+    encode(buffer, string("listeners"));
+    encode(buffer, string("port"));
+    buffer += MARK_CODE;
+    encode(buffer, string("integer key"));
+    encode(buffer, string("10.0.0.1"));
+    encode(buffer, vector<vector<int32_t>>{{1, 2}, {}, {3}});
+    encode(buffer, static_cast<int64_t>(4000));
+
+    auto r = decodeValue(buffer, arena);
+    BOOST_CHECK(r.type() == RSONValueType::Dictionary);
+    BOOST_CHECK_EQUAL(r.size(), 4);
+    BOOST_CHECK_EQUAL(r.key(0).asInteger(), 5);
+    BOOST_CHECK_EQUAL(r[0].asString(), "integer key");
+    BOOST_CHECK_EQUAL(r["address"].asString(), "10.0.0.1");
+    BOOST_CHECK_EQUAL(r["port"].asInteger(), 4000);
+    BOOST_CHECK_EQUAL(r["listeners"].size(), 3);
+    BOOST_CHECK_EQUAL(r["listeners"][0][1].asInteger(), 2);
+    BOOST_CHECK_EQUAL(r["listeners"][1].size(), 0);
+    BOOST_CHECK_EQUAL(r["listeners"][2][0].asInteger(), 3);
+    BOOST_CHECK(!r.contains("aaa"));
+    BOOST_CHECK(!r.contains("zzz"));
+    BOOST_CHECK_THROW(r["protocol"], decode_key_error);
+    BOOST_CHECK_THROW(r["listeners"][3], decode_index_error);
+
+    // After a reset the memory is reused for the next message.
+    arena.reset();
+    auto list = decodeValue(encode(vector<string>{"hello", "world", string(20, 'y')}), arena);
+    BOOST_CHECK_EQUAL(list.size(), 3);
+    BOOST_CHECK_EQUAL(list[2].asString(), string(20, 'y'));
+
+    // Nesting is limited, so that a message of only list codes can not exhaust the stack.
+    BOOST_CHECK_THROW(decodeValue(string(4 * 1024 * 1024, LIST_CODE), arena), decode_overflow_error);
+    BOOST_CHECK_EQUAL(decodeValue(string(3, LIST_CODE) + string(3, MARK_CODE), arena, 3)[0][0].size(), 0);
+    BOOST_CHECK_THROW(decodeValue(string(3, LIST_CODE) + string(3, MARK_CODE), arena, 2), decode_overflow_error);
+}
+
+BOOST_AUTO_TEST_CASE(ValueTypedArray)
+{
+    RSONArena arena(64);
+
+    auto r = decodeValue(encode(typedArray(vector<uint16_t>{1, 65535, 3})), arena);
+    BOOST_CHECK(r.type() == RSONValueType::List);
+    BOOST_CHECK_EQUAL(r.size(), 3);
+    BOOST_CHECK_EQUAL(r[1].asInteger(), 65535);
+
+    auto f = decodeValue(encode(typedArray(vector<double>{0.5, -2.0})), arena);
+    BOOST_CHECK_EQUAL(f[1].asFloat(), -2.0);
+}
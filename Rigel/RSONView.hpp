@@ -0,0 +1,288 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <boost/exception/all.hpp>
+
+#include "RSON.hpp"
+#include "RSONDecode.hpp"
+
+namespace Orion {
+namespace Rigel {
+
+/** Compare an encoded string with a key, without decoding the string.
+ *
+ * @param cursor Cursor pointing to an encoded string, on return
+ *               it points just after the string.
+ * @param key The key to compare with.
+ * @return -1, 0 or 1 when the encoded string is less, equal or greater than key.
+ */
+static inline int compareString(RSONCursor &cursor, std::string_view key)
+{
+    auto c = cursor.get();
+    int r = 0;
+    size_t i = 0;
+
+    if (c == UTF8_STRING_CODE) {
+        while ((c = cursor.get()) != MARK_CODE) {
+            if (r == 0) {
+                r = (i == key.size()) ? 1 : static_cast<int>(c) - static_cast<uint8_t>(key[i]);
+            }
+            i++;
+        }
+
+    } else if (c >= 0x80 || (c >= 0x10 && c <= 0x1a)) {
+        BOOST_THROW_EXCEPTION(decode_code_error() << code_info(c));
+
+    } else {
+        while (true) {
+            auto stop = (c & 0x80) > 0;
+            c &= 0x7f;
+
+            // A single character string may be terminated with a nul.
+            if (c != 0 && r == 0) {
+                r = (i == key.size()) ? 1 : static_cast<int>(c) - static_cast<uint8_t>(key[i]);
+            }
+            i += (c != 0);
+
+            if (stop) {
+                break;
+            }
+            c = cursor.get();
+        }
+    }
+
+    if (r == 0 && i < key.size()) {
+        r = -1;
+    }
+    return (r > 0) - (r < 0);
+}
+
+/** A lazy view on an RSON encoded field.
+ *
+ * The view does not decode anything until a value is requested with as<T>().
+ * Indexing into lists and dictionaries skips over the fields that are not
+ * needed, without allocating memory.
+ *
+ * The view does not own the buffer, which must stay alive while the view,
+ * or any view derived from it, is in use.
+ */
+class RSONView {
+    const uint8_t *ptr;
+    const uint8_t *end;
+
+public:
+    inline RSONView(const uint8_t *data, size_t size) :
+        ptr(data), end(data + size) {}
+
+    explicit inline RSONView(const RSONCursor &cursor) :
+        ptr(cursor.ptr), end(cursor.end) {}
+
+    explicit inline RSONView(const std::string &str) :
+        RSONView(reinterpret_cast<const uint8_t *>(str.data()), str.size()) {}
+
+    RSONView(const RSONView &other) = default;
+    RSONView &operator=(const RSONView &other) = default;
+
+    /** A cursor pointing to the start of the field.
+     */
+    inline RSONCursor cursor(void) const {
+        return RSONCursor(ptr, end - ptr);
+    }
+
+    inline Type type(void) const {
+        return peekType(cursor());
+    }
+
+    /** The number of bytes the field occupies.
+     */
+    inline size_t length(void) const {
+        auto c = cursor();
+        skip(c);
+        return c.ptr - ptr;
+    }
+
+    /** Decode the field.
+     */
+    template<typename T>
+    inline T as(void) const {
+        auto c = cursor();
+        return decode<T>(c);
+    }
+
+    /** The number of items in a list, or key/value pairs in a dictionary.
+     */
+    inline size_t size(void) const {
+        auto c = cursor();
+        size_t r = 0;
+
+        auto code = getDictionaryCode(c);
+        if (code != LIST_CODE && code != DICTIONARY_CODE) {
+            BOOST_THROW_EXCEPTION(decode_code_error() << code_info(code));
+        }
+
+        while (c.peek() != MARK_CODE) {
+            skip(c);
+            r++;
+        }
+        return r;
+    }
+
+    /** Get an item from a list, or a value from a dictionary by position.
+     *
+     * @param index The position of the item.
+     * @return A view on the item.
+     */
+    inline RSONView operator[](size_t index) const {
+        auto c = cursor();
+
+        auto code = getDictionaryCode(c);
+        if (code == LIST_CODE) {
+            for (size_t i = 0; i < index; i++) {
+                if (c.peek() == MARK_CODE) {
+                    BOOST_THROW_EXCEPTION(decode_index_error() << index_info(index));
+                }
+                skip(c);
+            }
+            if (c.peek() == MARK_CODE) {
+                BOOST_THROW_EXCEPTION(decode_index_error() << index_info(index));
+            }
+            return RSONView(c);
+
+        } else if (code == DICTIONARY_CODE) {
+            size_t nrKeys = 0;
+            while (c.peek() != MARK_CODE) {
+                skip(c);
+                nrKeys++;
+            }
+            c.ptr++;
+
+            if (index >= nrKeys) {
+                BOOST_THROW_EXCEPTION(decode_index_error() << index_info(index));
+            }
+            for (size_t i = 0; i < index; i++) {
+                skip(c);
+            }
+            return RSONView(c);
+
+        } else {
+            BOOST_THROW_EXCEPTION(decode_code_error() << code_info(code));
+        }
+    }
+
+    /** Get a key from a dictionary by position.
+     *
+     * @param index The position of the key.
+     * @return A view on the key.
+     */
+    inline RSONView key(size_t index) const {
+        auto c = cursor();
+
+        auto code = getDictionaryCode(c);
+        if (code != DICTIONARY_CODE) {
+            BOOST_THROW_EXCEPTION(decode_code_error() << code_info(code));
+        }
+
+        for (size_t i = 0; i < index; i++) {
+            if (c.peek() == MARK_CODE) {
+                BOOST_THROW_EXCEPTION(decode_index_error() << index_info(index));
+            }
+            skip(c);
+        }
+        if (c.peek() == MARK_CODE) {
+            BOOST_THROW_EXCEPTION(decode_index_error() << index_info(index));
+        }
+        return RSONView(c);
+    }
+
+    /** Find the position of a string key in a dictionary.
+     *
+     * @param key The key to search for.
+     * @param index On success the position of the key.
+     * @return true if the key was found.
+     */
+    inline bool find(std::string_view key, size_t &index) const {
+        auto c = cursor();
+
+        auto code = getDictionaryCode(c);
+        if (code != DICTIONARY_CODE) {
+            BOOST_THROW_EXCEPTION(decode_code_error() << code_info(code));
+        }
+
+        for (size_t i = 0; c.peek() != MARK_CODE; i++) {
+            if (peekType(c) != Type::String) {
+                skip(c);
+                continue;
+            }
+
+            auto r = compareString(c, key);
+            if (r == 0) {
+                index = i;
+                return true;
+            } else if (r > 0) {
+                // Keys are sorted, so the key can not follow.
+                return false;
+            }
+        }
+        return false;
+    }
+
+    inline bool contains(std::string_view key) const {
+        size_t index;
+        return find(key, index);
+    }
+
+    /** Get a value from a dictionary by its string key.
+     *
+     * @param key The key of the value.
+     * @return A view on the value.
+     */
+    inline RSONView operator[](std::string_view key) const {
+        auto c = cursor();
+
+        auto code = getDictionaryCode(c);
+        if (code != DICTIONARY_CODE) {
+            BOOST_THROW_EXCEPTION(decode_code_error() << code_info(code));
+        }
+
+        // All keys need to be walked to find the start of the values.
+        bool found = false;
+        size_t index = 0;
+        for (size_t i = 0; c.peek() != MARK_CODE; i++) {
+            if (found || peekType(c) != Type::String) {
+                skip(c);
+            } else if (compareString(c, key) == 0) {
+                found = true;
+                index = i;
+            }
+        }
+        c.ptr++;
+
+        if (!found) {
+            BOOST_THROW_EXCEPTION(decode_key_error() << key_info(std::string(key)));
+        }
+
+        for (size_t i = 0; i < index; i++) {
+            skip(c);
+        }
+        return RSONView(c);
+    }
+};
+
+};};
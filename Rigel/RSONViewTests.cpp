@@ -0,0 +1,109 @@
+/* Copyright 2018 Tjienta Vara
+ * This file is part of Orion.
+ *
+ * Orion is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Orion is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Orion.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE "RSONView tests"
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include "RSONEncode.hpp"
+#include "RSONView.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace Orion::Rigel;
+
+BOOST_AUTO_TEST_CASE(ViewScalar)
+{
+    auto buffer = encode(static_cast<int64_t>(-12345));
+    auto view = RSONView(buffer);
+
+    BOOST_CHECK(view.type() == Type::Integer);
+    BOOST_CHECK(view.length() == buffer.size());
+    BOOST_CHECK(view.as<int64_t>() == -12345);
+}
+
+BOOST_AUTO_TEST_CASE(ViewList)
+{
+    auto buffer = encode(vector<string>{"foo", "bar", "\xe2\x82\xac", ""});
+    auto view = RSONView(buffer);
+
+    BOOST_CHECK(view.type() == Type::List);
+    BOOST_CHECK(view.size() == 4);
+    BOOST_CHECK(view[0].as<string>() == "foo");
+    BOOST_CHECK(view[1].as<string>() == "bar");
+    BOOST_CHECK(view[2].as<string>() == "\xe2\x82\xac");
+    BOOST_CHECK(view[3].as<string>() == "");
+    BOOST_CHECK_THROW(view[4], decode_index_error);
+}
+
+BOOST_AUTO_TEST_CASE(ViewDictionary)
+{
+    auto buffer = encode(map<string, vector<int>>{
+        {"a", {1, 2, 3}},
+        {"listeners", {4000, 4001}},
+        {"publicKey", {}},
+        {"serviceName", {-1}}
+    });
+    auto view = RSONView(buffer);
+
+    BOOST_CHECK(view.type() == Type::Dictionary);
+    BOOST_CHECK(view.size() == 4);
+    BOOST_CHECK(view.key(1).as<string>() == "listeners");
+    BOOST_CHECK(view[1][1].as<int>() == 4001);
+
+    BOOST_CHECK(view.contains("a"));
+    BOOST_CHECK(view.contains("serviceName"));
+    BOOST_CHECK(!view.contains("b"));
+    BOOST_CHECK(!view.contains("service"));
+    BOOST_CHECK(!view.contains("serviceNames"));
+
+    BOOST_CHECK(view["a"][2].as<int>() == 3);
+    BOOST_CHECK(view["listeners"][0].as<int>() == 4000);
+    BOOST_CHECK(view["publicKey"].size() == 0);
+    BOOST_CHECK(view[string("serviceName")][0].as<int>() == -1);
+    BOOST_CHECK_THROW(view["missing"], decode_key_error);
+    BOOST_CHECK_THROW(view["a"]["b"], decode_code_error);
+}
+
+BOOST_AUTO_TEST_CASE(ViewNested)
+{
+    auto buffer = encode(vector<map<string, double>>{{{"x", 1.0}, {"y", 2.5}}, {{"x", -3.0}}});
+    auto view = RSONView(buffer);
+
+    BOOST_CHECK(view.size() == 2);
+    BOOST_CHECK(view[0]["y"].as<double>() == 2.5);
+    BOOST_CHECK(view[1]["x"].as<double>() == -3.0);
+    BOOST_CHECK(view[0].length() + view[1].length() + 2 == buffer.size());
+}
+
+BOOST_AUTO_TEST_CASE(SkipFields)
+{
+    auto buffer = encode(vector<int>{1, 2}) + encode(string("Hello")) + encode(1.5) +
+        encode(basic_string<uint8_t>(300, 7)) + encode(none) + encode(0.0);
+    auto cursor = RSONCursor(buffer);
+
+    skip(cursor);
+    BOOST_CHECK(decode<string>(cursor) == "Hello");
+    skip(cursor);
+    skip(cursor);
+    skip(cursor);
+    skip(cursor);
+    BOOST_CHECK(cursor.empty());
+    BOOST_CHECK_THROW(skip(cursor), decode_eof_error);
+}
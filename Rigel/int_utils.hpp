@@ -23,8 +23,13 @@
 
 #ifdef __GNUC__
 #define intel_intrinsic_uint64  long long unsigned int
+#if !defined(__clang__) && __GNUC__ < 8
+// Older GCC versions swapped the operands of _subborrow_u64().
 #define fixed_subborrow_u64(borrow, a, b, result) _subborrow_u64(borrow, b, a, result)
 #else
+#define fixed_subborrow_u64(borrow, a, b, result) _subborrow_u64(borrow, a, b, result)
+#endif
+#else
 #define intel_intrinsic_uint64  unsigned __int64
 #define fixed_subborrow_u64(borrow, a, b, result) _subborrow_u64(borrow, a, b, result)
 #endif
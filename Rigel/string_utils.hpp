@@ -16,7 +16,9 @@
  */
 #pragma once
 #include <string>
+#include <cstdint>
 #include <string.h>
+#include <immintrin.h>
 
 namespace Orion {
 namespace Rigel {
@@ -30,5 +32,149 @@ inline bool startswith(const std::string &haystack, const std::string &needle)
     }
 }
 
+/** Find the first byte with the most significant bit set.
+ * This is the stop-bit of RSON ASCII-strings and integers.
+ *
+ * @param p Start of the range to search.
+ * @param end One beyond the end of the range.
+ * @return Pointer to the byte, or end when there is no such byte.
+ */
+inline const uint8_t *findHighBit(const uint8_t *p, const uint8_t *end)
+{
+    while (end - p >= 32) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(block));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+
+    if (end - p >= 16) {
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(block));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+
+    while (p != end && (*p & 0x80) == 0) {
+        p++;
+    }
+    return p;
+}
+
+enum class RSONStringClass {
+    ASCII,          ///< Only 0x01-0x0f and 0x1b-0x7f, may be encoded as an ASCII-string.
+    UTF8,           ///< Must be encoded as a UTF-8 string.
+    ContainsNul     ///< Can not be encoded.
+};
+
+/** Classify a string for RSON encoding in a single pass.
+ *
+ * @param p Start of the string.
+ * @param end One beyond the end of the string.
+ */
+inline RSONStringClass classifyRSONString(const uint8_t *p, const uint8_t *end)
+{
+    auto zero = _mm256_setzero_si256();
+    auto codeStart = _mm256_set1_epi8(0x10);
+    auto codeRange = _mm256_set1_epi8(0x1a - 0x10);
+    uint32_t nonASCII = 0;
+
+    while (end - p >= 32) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+
+        auto isNul = _mm256_cmpeq_epi8(block, zero);
+        if (_mm256_movemask_epi8(isNul)) {
+            return RSONStringClass::ContainsNul;
+        }
+
+        // Bytes in 0x10-0x1a become 0x00-0x0a after subtracting 0x10.
+        // Bytes with the high bit set are not ASCII either.
+        auto code = _mm256_sub_epi8(block, codeStart);
+        auto isCode = _mm256_cmpeq_epi8(_mm256_min_epu8(code, codeRange), code);
+        nonASCII |= static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(isCode, block)));
+        p += 32;
+    }
+
+    for (; p != end; p++) {
+        auto c = *p;
+        if (c == 0) {
+            return RSONStringClass::ContainsNul;
+        }
+        nonASCII |= (c >= 0x80 || (c >= 0x10 && c <= 0x1a));
+    }
+
+    return nonASCII ? RSONStringClass::UTF8 : RSONStringClass::ASCII;
+}
+
+/** Check if a range of bytes only contains ASCII characters valid in a RSON ASCII-string.
+ * Valid characters are 0x01-0x0f and 0x1b-0x7f.
+ *
+ * @param p Start of the range to check.
+ * @param end One beyond the end of the range.
+ */
+inline bool isRSONASCII(const uint8_t *p, const uint8_t *end)
+{
+    return classifyRSONString(p, end) == RSONStringClass::ASCII;
+}
+
+/** Check if a range of bytes is valid UTF-8.
+ * Overlong encodings, surrogates and code-points beyond 0x10ffff are rejected.
+ *
+ * @param p Start of the range to check.
+ * @param end One beyond the end of the range.
+ */
+inline bool isUTF8(const uint8_t *p, const uint8_t *end)
+{
+    while (p != end) {
+        // Skip quickly over runs of ASCII characters.
+        if (end - p >= 32) {
+            auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(block));
+            if (mask == 0) {
+                p += 32;
+                continue;
+            }
+            p += __builtin_ctz(mask);
+        }
+
+        uint32_t c = *p++;
+        if (c < 0x80) {
+            continue;
+        }
+
+        int nrContinuation;
+        uint32_t minimum;
+        if ((c & 0xe0) == 0xc0) {
+            nrContinuation = 1; minimum = 0x80; c &= 0x1f;
+        } else if ((c & 0xf0) == 0xe0) {
+            nrContinuation = 2; minimum = 0x800; c &= 0x0f;
+        } else if ((c & 0xf8) == 0xf0) {
+            nrContinuation = 3; minimum = 0x10000; c &= 0x07;
+        } else {
+            return false;
+        }
+
+        if (end - p < nrContinuation) {
+            return false;
+        }
+        for (int i = 0; i < nrContinuation; i++) {
+            auto continuation = *p++;
+            if ((continuation & 0xc0) != 0x80) {
+                return false;
+            }
+            c = (c << 6) | (continuation & 0x3f);
+        }
+
+        if (c < minimum || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 
 };};